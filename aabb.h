@@ -0,0 +1,108 @@
+#ifndef AABB_H  // start of aabb header file
+#define AABB_H  // aabb class definition
+
+// Import libraries
+#include "rtweekend.h"
+
+// axis-aligned bounding box, stored as one interval per axis
+// aabb is the double instantiation, basic_aabb<float> the single precision one
+template <typename T>
+class basic_aabb {
+    public:
+        basic_interval<T> x, y, z;
+
+        constexpr basic_aabb() {}   // Default box is empty, since intervals are empty by default
+
+        constexpr basic_aabb(const basic_interval<T>& x, const basic_interval<T>& y, const basic_interval<T>& z)
+            : x(x), y(y), z(z) {}
+
+        // treats the two points a and b as extrema for the bounding box
+        basic_aabb(const basic_vec3<T>& a, const basic_vec3<T>& b) {
+            x = (a[0] <= b[0]) ? basic_interval<T>(a[0], b[0]) : basic_interval<T>(b[0], a[0]);
+            y = (a[1] <= b[1]) ? basic_interval<T>(a[1], b[1]) : basic_interval<T>(b[1], a[1]);
+            z = (a[2] <= b[2]) ? basic_interval<T>(a[2], b[2]) : basic_interval<T>(b[2], a[2]);
+        }
+
+        // creates the box tightly enclosing the two input boxes
+        basic_aabb(const basic_aabb& box0, const basic_aabb& box1) {
+            x = basic_interval<T>(box0.x, box1.x);
+            y = basic_interval<T>(box0.y, box1.y);
+            z = basic_interval<T>(box0.z, box1.z);
+        }
+
+        // conversion between float and double boxes
+        template <typename U>
+        explicit basic_aabb(const basic_aabb<U>& box)
+            : x(basic_interval<T>(box.x)), y(basic_interval<T>(box.y)), z(basic_interval<T>(box.z)) {}
+
+        // returns the interval of the box along axis n (0 = x, 1 = y, 2 = z)
+        const basic_interval<T>& axis_interval(int n) const {
+            if (n == 1) return y;
+            if (n == 2) return z;
+            return x;
+        }
+
+        // returns the center point of the box
+        basic_vec3<T> centroid() const {
+            return basic_vec3<T>(T(0.5)*(x.min + x.max), T(0.5)*(y.min + y.max), T(0.5)*(z.min + z.max));
+        }
+
+        // returns the index of the longest axis of the box
+        int longest_axis() const {
+            if (x.size() > y.size())
+                return x.size() > z.size() ? 0 : 2;
+            else
+                return y.size() > z.size() ? 1 : 2;
+        }
+
+        // returns the surface area of the box (0 for an empty box)
+        T surface_area() const {
+            auto dx = x.size(), dy = y.size(), dz = z.size();
+            if (dx < 0 || dy < 0 || dz < 0)
+                return 0;
+            return 2 * (dx*dy + dy*dz + dz*dx);
+        }
+
+        // returns true if the ray passes through the box within ray_t (slab method)
+        bool hit(const basic_ray<T>& r, basic_interval<T> ray_t) const {
+            const basic_vec3<T>& ray_orig = r.origin();
+            const basic_vec3<T>& ray_dir  = r.direction();
+            basic_vec3<T> inv_dir(1/ray_dir.x(), 1/ray_dir.y(), 1/ray_dir.z());
+
+            return hit(ray_orig, inv_dir, ray_t);
+        }
+
+        // slab test with the reciprocal of the ray direction precomputed by the caller,
+        // used by acceleration structures that test many boxes against the same ray
+        bool hit(const basic_vec3<T>& ray_orig, const basic_vec3<T>& inv_dir, basic_interval<T> ray_t) const {
+            for (int axis = 0; axis < 3; axis++) {
+                const basic_interval<T>& ax = axis_interval(axis);
+
+                auto t0 = (ax.min - ray_orig[axis]) * inv_dir[axis];
+                auto t1 = (ax.max - ray_orig[axis]) * inv_dir[axis];
+
+                if (t0 > t1) {
+                    auto tmp = t0; t0 = t1; t1 = tmp;
+                }
+                if (t0 > ray_t.min) ray_t.min = t0;
+                if (t1 < ray_t.max) ray_t.max = t1;
+
+                if (ray_t.max < ray_t.min)
+                    return false;
+            }
+            return true;
+        }
+
+        static const basic_aabb empty, universe;
+};
+
+template <typename T>
+constexpr basic_aabb<T> basic_aabb<T>::empty    = basic_aabb<T>(basic_interval<T>::empty, basic_interval<T>::empty,
+                                                                basic_interval<T>::empty);
+template <typename T>
+constexpr basic_aabb<T> basic_aabb<T>::universe = basic_aabb<T>(basic_interval<T>::universe, basic_interval<T>::universe,
+                                                                basic_interval<T>::universe);
+
+using aabb = basic_aabb<double>;
+
+#endif  // end of aabb header file
@@ -0,0 +1,264 @@
+#ifndef ACCUMULATION_BUFFER_H   // start of accumulation_buffer header file
+#define ACCUMULATION_BUFFER_H   // accumulation_buffer class definition
+
+// Import libraries
+#include "rtweekend.h"
+#include "byte_io.h"
+#include "framebuffer.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// running per-pixel sums of linear sample colors plus the number of samples in each sum
+// and the running mean and variance of the sample luminance (Welford's method)
+// NOTE: samples are always added to a pixel one at a time in sample order, so a sum that
+//       was saved, reloaded and continued is bit-identical to one rendered in a single run
+class accumulation_buffer {
+    public:
+        accumulation_buffer() : image_width(0), image_height(0) {}
+
+        accumulation_buffer(int width, int height)
+            : image_width(width), image_height(height),
+              sums(size_t(width) * height), counts(size_t(width) * height, 0),
+              lum_mean(size_t(width) * height, 0.0), lum_m2(size_t(width) * height, 0.0) {}
+
+        // empties the buffer for an image of width x height, keeping the arrays' memory, so
+        // a buffer reused for every frame of an animation allocates only once
+        void reset(int width, int height) {
+            image_width  = width;
+            image_height = height;
+            auto pixels  = size_t(width) * height;
+            sums.assign(pixels, color());
+            counts.assign(pixels, 0);
+            lum_mean.assign(pixels, 0.0);
+            lum_m2.assign(pixels, 0.0);
+        }
+
+        int width() const  {return image_width;}
+        int height() const {return image_height;}
+
+        // sum of the samples of pixel (i, j)
+        const color& sum(int i, int j) const {return sums[index(i, j)];}
+
+        // number of samples in the sum of pixel (i, j)
+        uint32_t samples(int i, int j) const {return counts[index(i, j)];}
+
+        // adds the next sample of pixel (i, j)
+        void add_sample(int i, int j, const color& sample) {
+            auto k = index(i, j);
+            sums[k] += sample;
+            counts[k]++;
+
+            // Welford update of the luminance mean and sum of squared deviations
+            auto lum   = luminance(sample);
+            auto delta = lum - lum_mean[k];
+            lum_mean[k] += delta / counts[k];
+            lum_m2[k]   += delta * (lum - lum_mean[k]);
+        }
+
+        // mean luminance of the samples of pixel (i, j)
+        double mean_luminance(int i, int j) const {return lum_mean[index(i, j)];}
+
+        // unbiased sample variance of the luminance of pixel (i, j)
+        double luminance_variance(int i, int j) const {
+            auto k = index(i, j);
+            return counts[k] > 1 ? lum_m2[k] / (counts[k] - 1) : 0.0;
+        }
+
+        // most samples of any pixel
+        uint32_t max_samples() const {
+            uint32_t most = 0;
+            for (auto count : counts)
+                most = count > most ? count : most;
+            return most;
+        }
+
+        // fewest samples of any pixel
+        uint32_t min_samples() const {
+            uint32_t fewest = UINT32_MAX;
+            for (auto count : counts)
+                fewest = count < fewest ? count : fewest;
+            return counts.empty() ? 0 : fewest;
+        }
+
+        // total number of samples over all pixels
+        uint64_t total_samples() const {
+            uint64_t total = 0;
+            for (auto count : counts)
+                total += count;
+            return total;
+        }
+
+        // adds the samples of another buffer of the same size, such as the partial buffer of
+        // one process of a distributed render
+        // NOTE: a pixel that has samples in only one of the buffers takes that buffer's sums
+        //       unchanged, so merging buffers of disjoint pixel regions is bit-identical to a
+        //       single render; a pixel whose samples are split over several buffers (sample
+        //       range assignments) gets the same estimate, but its sum is added in another
+        //       order and can differ from a single render in the last bits
+        void merge(const accumulation_buffer& other) {
+            for (size_t k = 0; k < sums.size(); k++) {
+                if (other.counts[k] == 0)
+                    continue;
+                if (counts[k] == 0) {
+                    sums[k]     = other.sums[k];
+                    counts[k]   = other.counts[k];
+                    lum_mean[k] = other.lum_mean[k];
+                    lum_m2[k]   = other.lum_m2[k];
+                    continue;
+                }
+
+                // combined mean and squared deviation sum of two sample sets (Chan et al.)
+                double na = counts[k], nb = other.counts[k], n = na + nb;
+                auto delta = other.lum_mean[k] - lum_mean[k];
+                lum_mean[k] += delta * nb / n;
+                lum_m2[k]   += other.lum_m2[k] + delta * delta * na * nb / n;
+                sums[k]     += other.sums[k];
+                counts[k]   += other.counts[k];
+            }
+        }
+
+        // averages every pixel sum into a framebuffer of linear colors
+        framebuffer resolve() const {
+            framebuffer image(image_width, image_height);
+            for (size_t k = 0; k < sums.size(); k++)
+                image.data()[k] = counts[k] > 0 ? (1.0 / counts[k]) * sums[k] : color(0,0,0);
+            return image;
+        }
+
+        // false color image of the per-pixel sample counts, from black (no samples) through
+        // red and yellow to white (max_samples)
+        framebuffer sample_heatmap(uint32_t max_samples) const {
+            framebuffer image(image_width, image_height);
+            for (size_t k = 0; k < counts.size(); k++) {
+                auto t = max_samples > 0 ? fmin(1.0, double(counts[k]) / max_samples) : 0.0;
+                color ramp(fmin(1.0, 3*t), fmin(1.0, fmax(0.0, 3*t - 1)), fmax(0.0, 3*t - 2));
+                // squared so the gamma correction of the encoders shows the ramp itself
+                image.data()[k] = ramp * ramp;
+            }
+            return image;
+        }
+
+        /* Checkpoint files */
+        // little-endian binary layout:
+        //   "RTCK", version (u32), width (u32), height (u32), seed (u64),
+        //   then per pixel in row order: r, g, b sums (3 x f64), luminance mean and
+        //   squared deviation sum (2 x f64), sample count (u32)
+
+        // writes the buffer to path, replacing the previous file only once the new one is
+        // complete, so an interrupted write never destroys the last good checkpoint
+        bool save(const std::string& path, uint64_t seed) const {
+            std::vector<unsigned char> bytes;
+            bytes.reserve(24 + sums.size() * pixel_record_size);
+
+            bytes.insert(bytes.end(), {'R', 'T', 'C', 'K'});
+            put_u32(bytes, file_version);
+            put_u32(bytes, uint32_t(image_width));
+            put_u32(bytes, uint32_t(image_height));
+            put_u64(bytes, seed);
+            for (size_t k = 0; k < sums.size(); k++) {
+                for (int c = 0; c < 3; c++)
+                    put_f64(bytes, sums[k][c]);
+                put_f64(bytes, lum_mean[k]);
+                put_f64(bytes, lum_m2[k]);
+                put_u32(bytes, counts[k]);
+            }
+
+            std::string temp_path = path + ".tmp";
+            {
+                std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+                out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+                if (!out)
+                    return false;
+            }
+
+            std::remove(path.c_str());  // rename does not replace existing files on Windows
+            return std::rename(temp_path.c_str(), path.c_str()) == 0;
+        }
+
+        // reads a checkpoint written by save; fails if the file is missing, damaged, or was
+        // written for another image size
+        // NOTE: an empty buffer (default constructed) takes the image size of the file
+        bool load(const std::string& path, uint64_t& seed) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return false;
+            std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)),
+                                              std::istreambuf_iterator<char>());
+
+            if (bytes.size() < 24 || std::string(bytes.begin(), bytes.begin() + 4) != "RTCK")
+                return false;
+
+            const unsigned char* src = bytes.data() + 4;
+            auto width  = get_u32(src + 4);
+            auto height = get_u32(src + 8);
+            if (get_u32(src) != file_version || bytes.size() != 24 + size_t(width) * height * pixel_record_size)
+                return false;
+            if (image_width == 0 && image_height == 0)
+                *this = accumulation_buffer(int(width), int(height));
+            if (width != uint32_t(image_width) || height != uint32_t(image_height))
+                return false;
+            seed = get_u64(src + 12);
+
+            src = bytes.data() + 24;
+            for (size_t k = 0; k < sums.size(); k++, src += pixel_record_size) {
+                sums[k]     = color(get_f64(src), get_f64(src + 8), get_f64(src + 16));
+                lum_mean[k] = get_f64(src + 24);
+                lum_m2[k]   = get_f64(src + 32);
+                counts[k]   = get_u32(src + 40);
+            }
+            return true;
+        }
+
+    private:
+        static constexpr uint32_t file_version      = 2;
+        static constexpr size_t   pixel_record_size = 44;
+
+        int                     image_width;
+        int                     image_height;
+        std::vector<color>      sums;       // linear color sums in row order
+        std::vector<uint32_t>   counts;     // samples in each sum
+        std::vector<double>     lum_mean;   // running mean of the sample luminance
+        std::vector<double>     lum_m2;     // running sum of squared luminance deviations
+
+        size_t index(int i, int j) const {return size_t(j) * image_width + i;}
+
+        // relative luminance of a linear color (Rec. 709 weights)
+        static double luminance(const color& c) {
+            return 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+        }
+};
+
+// merges the partial buffers of a distributed render, see accumulation_buffer::merge;
+// fails with a message in error if a file cannot be read or the files do not belong to
+// one render (image size, seed)
+inline bool merge_partial_files(const std::vector<std::string>& paths, accumulation_buffer& merged,
+                                uint64_t& seed, std::string& error)
+{
+    merged = accumulation_buffer();
+    for (size_t k = 0; k < paths.size(); k++) {
+        accumulation_buffer part(merged.width(), merged.height());
+        uint64_t part_seed;
+        if (!part.load(paths[k], part_seed)) {
+            error = paths[k] + " is missing, damaged, or of another image size";
+            return false;
+        }
+        if (k > 0 && part_seed != seed) {
+            error = paths[k] + " was rendered with another seed";
+            return false;
+        }
+        seed = part_seed;
+
+        if (k == 0)
+            merged = std::move(part);
+        else
+            merged.merge(part);
+    }
+    return true;
+}
+
+#endif  // end of accumulation_buffer header file
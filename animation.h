@@ -0,0 +1,254 @@
+#ifndef ANIMATION_H // start of animation header file
+#define ANIMATION_H // scene_animation and animation_renderer class definitions
+
+// Import libraries
+#include "rtweekend.h"
+#include "accumulation_buffer.h"
+#include "camera.h"
+#include "closed_world.h"
+#include "image_encoder.h"
+#include "instance.h"
+#include "packed_spheres.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// motion of one sphere of an animated scene, relative to its place in the scene
+// 1. orbit: the sphere circles orbit_axis through pivot at orbit_speed degrees per second
+// 2. bounce: it is thrown up to bounce_height above its place along +y and lands again on
+//    a parabola, bounce_rate times per second, phase of a bounce ahead of time 0
+struct sphere_motion {
+    int     sphere;                         // index into scene_description::spheres
+    vec3    orbit_axis      = vec3(0,1,0);
+    point3  pivot           = point3(0,0,0);
+    double  orbit_speed     = 0;            // degrees per second (0: no orbit)
+    double  bounce_height   = 0;            // peak height of a bounce (0: no bounce)
+    double  bounce_rate     = 1;            // bounces per second
+    double  phase           = 0;            // fraction of a bounce
+};
+
+// scene whose spheres move over time; everything without a motion stays in place
+class scene_animation {
+    public:
+        scene_description           scene;      // the scene as placed, before any motion
+        std::vector<sphere_motion>  motions;
+
+        // center of the sphere of motion m at time seconds
+        point3 center_at(const sphere_motion& m, double time) const {
+            point3 center = scene.spheres[m.sphere].center;
+            if (m.orbit_speed != 0)
+                center = (affine_transform::translation(m.pivot)
+                        * affine_transform::rotation(m.orbit_axis, m.orbit_speed * time)
+                        * affine_transform::translation(-m.pivot)).point(center);
+            if (m.bounce_height != 0) {
+                double x = m.bounce_rate * time + m.phase;
+                x -= std::floor(x);
+                center += vec3(0, 4 * m.bounce_height * x * (1 - x), 0);
+            }
+            return center;
+        }
+
+        // the scene at time seconds
+        scene_description pose(double time) const {
+            scene_description posed = scene;
+            for (const auto& m : motions)
+                posed.spheres[m.sphere].center = center_at(m, time);
+            return posed;
+        }
+};
+
+// scene set in motion: every step-th sphere bounces twice its radius high once a second,
+// and the spheres of radius 1 or more circle the vertical axis through the origin at 20
+// degrees per second (a turntable of the large spheres of random_spheres_scene)
+// NOTE: the largest sphere, the ground, never moves
+inline scene_animation bouncing_spheres_animation(const scene_description& scene, int step) {
+    scene_animation animation;
+    animation.scene = scene;
+
+    int ground = -1;
+    for (int k = 0; k < int(scene.spheres.size()); k++)
+        if (ground < 0 || scene.spheres[k].radius > scene.spheres[ground].radius)
+            ground = k;
+
+    for (int k = 0; k < int(scene.spheres.size()); k++) {
+        if (k == ground)
+            continue;
+        sphere_motion m{k};
+        if (scene.spheres[k].radius >= 1)
+            m.orbit_speed = 20;
+        else if (step > 0 && k % step == 0) {
+            m.bounce_height = 2 * scene.spheres[k].radius;
+            m.phase         = std::fmod(k * 0.618034, 1.0);     // golden ratio, spreads the bounces
+        }
+        else
+            continue;
+        animation.motions.push_back(m);
+    }
+    return animation;
+}
+
+// frames of an animation and where they go
+class animation_settings {
+    public:
+        int         frame_count         = 24;       // Frames rendered, from time 0
+        double      frame_rate          = 24;       // Frames per second of animation time
+        std::string frame_prefix        = "frame";  // Frame f is written to <prefix><f as 4 digits>.<format extension>
+        double      rebuild_threshold   = 1.5;      // Growth of the hierarchy's box areas since the last build that triggers a rebuild
+};
+
+// renders every frame of an animation from one process into numbered image files
+// 1. one thread pool and one accumulation buffer serve the whole sequence
+// 2. "packed" and "closed" worlds are built once; each later frame moves the animated
+//    spheres in place and refits the hierarchy around them (see basic_bvh_tree::refit),
+//    and rebuilds it only once its boxes have grown past rebuild_threshold times their
+//    areas after the last build (see basic_bvh_tree::area_growth)
+// 3. "objects" worlds, and packed scenes with instances or meshes, are built from the
+//    posed scene for every frame
+// 4. every frame reports the time spent on its world and on its render
+// NOTE: frames are written as binary PPM unless the camera's output_format is pfm or qoi
+template <typename T>
+class basic_animation_renderer : public animation_settings {
+    public:
+        basic_animation_renderer(const basic_camera<T>& cam, const animation_settings& settings)
+            : animation_settings(settings), cam(cam), pool(cam.thread_count) {}
+
+        // renders every frame; returns false after printing why if the world cannot be
+        // built or a frame could not be written
+        bool render(const scene_animation& animation, const std::string& world_kind) {
+            if (cam.sampler != "independent" && !make_pixel_sampler(cam.sampler, cam.sampler_samples(), cam.image_width, cam.seed)) {
+                std::cerr << "Unknown sampler: " << cam.sampler << '\n';
+                return false;
+            }
+            if (cam.samples_per_pixel < 0 || cam.samples_per_pass < 0) {
+                std::cerr << "Invalid sample count: " << cam.samples_per_pixel << " samples per pixel, "
+                          << cam.samples_per_pass << " per pass\n";
+                return false;
+            }
+
+            bool spheres_only = animation.scene.instances.empty() && animation.scene.meshes.empty();
+            world_ms  = 0;
+            render_ms = 0;
+            rebuilds  = 0;
+            failed_frames = 0;
+
+            if (world_kind == "closed" && !spheres_only) {
+                std::cerr << "The closed world cannot hold instances or meshes, use --world packed or objects\n";
+                return false;
+            }
+            else if (world_kind == "closed") {
+                basic_closed_world<T> world;
+                render_refit(animation, [&](const scene_description& posed) {
+                    world = posed.template build_closed<T>();
+                    return &world;
+                });
+            }
+            else if (world_kind == "packed" && spheres_only) {
+                shared_ptr<basic_packed_spheres<T>> world;
+                render_refit(animation, [&](const scene_description& posed) {
+                    world = std::dynamic_pointer_cast<basic_packed_spheres<T>>(posed.template build_packed<T>());
+                    return world.get();
+                });
+            }
+            else if (world_kind == "objects" || world_kind == "packed")
+                render_rebuild(animation, world_kind == "objects");
+            else {
+                std::cerr << "Unknown world: " << world_kind << '\n';
+                return false;
+            }
+
+            std::clog << "Animation: " << frame_count << " frames, world " << world_ms << " ms ("
+                      << rebuilds << " rebuilds), render " << render_ms << " ms\n";
+            return failed_frames == 0;
+        }
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        basic_camera<T>     cam;
+        thread_pool         pool;
+        accumulation_buffer accum;      // reused by every frame
+        double              world_ms  = 0;
+        double              render_ms = 0;
+        int                 rebuilds  = 0;
+        int                 failed_frames = 0;
+
+        static double ms_since(clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        }
+
+        // frame 0 builds the world with build(posed scene), which returns a pointer to it;
+        // later frames update the moving spheres in place and refit
+        template <typename build_function>
+        void render_refit(const scene_animation& animation, build_function&& build) {
+            decltype(build(animation.scene)) world = nullptr;
+            for (int frame = 0; frame < frame_count; frame++) {
+                double time  = frame / frame_rate;
+                auto   start = clock::now();
+                std::ostringstream update;
+
+                if (frame == 0) {
+                    world = build(animation.pose(time));
+                    update << "build " << ms_since(start) << " ms";
+                    world_ms += ms_since(start);
+                    render_frame(frame, *world, update.str());
+                    continue;
+                }
+
+                for (const auto& m : animation.motions)
+                    world->update_sphere(m.sphere, basic_vec3<T>(animation.center_at(m, time)),
+                                         T(animation.scene.spheres[m.sphere].radius));
+                double growth = world->refit();
+                update << "refit " << ms_since(start) << " ms (growth " << growth << ")";
+                if (growth > rebuild_threshold) {
+                    auto rebuild_start = clock::now();
+                    world->build();
+                    update << ", rebuild " << ms_since(rebuild_start) << " ms";
+                    rebuilds++;
+                }
+                world_ms += ms_since(start);
+                render_frame(frame, *world, update.str());
+            }
+        }
+
+        // builds the world from the posed scene for every frame
+        void render_rebuild(const scene_animation& animation, bool objects) {
+            for (int frame = 0; frame < frame_count; frame++) {
+                auto posed = animation.pose(frame / frame_rate);
+                auto start = clock::now();
+                auto world = objects ? posed.template build_objects<T>() : posed.template build_packed<T>();
+                double took = ms_since(start);
+                world_ms += took;
+                std::ostringstream update;
+                update << "build " << took << " ms";
+                render_frame(frame, *world, update.str());
+            }
+        }
+
+        template <typename World>
+        void render_frame(int frame, const World& world, const std::string& update) {
+            auto start = clock::now();
+            framebuffer image = cam.render_image(world, pool, accum);
+            double took = ms_since(start);
+            render_ms += took;
+
+            char number[16];
+            std::snprintf(number, sizeof(number), "%04d", frame);
+            auto format = cam.output_format;
+            auto path   = frame_prefix + number + (format == "pfm" || format == "qoi" ? "." + format : std::string(".ppm"));
+            if (!write_image_file(image, path)) {
+                std::cerr << "Could not write frame " << path << '\n';
+                failed_frames++;
+            }
+            std::clog << "Frame " << frame << ": " << update << ", render " << took << " ms -> " << path << '\n';
+        }
+};
+
+using animation_renderer = basic_animation_renderer<double>;
+
+#endif  // end of animation header file
@@ -0,0 +1,99 @@
+#ifndef ARENA_H // start of arena header file
+#define ARENA_H // arena class definition
+
+// Import libraries
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// bump allocator that frees everything it handed out at once
+// 1. objects are placed back to back in large blocks, in creation order, so a scene
+//    built through the arena sits in a few contiguous ranges instead of one heap block
+//    (plus one shared_ptr control block) per object
+// 2. destructors run in reverse creation order when the arena itself is destroyed
+// NOTE: handing objects out through arena_shared keeps the hittable and material
+//       interfaces unchanged; every returned shared_ptr shares the arena's single control block
+class arena {
+    public:
+        explicit arena(size_t block_size = size_t(1) << 20) : block_size(block_size) {}
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        ~arena() {
+            for (auto entry = destructors.rbegin(); entry != destructors.rend(); ++entry)
+                entry->destroy(entry->object);
+        }
+
+        // constructs a T in the arena
+        template <typename T, typename... Args>
+        T* create(Args&&... args) {
+            T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if (!std::is_trivially_destructible<T>::value)
+                destructors.push_back(destructor{object, [](void* p) {static_cast<T*>(p)->~T();}});
+            return object;
+        }
+
+        // bytes handed out so far, including alignment padding
+        size_t bytes_used() const {return used;}
+
+        // bytes held from the system: the blocks and the destructor list
+        size_t bytes_reserved() const {
+            size_t total = destructors.capacity() * sizeof(destructor);
+            for (const auto& b : blocks)
+                total += b.size;
+            return total;
+        }
+
+    private:
+        struct block {
+            std::unique_ptr<unsigned char[]>    data;
+            size_t                              size;
+        };
+
+        struct destructor {
+            void*   object;
+            void    (*destroy)(void*);
+        };
+
+        size_t                  block_size;
+        std::vector<block>      blocks;
+        size_t                  offset  = 0;    // first free byte in the last block
+        size_t                  used    = 0;
+        std::vector<destructor> destructors;
+
+        void* allocate(size_t size, size_t alignment) {
+            if (!blocks.empty()) {
+                auto base    = reinterpret_cast<uintptr_t>(blocks.back().data.get());
+                auto aligned = (base + offset + alignment - 1) & ~uintptr_t(alignment - 1);
+                if (aligned + size <= base + blocks.back().size) {
+                    used  += aligned + size - (base + offset);
+                    offset = aligned + size - base;
+                    return reinterpret_cast<void*>(aligned);
+                }
+            }
+
+            // new block, large enough for oversized objects; new[] aligns to max_align_t
+            auto b = block{std::unique_ptr<unsigned char[]>(new unsigned char[std::max(block_size, size)]),
+                           std::max(block_size, size)};
+            blocks.push_back(std::move(b));
+            offset = size;
+            used  += size;
+            return blocks.back().data.get();
+        }
+};
+
+// constructs a T in the arena and returns a shared_ptr that keeps the whole arena alive
+template <typename T, typename... Args>
+shared_ptr<T> arena_shared(const shared_ptr<arena>& owner, Args&&... args) {
+    return shared_ptr<T>(owner, owner->create<T>(std::forward<Args>(args)...));
+}
+
+#endif  // end of arena header file
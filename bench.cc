@@ -0,0 +1,815 @@
+/*  Microbenchmarks for the hot-path kernels of the ray tracer
+*   Times each kernel in isolation with fixed seeds and prints one CSV line per benchmark:
+*       benchmark,ns_per_op,ops_per_sec
+*   ops are rays for the intersection and camera benchmarks, so ops_per_sec is rays/sec,
+*   and whole camera paths for the path benchmarks; the primary benchmarks compare single
+*   camera rays with ray packets; ops are spheres for the scene_load benchmarks, which
+*   read a generated scene of one million spheres from a binary and a text scene file, and
+*   triangles for the mesh benchmarks, which load, build and intersect a tessellated sphere
+*   of one million triangles
+*   Diff the output of two builds to catch regressions on the hot paths.
+*
+*   The float path is also compared against the double reference by image error, the
+*   samplers by the image error they reach at a few sample counts and by whether a split
+*   into sample ranges reproduces the single render, and the denoised image
+*   by its error next to raw renders of few and many samples.
+*
+*   Every sphere kernel the CPU supports is checked against the scalar reference on random
+*   rays, and the float image error against a tolerance; bench exits with status 1 when a
+*   check fails.
+*
+*   usage: bench.exe [--filter SUBSTRING] [--min-time SECONDS]
+*/
+
+// Import libraries
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "camera.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "mesh_file.h"
+#include "packed_spheres.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+// keeps results of the timed code alive so the compiler cannot drop the work
+static volatile double sink;
+
+// benchmark options
+static std::string  filter;             // only run benchmarks whose name contains this
+static double       min_time = 0.2;     // seconds each timed run should last
+static int          failed_checks = 0;  // checks that failed, bench exits with 1 if any did
+
+// runs op(k) for k = 0, 1, ... and prints the median time per call over 5 runs, which it
+// returns in ns (0 if the filter skips the benchmark)
+// NOTE: the iteration count is first doubled until one run takes min_time
+static double run_benchmark(const std::string& name, const std::function<double(long)>& op) {
+    if (!filter.empty() && name.find(filter) == std::string::npos)
+        return 0;
+
+    auto time_run = [&](long iterations) {
+        double acc = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (long k = 0; k < iterations; k++)
+            acc += op(k);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        sink = acc;
+        return elapsed.count();
+    };
+
+    long iterations = 1024;
+    while (time_run(iterations) < min_time / 4 && iterations < (1L << 40))
+        iterations *= 2;
+    iterations *= 4;
+
+    std::vector<double> ns_per_op;
+    for (int run = 0; run < 5; run++)
+        ns_per_op.push_back(1e9 * time_run(iterations) / iterations);
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+
+    double median = ns_per_op[2];
+    std::cout << name << ',' << median << ',' << 1e9 / median << '\n' << std::flush;
+    return median;
+}
+
+// random rays from points near the origin towards random directions
+static std::vector<ray> random_rays(rng& gen, int count) {
+    std::vector<ray> rays;
+    for (int k = 0; k < count; k++)
+        rays.push_back(ray(vec3::random(gen, -1, 1), vec3::random(gen, -1, 1)));
+    return rays;
+}
+
+// hit records from real intersections with a unit sphere, for the scatter benchmarks
+static std::vector<std::pair<ray, hit_record>> surface_hits(rng& gen, int count) {
+    sphere target(point3(0, 0, 0), 1.0, nullptr);
+    std::vector<std::pair<ray, hit_record>> hits;
+    while (int(hits.size()) < count) {
+        auto origin = 3.0 * unit_vector(vec3::random(gen, -1, 1));
+        ray r(origin, vec3::random(gen, -0.3, 0.3) - origin);
+        hit_record rec;
+        if (target.hit(r, interval(0.001, infinity), rec))
+            hits.push_back({r, rec});
+    }
+    return hits;
+}
+
+// unit sphere split into rows x columns quads of two triangles each; the poles are single
+// points, so the mesh is closed
+static shared_ptr<mesh_buffers> uv_sphere_mesh(int rows, int columns) {
+    std::vector<float>    positions;
+    std::vector<uint32_t> indices;
+    for (int i = 0; i <= rows; i++) {
+        double theta = pi * i / rows;
+        double ring  = (i == 0 || i == rows) ? 0 : std::sin(theta);
+        for (int j = 0; j < columns; j++) {
+            double phi = 2 * pi * j / columns;
+            positions.insert(positions.end(), {float(ring * std::cos(phi)), float(std::cos(theta)),
+                                               float(ring * std::sin(phi))});
+        }
+    }
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < columns; j++) {
+            uint32_t a = i * columns + j,       b = i * columns + (j + 1) % columns;
+            uint32_t c = (i + 1) * columns + j, d = (i + 1) * columns + (j + 1) % columns;
+            indices.insert(indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    auto mesh = make_shared<mesh_buffers>();
+    mesh->assign(std::move(positions), std::move(indices));
+    return mesh;
+}
+
+// checks every sphere kernel the CPU supports, single ray and packet, and the hierarchy
+// paths of the sphere batch and packed_spheres against the scalar reference on random rays
+// through random spheres of scalar type T; returns the number of paths where the sphere or
+// the distance of a ray differ
+// NOTE: the kernels repeat the arithmetic of the reference, so distances must be equal
+template <typename T>
+static int check_sphere_kernels(const char* type_name) {
+    const int sphere_count = 1024, ray_count = 4096, lanes = 16;
+    const T   t_min = T(0.001), t_max = std::numeric_limits<T>::infinity();
+    rng gen(99);
+
+    basic_sphere_batch<T>   batch;
+    basic_packed_spheres<T> packed;
+    auto mat = make_shared<basic_lambertian<T>>(basic_vec3<T>(0.5, 0.5, 0.5));
+    for (int k = 0; k < sphere_count; k++) {
+        auto center = basic_vec3<T>(vec3::random(gen, -20, 20));
+        auto radius = T(gen.random_double(0.1, 1.0));
+        batch.add(center, radius, 0);
+        packed.add(center, radius, mat);
+    }
+    batch.build();
+    packed.build();
+    basic_sphere_arrays<T> arrays = batch.arrays();
+
+    std::vector<basic_ray<T>> rays;
+    std::vector<int>          expected_index;
+    std::vector<T>            expected_t;
+    for (int k = 0; k < ray_count; k++) {
+        rays.push_back(basic_ray<T>(basic_vec3<T>(vec3::random(gen, -1, 1)), basic_vec3<T>(vec3::random(gen, -1, 1))));
+        basic_interval<T> ray_t(t_min, t_max);
+        expected_index.push_back(batch.nearest_reference(rays[k], ray_t));
+        expected_t.push_back(ray_t.max);
+    }
+
+    auto differs = [&](int k, int index, T t) {
+        return index != expected_index[k] || (index >= 0 && t != expected_t[k]);
+    };
+    int failed = 0;
+    auto report = [&](const std::string& path, int wrong) {
+        std::clog << "kernel_check: " << type_name << ' ' << path << ": ";
+        if (wrong == 0)
+            std::clog << "ok\n";
+        else
+            std::clog << wrong << " of " << ray_count << " rays differ from the scalar reference\n";
+        failed += wrong > 0;
+    };
+
+    // packets of lanes rays, every fifth lane left inactive
+    auto for_packets = [&](const std::function<void(const basic_ray_packet<T>&, int)>& test) {
+        for (int first = 0; first < ray_count; first += lanes) {
+            basic_ray_packet<T> packet;
+            packet.lanes = lanes;
+            for (int l = 0; l < lanes; l++)
+                if ((first + l) % 5 != 4)
+                    packet.set(l, rays[first + l]);
+            test(packet, first);
+        }
+    };
+
+    for (const char* name : {"scalar", "sse2", "avx2", "avx512"}) {
+        basic_sphere_kernel<T> kernel = find_sphere_kernel<T>(name);
+        if (kernel == nullptr)
+            continue;
+        int wrong = 0;
+        for (int k = 0; k < ray_count; k++) {
+            basic_interval<T> ray_t(t_min, t_max);
+            int index = kernel(arrays, 0, sphere_count, rays[k], ray_t);
+            wrong += differs(k, index, ray_t.max);
+        }
+        report(std::string(name), wrong);
+
+        basic_sphere_packet_kernel<T> packet_kernel = find_sphere_packet_kernel<T>(name);
+        wrong = 0;
+        for_packets([&](const basic_ray_packet<T>& packet, int first) {
+            alignas(64) T a[basic_ray_packet<T>::max_lanes];
+            T   t_hit[basic_ray_packet<T>::max_lanes];
+            int best[basic_ray_packet<T>::max_lanes];
+            for (int l = 0; l < basic_ray_packet<T>::max_lanes; l++) {
+                a[l]     = packet.dx[l]*packet.dx[l] + packet.dy[l]*packet.dy[l] + packet.dz[l]*packet.dz[l];
+                t_hit[l] = t_max;
+                best[l]  = -1;
+            }
+            packet_kernel(arrays, 0, sphere_count, packet, a, packet.active, t_min, t_hit, best);
+            for (int l = 0; l < lanes; l++)
+                if (packet.is_active(l))
+                    wrong += differs(first + l, best[l], t_hit[l]);
+        });
+        report(std::string(name) + " packet", wrong);
+    }
+
+    int wrong = 0;
+    for (int k = 0; k < ray_count; k++) {
+        basic_interval<T> ray_t(t_min, t_max);
+        int index = batch.nearest(rays[k], ray_t);
+        wrong += differs(k, index, ray_t.max);
+    }
+    report("hierarchy", wrong);
+
+    wrong = 0;
+    for_packets([&](const basic_ray_packet<T>& packet, int first) {
+        int best[basic_ray_packet<T>::max_lanes];
+        T   t_hit[basic_ray_packet<T>::max_lanes];
+        batch.nearest_packet(packet, basic_interval<T>(t_min, t_max), best, t_hit);
+        for (int l = 0; l < lanes; l++)
+            if (packet.is_active(l))
+                wrong += differs(first + l, best[l], t_hit[l]);
+    });
+    report("hierarchy packet", wrong);
+
+    wrong = 0;
+    for (int k = 0; k < ray_count; k++) {
+        basic_hit_record<T> rec, reference;
+        bool hit = packed.hit(rays[k], basic_interval<T>(t_min, t_max), rec);
+        if (hit != packed.hit_reference(rays[k], basic_interval<T>(t_min, t_max), reference)
+            || (hit && (rec.t != reference.t || rec.p.x() != reference.p.x() || rec.mat != reference.mat)))
+            wrong++;
+    }
+    report("packed_spheres hit", wrong);
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--filter") == 0 && arg + 1 < argc)
+            filter = argv[++arg];
+        else if (std::strcmp(argv[arg], "--min-time") == 0 && arg + 1 < argc)
+            min_time = std::atof(argv[++arg]);
+    }
+
+    const int pool_size = 1024;     // rays and records cycled through by each benchmark
+    const int mask      = pool_size - 1;
+    rng gen(2024);
+
+    std::clog << "sphere kernel: " << best_sphere_kernel_name() << '\n';
+    std::cout << "benchmark,ns_per_op,ops_per_sec\n";
+
+    /* Intersection */
+
+    auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+
+    // sphere::hit, every ray aimed at the sphere / every ray aimed away from it
+    {
+        sphere target(point3(0, 0, -5), 1.0, mat);
+        std::vector<ray> hit_rays, miss_rays;
+        for (int k = 0; k < pool_size; k++) {
+            auto origin = vec3::random(gen, -0.5, 0.5);
+            hit_rays.push_back(ray(origin, point3(0, 0, -5) + vec3::random(gen, -0.5, 0.5) - origin));
+            miss_rays.push_back(ray(origin, vec3(gen.random_double(-1, 1), gen.random_double(-1, 1), 1)));
+        }
+
+        run_benchmark("sphere_hit/hit", [&](long k) {
+            hit_record rec;
+            return target.hit(hit_rays[k & mask], interval(0.001, infinity), rec) ? rec.t : 0.0;
+        });
+        run_benchmark("sphere_hit/miss", [&](long k) {
+            hit_record rec;
+            return target.hit(miss_rays[k & mask], interval(0.001, infinity), rec) ? rec.t : 0.0;
+        });
+    }
+
+    // scenes of n random spheres: linear list, bvh_node, packed_spheres in double and float
+    auto float_mat = make_shared<basic_lambertian<float>>(basic_vec3<float>(0.5f, 0.5f, 0.5f));
+    for (int n : {16, 128, 1024, 8192}) {
+        hittable_list list;
+        auto packed       = make_shared<packed_spheres>();
+        auto packed_float = make_shared<basic_packed_spheres<float>>();
+        rng scene_gen(n);
+        for (int k = 0; k < n; k++) {
+            auto center = vec3::random(scene_gen, -20, 20);
+            auto radius = scene_gen.random_double(0.1, 1.0);
+            list.add(make_shared<sphere>(center, radius, mat));
+            packed->add(center, radius, mat);
+            packed_float->add(basic_vec3<float>(center), float(radius), float_mat);
+        }
+        packed->build();
+        packed_float->build();
+        bvh_node bvh(list);
+        auto rays = random_rays(gen, pool_size);
+
+        std::vector<basic_ray<float>> float_rays;
+        for (const auto& r : rays)
+            float_rays.push_back(basic_ray<float>(basic_vec3<float>(r.origin()), basic_vec3<float>(r.direction())));
+
+        auto suffix = "/" + std::to_string(n);
+        if (n <= 1024) {
+            run_benchmark("hittable_list_hit" + suffix, [&](long k) {
+                hit_record rec;
+                return list.hit(rays[k & mask], interval(0.001, infinity), rec) ? rec.t : 0.0;
+            });
+        }
+        run_benchmark("bvh_node_hit" + suffix, [&](long k) {
+            hit_record rec;
+            return bvh.hit(rays[k & mask], interval(0.001, infinity), rec) ? rec.t : 0.0;
+        });
+        run_benchmark("packed_spheres_hit" + suffix, [&](long k) {
+            hit_record rec;
+            return packed->hit(rays[k & mask], interval(0.001, infinity), rec) ? rec.t : 0.0;
+        });
+        run_benchmark("packed_spheres_float_hit" + suffix, [&](long k) {
+            basic_hit_record<float> rec;
+            auto ray_t = basic_interval<float>(0.001f, std::numeric_limits<float>::infinity());
+            return packed_float->hit(float_rays[k & mask], ray_t, rec) ? rec.t : 0.0;
+        });
+
+        // the SIMD kernels over all spheres at once, without the hierarchy
+        if (n == 1024) {
+            for (const char* name : {"scalar", "sse2", "avx2", "avx512"}) {
+                sphere_kernel kernel = find_sphere_kernel(name);
+                if (kernel == nullptr)
+                    continue;
+                sphere_arrays arrays = packed->arrays();
+                run_benchmark(std::string("sphere_kernel_") + name + suffix, [&](long k) {
+                    interval ray_t(0.001, infinity);
+                    return kernel(arrays, 0, n, rays[k & mask], ray_t) >= 0 ? ray_t.max : 0.0;
+                });
+            }
+            for (const char* name : {"scalar", "sse2", "avx2", "avx512"}) {
+                basic_sphere_kernel<float> kernel = find_sphere_kernel<float>(name);
+                if (kernel == nullptr)
+                    continue;
+                basic_sphere_arrays<float> arrays = packed_float->arrays();
+                run_benchmark(std::string("sphere_kernel_float_") + name + suffix, [&](long k) {
+                    basic_interval<float> ray_t(0.001f, std::numeric_limits<float>::infinity());
+                    return kernel(arrays, 0, n, float_rays[k & mask], ray_t) >= 0 ? ray_t.max : 0.0;
+                });
+            }
+        }
+    }
+
+    /* Kernel checks */
+
+    if (filter.empty() || std::string("kernel_check").find(filter) != std::string::npos) {
+        failed_checks += check_sphere_kernels<double>("double");
+        failed_checks += check_sphere_kernels<float>("float");
+    }
+
+    /* Scattering */
+
+    {
+        auto hits = surface_hits(gen, pool_size);
+        lambertian diffuse(color(0.5, 0.5, 0.5));
+        metal      fuzzy(color(0.8, 0.8, 0.8), 0.3);
+        dialectric glass(1.5);
+
+        auto scatter_benchmark = [&](const std::string& name, const material& m) {
+            run_benchmark("scatter/" + name, [&](long k) {
+                const auto& hit = hits[k & mask];
+                color attenuation;
+                ray   scattered;
+                m.scatter(hit.first, hit.second, attenuation, scattered, gen);
+                return scattered.direction().x() + attenuation.x();
+            });
+        };
+        scatter_benchmark("lambertian", diffuse);
+        scatter_benchmark("metal", fuzzy);
+        scatter_benchmark("dialectric", glass);
+
+        // the same materials through the material_variant switch of closed_world
+        auto variant_benchmark = [&](const std::string& name, const material_variant& m) {
+            run_benchmark("scatter_variant/" + name, [&](long k) {
+                const auto& hit = hits[k & mask];
+                color attenuation;
+                ray   scattered;
+                scatter(m, hit.first, hit.second, attenuation, scattered, gen);
+                return scattered.direction().x() + attenuation.x();
+            });
+        };
+        variant_benchmark("lambertian", diffuse);
+        variant_benchmark("metal", fuzzy);
+        variant_benchmark("dialectric", glass);
+    }
+
+    /* Sampling */
+
+    run_benchmark("random_unit_vector", [&](long) {return random_unit_vector(gen).x();});
+    run_benchmark("random_in_unit_disk", [&](long) {return random_in_unit_disk(gen).x();});
+
+    {
+        // the main.cc camera
+        camera cam;
+        cam.aspect_ratio    = 16.0 / 9.0;
+        cam.image_width     = 1200;
+        cam.vfov            = 20;
+        cam.lookfrom        = point3(13,2,3);
+        cam.lookat          = point3(0,0,0);
+        cam.defocus_angle   = 0.6;
+        cam.focus_dist      = 10.0;
+        cam.initialize();
+
+        run_benchmark("camera_get_ray", [&](long k) {
+            return cam.get_ray(int(k % 1200), int(k / 1200 % 675), gen).direction().x();
+        });
+
+        /* Paths */
+
+        // whole camera paths through the main.cc scene for each world representation,
+        // ops are paths; objects and packed take virtual calls, closed takes none
+        // NOTE: intersection dominates a path, so the three measure the same within the
+        //       run-to-run noise (medians of six alternating runs on one core: objects 970,
+        //       packed 936, closed 985 ns/path, each spread over +-20%); closed saves memory
+        //       per sphere, not time per path, and its line below only reports the ratio
+        cam.max_depth = 50;
+        auto scene    = random_spheres_scene();
+        size_t objects_bytes, packed_bytes, closed_bytes;
+        auto objects  = scene.build_objects(&objects_bytes);
+        auto packed   = scene.build_packed(&packed_bytes);
+        auto closed   = scene.build_closed(&closed_bytes);
+
+        auto spheres  = scene.spheres.size();
+        std::clog << "bytes per sphere: objects " << objects_bytes / spheres << ", packed "
+                  << packed_bytes / spheres << ", closed " << closed_bytes / spheres << '\n';
+
+        auto path_benchmark = [&](const std::string& name, const auto& world) {
+            return run_benchmark("path/" + name, [&](long k) {
+                int  i = int(k * 7 % 1200), j = int(k * 7 / 1200 % 675);
+                rng  path_gen = rng::for_sample(0, uint64_t(j) * 1200 + i, 0);
+                int  bounces  = 0;
+                return cam.sample_pixel(world, i, j, path_gen, bounces).x();
+            });
+        };
+        path_benchmark("main_scene_objects", *objects);
+        auto packed_ns = path_benchmark("main_scene_packed", *packed);
+        auto closed_ns = path_benchmark("main_scene_closed", closed);
+        if (packed_ns > 0 && closed_ns > 0)
+            std::clog << "closed world path time: " << closed_ns / packed_ns << " x packed\n";
+
+        // the same paths traced by the wavefront integrator in waves of n paths
+        auto wavefront_benchmark = [&](const std::string& name, const auto& world) {
+            for (int n : {256, 4096}) {
+                path_queue paths;
+                run_benchmark("path/" + name + "_wavefront" + std::to_string(n), [&](long k) {
+                    int path = int(k % n);
+                    if (path == 0) {
+                        paths.clear();
+                        for (long p = k; p < k + n; p++) {
+                            int i = int(p * 7 % 1200), j = int(p * 7 / 1200 % 675);
+                            rng path_gen = rng::for_sample(0, uint64_t(j) * 1200 + i, 0);
+                            paths.push(cam.get_ray(i, j, path_gen), path_gen);
+                        }
+                        cam.trace_wavefront(world, paths);
+                    }
+                    return paths.colors[path].x();
+                });
+            }
+        };
+        wavefront_benchmark("main_scene_packed", *packed);
+        wavefront_benchmark("main_scene_closed", closed);
+
+        /* Primary rays */
+
+        // camera ray generation and first intersection over the image in scanline order,
+        // one ray at a time and in packets of block x block pixels; ops are rays
+        auto primary_benchmark = [&](const std::string& name, const auto& world) {
+            run_benchmark("primary/" + name + "_single", [&](long k) {
+                int  i = int(k % 1200), j = int(k / 1200 % 675);
+                rng  ray_gen = rng::for_sample(0, uint64_t(j) * 1200 + i, 0);
+                hit_record rec;
+                return world.hit(cam.get_ray(i, j, ray_gen), interval(0.001, infinity), rec) ? rec.t : 0.0;
+            });
+
+            for (int block : {2, 4, 8}) {
+                int        lanes = block * block;
+                ray_packet packet;
+                rng        gens[ray_packet::max_lanes];
+                hit_record recs[ray_packet::max_lanes];
+                uint64_t   hits  = 0;
+
+                run_benchmark("primary/" + name + "_packet" + std::to_string(block), [&](long k) {
+                    int lane = int(k % lanes);
+                    if (lane == 0) {
+                        long b  = k / lanes;
+                        int  bx = int(b % (1200 / block)) * block;
+                        int  by = int(b / (1200 / block) % (675 / block)) * block;
+                        for (int l = 0; l < lanes; l++)
+                            gens[l] = rng::for_sample(0, uint64_t(by + l / block) * 1200 + bx + l % block, 0);
+                        uint64_t all = lanes == 64 ? ~uint64_t(0) : (uint64_t(1) << lanes) - 1;
+                        cam.get_ray_packet(bx, by, block, all, gens, packet);
+                        hits = world.hit_packet(packet, interval(0.001, infinity), recs);
+                    }
+                    return (hits >> lane) & 1u ? recs[lane].t : 0.0;
+                });
+            }
+        };
+        primary_benchmark("main_scene_packed", *packed);
+        primary_benchmark("main_scene_closed", closed);
+
+        // the single precision path through the same scene
+        basic_camera<float> float_cam(cam);
+        float_cam.initialize();
+        auto closed_float = scene.build_closed<float>();
+        run_benchmark("path/main_scene_closed_float", [&](long k) {
+            int  i = int(k * 7 % 1200), j = int(k * 7 / 1200 % 675);
+            rng  path_gen = rng::for_sample(0, uint64_t(j) * 1200 + i, 0);
+            int  bounces  = 0;
+            return double(float_cam.sample_pixel(closed_float, i, j, path_gen, bounces).x());
+        });
+
+        /* Precision */
+
+        // image error of the float path against the double reference on a small render
+        // of the main.cc scene, both drawing the same samples
+        // NOTE: the linear rmse is about 0.0021; above precision_tolerance the float path
+        //       has lost accuracy and the check fails
+        if (filter.empty() || std::string("precision").find(filter) != std::string::npos) {
+            cam.image_width       = 320;
+            cam.samples_per_pixel = 16;
+            cam.thread_count      = 0;
+            float_cam = basic_camera<float>(cam);
+
+            auto log_buffer = std::clog.rdbuf(nullptr);     // silence the progress output
+            framebuffer reference = cam.render_image(closed);
+            framebuffer fast      = float_cam.render_image(closed_float);
+            std::clog.rdbuf(log_buffer);
+
+            double squared_error = 0, byte_squared_error = 0;
+            for (size_t k = 0; k < reference.data().size(); k++) {
+                for (int c = 0; c < 3; c++) {
+                    auto a = fmin(1.0, reference.data()[k][c]), b = fmin(1.0, fast.data()[k][c]);
+                    auto byte_a = component_to_byte(reference.data()[k][c]);
+                    auto byte_b = component_to_byte(fast.data()[k][c]);
+                    squared_error      += (a - b) * (a - b);
+                    byte_squared_error += double(byte_a - byte_b) * (byte_a - byte_b);
+                }
+            }
+            const double precision_tolerance = 0.004;
+            auto values = 3.0 * reference.data().size();
+            auto rmse   = sqrt(squared_error / values);
+            std::clog << "precision: float vs double image rmse " << rmse
+                      << " (linear), " << sqrt(byte_squared_error / values) << " (8 bit)\n";
+            if (rmse > precision_tolerance) {
+                std::clog << "precision: rmse above the tolerance of " << precision_tolerance << '\n';
+                failed_checks++;
+            }
+        }
+
+        /* Samplers */
+
+        // convergence of each sampler on a small render of the main.cc scene: image rmse
+        // against an independent 1024 spp reference with another seed, and the sample count
+        // the independent sampler needs for the same rmse, assuming its error falls as
+        // 1/sqrt(N)
+        if (filter.empty() || std::string("sampler").find(filter) != std::string::npos) {
+            camera convergence = cam;
+            convergence.image_width       = 96;
+            convergence.thread_count      = 0;
+            convergence.samples_per_pixel = 1024;
+            convergence.seed              = 1;
+
+            auto log_buffer = std::clog.rdbuf(nullptr);     // silence the progress output
+            framebuffer reference = convergence.render_image(closed);
+            std::clog.rdbuf(log_buffer);
+
+            auto image_rmse = [&](const framebuffer& image) {
+                double squared_error = 0;
+                for (size_t k = 0; k < image.data().size(); k++) {
+                    for (int c = 0; c < 3; c++) {
+                        auto a = fmin(1.0, reference.data()[k][c]), b = fmin(1.0, image.data()[k][c]);
+                        squared_error += (a - b) * (a - b);
+                    }
+                }
+                return sqrt(squared_error / (3.0 * image.data().size()));
+            };
+
+            convergence.seed = 0;
+            std::vector<double> independent_rmse;
+            for (std::string name : {"independent", "stratified", "sobol", "blue_noise"}) {
+                convergence.sampler = name;
+                int run = 0;
+                for (int samples : {4, 16, 64}) {
+                    convergence.samples_per_pixel = samples;
+                    log_buffer = std::clog.rdbuf(nullptr);
+                    auto rmse = image_rmse(convergence.render_image(closed));
+                    std::clog.rdbuf(log_buffer);
+
+                    if (name == "independent")
+                        independent_rmse.push_back(rmse);
+                    auto ratio = independent_rmse[run] / rmse;
+                    std::clog << "sampler: " << name << " at " << samples << " spp, rmse " << rmse
+                              << ", as independent at " << samples * ratio * ratio << " spp\n";
+                    run++;
+                }
+            }
+
+            // every sampler must draw the same values when the samples are split into
+            // ranges, so the merged ranges give the 8 bit image of the single render
+            // NOTE: the merged sums round differently, so the linear colors can differ in
+            //       their last bits
+            camera split = cam;
+            split.image_width  = 40;
+            split.thread_count = 0;
+            thread_pool pool(0);
+            for (std::string name : {"independent", "stratified", "sobol", "blue_noise"}) {
+                split.sampler           = name;
+                split.sample_first      = 0;
+                split.samples_per_pixel = 6;
+                split.sample_total      = 0;
+                log_buffer = std::clog.rdbuf(nullptr);
+                framebuffer single = split.render_accumulation(closed, pool).resolve();
+
+                split.sample_total      = 6;
+                split.samples_per_pixel = 3;
+                accumulation_buffer merged = split.render_accumulation(closed, pool);
+                split.sample_first      = 3;
+                merged.merge(split.render_accumulation(closed, pool));
+                std::clog.rdbuf(log_buffer);
+
+                framebuffer parts = merged.resolve();
+                bool same = true;
+                for (size_t k = 0; k < single.data().size(); k++)
+                    for (int c = 0; c < 3; c++)
+                        same = same && component_to_byte(single.data()[k][c]) == component_to_byte(parts.data()[k][c]);
+                std::clog << "sampler: " << name << " split into sample ranges "
+                          << (same ? "matches" : "differs from") << " the single render\n";
+                failed_checks += !same;
+            }
+        }
+
+        /* Denoiser */
+
+        // image rmse of a raw and a denoised 32 spp render and of a raw 500 spp render of
+        // the main.cc scene against an independent 1024 spp reference with another seed;
+        // the check fails unless denoising removes a quarter of the raw error
+        // NOTE: the image is 300 pixels wide since at much smaller sizes nearly every pixel
+        //       holds an edge, which no filter may smooth
+        if (filter.empty() || std::string("denoiser").find(filter) != std::string::npos) {
+            const double denoised_ratio = 0.75;     // largest accepted denoised / raw rmse
+            camera denoising = cam;
+            denoising.image_width       = 300;
+            denoising.thread_count      = 0;
+            denoising.samples_per_pixel = 1024;
+            denoising.seed              = 1;
+
+            auto log_buffer = std::clog.rdbuf(nullptr);     // silence the progress output
+            framebuffer reference = denoising.render_image(closed);
+            std::clog.rdbuf(log_buffer);
+
+            auto image_rmse = [&](const framebuffer& image) {
+                double squared_error = 0;
+                for (size_t k = 0; k < image.data().size(); k++) {
+                    for (int c = 0; c < 3; c++) {
+                        auto a = fmin(1.0, reference.data()[k][c]), b = fmin(1.0, image.data()[k][c]);
+                        squared_error += (a - b) * (a - b);
+                    }
+                }
+                return sqrt(squared_error / (3.0 * image.data().size()));
+            };
+
+            denoising.seed = 0;
+            double raw_rmse = 0, denoised_rmse = 0;
+            for (auto [samples, denoise] : {std::pair(32, false), std::pair(32, true), std::pair(500, false)}) {
+                denoising.samples_per_pixel = samples;
+                denoising.denoise           = denoise;
+                log_buffer = std::clog.rdbuf(nullptr);
+                auto rmse = image_rmse(denoising.render_image(closed));
+                std::clog.rdbuf(log_buffer);
+                std::clog << "denoiser: " << (denoise ? "denoised " : "raw ") << samples << " spp, rmse " << rmse << '\n';
+                if (samples == 32)
+                    (denoise ? denoised_rmse : raw_rmse) = rmse;
+            }
+            if (denoised_rmse > denoised_ratio * raw_rmse) {
+                std::clog << "denoiser: denoised rmse above " << denoised_ratio << " of the raw rmse\n";
+                failed_checks++;
+            }
+        }
+    }
+
+    /* Scene files */
+
+    // median time of 5 loads of a scene of one million spheres, ops are spheres
+    // NOTE: a load takes far longer than the other ops, so it is timed directly instead of
+    //       through run_benchmark
+    if (filter.empty() || std::string("scene_load").find(filter) != std::string::npos) {
+        const int sphere_count = 1000000;
+        scene_description big;
+        for (int m = 0; m < 64; m++)
+            big.add_material(lambertian(color::random(gen, 0, 1)));
+        big.spheres.reserve(sphere_count);
+        for (int k = 0; k < sphere_count; k++)
+            big.add_sphere(point3::random(gen, -1000, 1000), gen.random_double(0.1, 2.0), k % 64);
+
+        camera_settings settings;
+        auto directory = std::filesystem::temp_directory_path();
+        for (std::string format : {"binary", "text"}) {
+            auto path = (directory / (format == "binary" ? "bench_scene.rtsb" : "bench_scene.rtst")).string();
+            std::string error;
+            if (!scene_file::save(path, big, settings, error)) {
+                std::clog << "scene_load: " << error << '\n';
+                continue;
+            }
+
+            std::vector<double> ns_per_sphere;
+            for (int run = 0; run < 5; run++) {
+                scene_description loaded;
+                auto start = std::chrono::steady_clock::now();
+                scene_file::load(path, loaded, settings, error);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                sink = double(loaded.spheres.size());
+                ns_per_sphere.push_back(1e9 * elapsed.count() / sphere_count);
+            }
+            std::sort(ns_per_sphere.begin(), ns_per_sphere.end());
+            std::remove(path.c_str());
+
+            double median = ns_per_sphere[2];
+            std::cout << "scene_load/" << format << "_1m_spheres," << median << ',' << 1e9 / median << '\n';
+            std::clog << "scene_load: " << format << " file of 1M spheres in " << median * sphere_count / 1e6
+                      << " ms\n";
+        }
+    }
+
+    /* Triangle meshes */
+
+    // median time of 5 loads of a mesh of one million triangles from a binary and an OBJ
+    // file and of 5 hierarchy builds over it, ops are triangles; then random rays around
+    // its center, ops are rays
+    if (filter.empty() || std::string("mesh").find(filter) != std::string::npos) {
+        auto sphere_mesh = uv_sphere_mesh(500, 1000);
+        auto triangles   = double(sphere_mesh->triangle_count());
+        auto directory   = std::filesystem::temp_directory_path();
+        auto report      = [&](const std::string& name, std::vector<double> ns_per_triangle) {
+            std::sort(ns_per_triangle.begin(), ns_per_triangle.end());
+            double median = ns_per_triangle[2];
+            std::cout << "mesh/" << name << "_1m_triangles," << median << ',' << 1e9 / median << '\n';
+            std::clog << "mesh: " << name << " of 1M triangles in " << median * triangles / 1e6 << " ms\n";
+        };
+
+        for (std::string format : {"binary", "obj"}) {
+            auto path = (directory / (format == "binary" ? "bench_mesh.rtm" : "bench_mesh.obj")).string();
+            std::string error;
+            if (format == "binary") {
+                if (!mesh_file::save(path, *sphere_mesh, error)) {
+                    std::clog << "mesh: " << error << '\n';
+                    continue;
+                }
+            }
+            else {
+                std::FILE* out = std::fopen(path.c_str(), "w");
+                if (out == nullptr)
+                    continue;
+                const float* p = sphere_mesh->positions();
+                for (size_t v = 0; v < sphere_mesh->vertex_count(); v++)
+                    std::fprintf(out, "v %.9g %.9g %.9g\n", p[3*v], p[3*v + 1], p[3*v + 2]);
+                const uint32_t* index = sphere_mesh->indices();
+                for (size_t t = 0; t < sphere_mesh->triangle_count(); t++)
+                    std::fprintf(out, "f %u %u %u\n", index[3*t] + 1, index[3*t + 1] + 1, index[3*t + 2] + 1);
+                std::fclose(out);
+            }
+
+            std::vector<double> ns_per_triangle;
+            for (int run = 0; run < 5; run++) {
+                shared_ptr<const mesh_buffers> loaded;
+                auto start = std::chrono::steady_clock::now();
+                mesh_file::load(path, loaded, error);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                sink = loaded ? double(loaded->triangle_count()) : 0;
+                ns_per_triangle.push_back(1e9 * elapsed.count() / triangles);
+            }
+            std::remove(path.c_str());
+            report("load_" + format, ns_per_triangle);
+        }
+
+        auto gray = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+        std::vector<double> ns_per_triangle;
+        shared_ptr<triangle_mesh> mesh;
+        for (int run = 0; run < 5; run++) {
+            auto start = std::chrono::steady_clock::now();
+            mesh = make_shared<triangle_mesh>(sphere_mesh, gray);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            ns_per_triangle.push_back(1e9 * elapsed.count() / triangles);
+        }
+        report("build", ns_per_triangle);
+
+        auto rays = random_rays(gen, 4096);
+        run_benchmark("mesh/hit_1m_triangles", [&](long k) {
+            hit_record rec;
+            return mesh->hit(rays[k & 4095], interval(0.001, infinity), rec) ? rec.t : 0.0;
+        });
+    }
+
+    return failed_checks > 0 ? 1 : 0;
+}
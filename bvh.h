@@ -0,0 +1,486 @@
+#ifndef BVH_H   // start of bvh header file
+#define BVH_H   // bvh_tree and bvh_node class definitions
+
+// Import libraries
+#include "rtweekend.h"
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "render_stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+// bounding volume hierarchy over a set of primitive boxes
+// 1. built top-down with the surface area heuristic (SAH), evaluated over binned centroids
+// 2. stored as a flat array of nodes in depth-first order: the first child of an interior
+//    node is the next node in the array, the node records where its second child starts
+// 3. traversed with an explicit stack, visiting the child nearer to the ray origin first
+// NOTE: the tree only knows about boxes, the caller supplies the primitive test, so the
+//       same tree serves any kind of primitive storage
+// 4. nodes hold boxes of the scalar type T, so a float tree takes about half the memory
+// 5. the depth is capped at stack_depth, the size of the traversal stacks: close to the cap
+//    the build splits at the centroid median instead, so skewed inputs (e.g. boxes at
+//    exponentially growing distances) still give a tree the stacks can walk
+template <typename T>
+class basic_bvh_tree {
+    public:
+        struct node {
+            basic_aabb<T> bbox;     // box enclosing everything below the node
+            int     offset;         // interior: index of the second child; leaf: first slot
+            int     prim_count;     // number of primitives in a leaf, 0 for interior nodes
+            int     axis;           // split axis of an interior node
+        };
+
+        std::vector<node>   nodes;          // flattened tree, nodes[0] is the root
+        std::vector<int>    prim_indices;   // original primitive index of every leaf slot
+
+        // builds the tree over boxes[i] for every primitive i
+        // NOTE: leaves reference primitives by slot, callers either look up
+        //       prim_indices[slot] or reorder their primitive storage by prim_indices
+        void build(const std::vector<basic_aabb<T>>& boxes, int max_leaf_size = 4) {
+            nodes.clear();
+            built_areas.clear();
+            prim_indices.resize(boxes.size());
+            for (size_t i = 0; i < boxes.size(); i++)
+                prim_indices[i] = int(i);
+
+            if (boxes.empty())
+                return;
+
+            centroids.resize(boxes.size());
+            for (size_t i = 0; i < boxes.size(); i++)
+                centroids[i] = boxes[i].centroid();
+
+            nodes.reserve(2 * boxes.size());
+            build_recursive(boxes, 0, int(boxes.size()), std::max(1, max_leaf_size), 0);
+
+            centroids.clear();
+            centroids.shrink_to_fit();
+            nodes.shrink_to_fit();      // the reserve above is an upper bound
+        }
+
+        // bytes held by the nodes and the slot table
+        size_t memory_bytes() const {
+            return nodes.capacity() * sizeof(node) + prim_indices.capacity() * sizeof(int)
+                 + built_areas.capacity() * sizeof(T);
+        }
+
+        // returns the box enclosing every primitive (empty for an empty tree)
+        basic_aabb<T> bounding_box() const {
+            return nodes.empty() ? basic_aabb<T>::empty : nodes[0].bbox;
+        }
+
+        // refits every node box in place to primitives that moved since the build, keeping
+        // the topology: slot_box(slot) returns the current box of the primitive in a leaf
+        // slot, leaves take the union of their slots and interior nodes of their children
+        // NOTE: children always follow their parent in the array, so one pass from the back
+        //       visits every node after both of its children
+        template <typename slot_box_function>
+        void refit(slot_box_function&& slot_box) {
+            if (built_areas.size() != nodes.size()) {
+                built_areas.resize(nodes.size());
+                for (size_t k = 0; k < nodes.size(); k++)
+                    built_areas[k] = nodes[k].bbox.surface_area();
+            }
+
+            for (int k = int(nodes.size()) - 1; k >= 0; k--) {
+                node& n = nodes[k];
+                if (n.prim_count > 0) {
+                    basic_aabb<T> box;
+                    for (int slot = n.offset; slot < n.offset + n.prim_count; slot++)
+                        box = basic_aabb<T>(box, slot_box(slot));
+                    n.bbox = box;
+                }
+                else
+                    n.bbox = basic_aabb<T>(nodes[k + 1].bbox, nodes[n.offset].bbox);
+            }
+        }
+
+        // mean ratio of every node's surface area to its area when the tree was built (1
+        // until the first refit); refit boxes around moved primitives grow and overlap, and
+        // rays visit more of them, so this tells when a rebuild pays off
+        // NOTE: a mean over the nodes rather than the SAH cost relative to the root, which a
+        //       single huge primitive (a ground sphere) would dominate
+        double area_growth() const {
+            double growth = 0;
+            int    counted = 0;
+            for (size_t k = 0; k < built_areas.size(); k++) {
+                if (built_areas[k] <= 0)
+                    continue;
+                growth += double(nodes[k].bbox.surface_area()) / double(built_areas[k]);
+                counted++;
+            }
+            return counted > 0 ? growth / counted : 1;
+        }
+
+        // walks the tree front-to-back and calls hit_slot(slot, ray_t) for every primitive
+        // whose leaf box the ray reaches; hit_slot returns true on a hit and lowers
+        // ray_t.max to the hit distance so farther boxes are culled
+        // returns true if any primitive was hit
+        template <typename slot_hit_function>
+        bool traverse(const basic_ray<T>& r, basic_interval<T> ray_t, slot_hit_function&& hit_slot) const {
+            return traverse_leaves(r, ray_t, [&](int first, int count, basic_interval<T>& t) {
+                bool hit_anything = false;
+                for (int slot = first; slot < first + count; slot++) {
+                    if (hit_slot(slot, t))
+                        hit_anything = true;
+                }
+                return hit_anything;
+            });
+        }
+
+        // same walk as traverse, but hands whole leaves to hit_leaf(first, count, ray_t),
+        // for callers that test the slots of a leaf together
+        template <typename leaf_hit_function>
+        bool traverse_leaves(const basic_ray<T>& r, basic_interval<T> ray_t, leaf_hit_function&& hit_leaf) const {
+            if (nodes.empty())
+                return false;
+
+            const basic_vec3<T>& orig = r.origin();
+            const basic_vec3<T>& dir  = r.direction();
+            basic_vec3<T> inv_dir(1/dir.x(), 1/dir.y(), 1/dir.z());
+            bool dir_is_neg[3] = {inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0};
+
+            bool     hit_anything   = false;
+            int      stack[stack_depth];
+            int      stack_size     = 0;
+            int      current        = 0;
+            uint64_t nodes_visited  = 0;
+
+            while (true) {
+                const node& n = nodes[current];
+                nodes_visited++;
+                if (n.bbox.hit(orig, inv_dir, ray_t)) {
+                    if (n.prim_count > 0) {
+                        // leaf: test its primitives
+                        if (hit_leaf(n.offset, n.prim_count, ray_t))
+                            hit_anything = true;
+                    }
+                    else if (dir_is_neg[n.axis]) {
+                        // the second child lies nearer to the ray origin along the split axis
+                        assert(stack_size < stack_depth);
+                        stack[stack_size++] = current + 1;
+                        current = n.offset;
+                        continue;
+                    }
+                    else {
+                        assert(stack_size < stack_depth);
+                        stack[stack_size++] = n.offset;
+                        current = current + 1;
+                        continue;
+                    }
+                }
+
+                if (stack_size == 0)
+                    break;
+                current = stack[--stack_size];
+            }
+
+            RT_STATS_COUNT(bvh_nodes += nodes_visited);
+            return hit_anything;
+        }
+
+        // walks the tree once for a whole ray packet and calls hit_leaf(first, count, lanes)
+        // for every leaf whose box at least one active lane reaches, where lanes is the mask
+        // of those lanes
+        // t_max[l] is the far limit of lane l; hit_leaf lowers it on a hit so farther boxes
+        // are culled lane by lane, exactly like traverse does for a single ray
+        // NOTE: children are visited in the order the first active lane prefers, which is
+        //       the order of nearly every lane of a coherent packet
+        template <typename leaf_hit_function>
+        void traverse_packet(const basic_ray_packet<T>& packet, T t_min, T* t_max, leaf_hit_function&& hit_leaf) const {
+            switch (packet.lanes) {
+                case 4:  traverse_packet_lanes<4>(packet, t_min, t_max, hit_leaf);  break;
+                case 16: traverse_packet_lanes<16>(packet, t_min, t_max, hit_leaf); break;
+                default: traverse_packet_lanes<64>(packet, t_min, t_max, hit_leaf); break;
+            }
+        }
+
+    private:
+        static constexpr int    bin_count       = 16;
+        static constexpr int    stack_depth     = 64;       // deepest tree the traversal stacks can walk
+        static constexpr double traversal_cost  = 0.125;   // relative to one primitive test
+
+        std::vector<basic_vec3<T>> centroids;  // primitive box centers, only used during build
+        std::vector<T>  built_areas;            // node areas after the build, kept from the first refit on
+
+        struct bin {
+            basic_aabb<T> bbox;
+            int     count = 0;
+        };
+
+        // traverse_packet for packets of N lanes, so every per-lane loop has a fixed length
+        template <int N, typename leaf_hit_function>
+        void traverse_packet_lanes(const basic_ray_packet<T>& packet, T t_min, T* t_max,
+                                   leaf_hit_function& hit_leaf) const
+        {
+            if (nodes.empty() || packet.active == 0)
+                return;
+
+            alignas(64) T inv_x[N], inv_y[N], inv_z[N];
+            for (int l = 0; l < N; l++) {
+                inv_x[l] = 1/packet.dx[l];
+                inv_y[l] = 1/packet.dy[l];
+                inv_z[l] = 1/packet.dz[l];
+            }
+            int lead = 0;
+            while (!packet.is_active(lead))
+                lead++;
+            bool dir_is_neg[3] = {inv_x[lead] < 0, inv_y[lead] < 0, inv_z[lead] < 0};
+
+            // every stack entry carries the lanes that reached its parent
+            int      stack[stack_depth];
+            uint64_t stack_lanes[stack_depth];
+            int      stack_size     = 0;
+            int      current        = 0;
+            uint64_t lanes          = packet.active;
+            uint64_t nodes_visited  = 0;
+
+            while (true) {
+                const node& n = nodes[current];
+                nodes_visited++;
+                lanes = box_lanes<N>(n.bbox, packet, inv_x, inv_y, inv_z, t_min, t_max) & lanes;
+                if (lanes != 0) {
+                    if (n.prim_count > 0) {
+                        hit_leaf(n.offset, n.prim_count, lanes);
+                    }
+                    else {
+                        bool second_first = dir_is_neg[n.axis];
+                        assert(stack_size < stack_depth);
+                        stack_lanes[stack_size] = lanes;
+                        stack[stack_size++]     = second_first ? current + 1 : n.offset;
+                        current                 = second_first ? n.offset : current + 1;
+                        continue;
+                    }
+                }
+
+                if (stack_size == 0)
+                    break;
+                current = stack[--stack_size];
+                lanes   = stack_lanes[stack_size];
+            }
+
+            RT_STATS_COUNT(bvh_nodes += nodes_visited);
+        }
+
+        // mask of the lanes whose ray reaches box within [t_min, t_max[l]]; the same slab
+        // test as aabb::hit, written without branches so the loop vectorizes
+        template <int N>
+        static uint64_t box_lanes(const basic_aabb<T>& box, const basic_ray_packet<T>& packet,
+                                  const T* inv_x, const T* inv_y, const T* inv_z, T t_min, const T* t_max)
+        {
+            const T* orig[3] = {packet.ox, packet.oy, packet.oz};
+            const T* inv[3]  = {inv_x, inv_y, inv_z};
+
+            alignas(64) T lo[N], hi[N];
+            for (int l = 0; l < N; l++) {
+                lo[l] = t_min;
+                hi[l] = t_max[l];
+            }
+            for (int axis = 0; axis < 3; axis++) {
+                const basic_interval<T>& ax = box.axis_interval(axis);
+                for (int l = 0; l < N; l++) {
+                    T t0 = (ax.min - orig[axis][l]) * inv[axis][l];
+                    T t1 = (ax.max - orig[axis][l]) * inv[axis][l];
+                    T near_t = t0 > t1 ? t1 : t0;
+                    T far_t  = t0 > t1 ? t0 : t1;
+                    lo[l] = near_t > lo[l] ? near_t : lo[l];
+                    hi[l] = far_t < hi[l] ? far_t : hi[l];
+                }
+            }
+
+            uint64_t lanes = 0;
+            for (int l = 0; l < N; l++)
+                lanes |= uint64_t(!(hi[l] < lo[l])) << l;
+            return lanes;
+        }
+
+        // builds the subtree over prim_indices[begin, end) and returns its node index
+        int build_recursive(const std::vector<basic_aabb<T>>& boxes, int begin, int end, int max_leaf_size, int depth) {
+            int node_index = int(nodes.size());
+            nodes.push_back(node{});
+
+            basic_aabb<T> bounds;
+            basic_aabb<T> centroid_bounds;
+            for (int i = begin; i < end; i++) {
+                const auto& c   = centroids[prim_indices[i]];
+                bounds          = basic_aabb<T>(bounds, boxes[prim_indices[i]]);
+                centroid_bounds = basic_aabb<T>(centroid_bounds, basic_aabb<T>(c, c));
+            }
+            nodes[node_index].bbox = bounds;
+
+            int count = end - begin;
+            int axis  = centroid_bounds.longest_axis();
+            const basic_interval<T>& extent = centroid_bounds.axis_interval(axis);
+
+            // close to the depth cap: median splits halve the count on every level, so the
+            // subtree ends within the levels that are left
+            int levels_needed = 0;
+            while ((1 << levels_needed) < count)
+                levels_needed++;
+            if (depth + levels_needed >= stack_depth - 4) {
+                if (count <= max_leaf_size) {
+                    make_leaf(node_index, begin, count);
+                    return node_index;
+                }
+                int mid = begin + count/2;
+                std::nth_element(prim_indices.begin() + begin, prim_indices.begin() + mid, prim_indices.begin() + end,
+                                 [&](int a, int b) {return centroids[a][axis] < centroids[b][axis];});
+                make_interior(boxes, node_index, begin, mid, end, axis, max_leaf_size, depth);
+                return node_index;
+            }
+
+            // all centroids coincide, no split can separate them
+            if (count <= 1 || extent.size() <= 0) {
+                if (count <= max_leaf_size) {
+                    make_leaf(node_index, begin, count);
+                    return node_index;
+                }
+                int mid = begin + count/2;
+                make_interior(boxes, node_index, begin, mid, end, axis, max_leaf_size, depth);
+                return node_index;
+            }
+
+            // find the cheapest bin boundary over all three axes
+            double  best_cost   = infinity;
+            int     best_axis   = -1;
+            int     best_split  = 0;
+            for (int a = 0; a < 3; a++) {
+                const basic_interval<T>& ax = centroid_bounds.axis_interval(a);
+                if (ax.size() <= 0)
+                    continue;
+
+                bin bins[bin_count];
+                for (int i = begin; i < end; i++) {
+                    int b = bin_index(centroids[prim_indices[i]][a], ax);
+                    bins[b].count++;
+                    bins[b].bbox = basic_aabb<T>(bins[b].bbox, boxes[prim_indices[i]]);
+                }
+
+                // sweep from the right to get the area and count right of every boundary
+                double  right_area[bin_count];
+                int     right_count[bin_count];
+                basic_aabb<T> right_box;
+                int     right_total = 0;
+                for (int b = bin_count - 1; b > 0; b--) {
+                    right_box    = basic_aabb<T>(right_box, bins[b].bbox);
+                    right_total += bins[b].count;
+                    right_area[b]  = right_box.surface_area();
+                    right_count[b] = right_total;
+                }
+
+                basic_aabb<T> left_box;
+                int     left_total = 0;
+                for (int b = 1; b < bin_count; b++) {
+                    left_box    = basic_aabb<T>(left_box, bins[b-1].bbox);
+                    left_total += bins[b-1].count;
+                    if (left_total == 0 || right_count[b] == 0)
+                        continue;
+
+                    double cost = left_total * left_box.surface_area() + right_count[b] * right_area[b];
+                    if (cost < best_cost) {
+                        best_cost   = cost;
+                        best_axis   = a;
+                        best_split  = b;
+                    }
+                }
+            }
+
+            double parent_area = bounds.surface_area();
+            double split_cost  = parent_area > 0
+                               ? traversal_cost + best_cost / parent_area
+                               : infinity;
+
+            if (count <= max_leaf_size && (best_axis < 0 || count <= split_cost)) {
+                make_leaf(node_index, begin, count);
+                return node_index;
+            }
+
+            int mid;
+            if (best_axis < 0) {
+                mid = begin + count/2;
+            }
+            else {
+                axis = best_axis;
+                const basic_interval<T>& ax = centroid_bounds.axis_interval(axis);
+                auto first_right = std::partition(
+                    prim_indices.begin() + begin, prim_indices.begin() + end,
+                    [&](int prim) {return bin_index(centroids[prim][axis], ax) < best_split;});
+                mid = int(first_right - prim_indices.begin());
+            }
+
+            make_interior(boxes, node_index, begin, mid, end, axis, max_leaf_size, depth);
+            return node_index;
+        }
+
+        void make_leaf(int node_index, int begin, int count) {
+            nodes[node_index].offset     = begin;
+            nodes[node_index].prim_count = count;
+            nodes[node_index].axis       = 0;
+        }
+
+        void make_interior(const std::vector<basic_aabb<T>>& boxes, int node_index, int begin, int mid, int end,
+                           int axis, int max_leaf_size, int depth)
+        {
+            build_recursive(boxes, begin, mid, max_leaf_size, depth + 1);
+            int second = build_recursive(boxes, mid, end, max_leaf_size, depth + 1);
+
+            nodes[node_index].offset     = second;
+            nodes[node_index].prim_count = 0;
+            nodes[node_index].axis       = axis;
+        }
+
+        static int bin_index(T value, const basic_interval<T>& extent) {
+            int b = int(bin_count * (value - extent.min) / extent.size());
+            return std::min(std::max(b, 0), bin_count - 1);
+        }
+};
+
+using bvh_tree = basic_bvh_tree<double>;
+
+// hittable wrapper that replaces the linear scan of a hittable_list with a bvh_tree
+template <typename T>
+class basic_bvh_node : public basic_hittable<T> {
+    public:
+        basic_bvh_node(const basic_hittable_list<T>& list) : basic_bvh_node(list.objects) {}
+
+        basic_bvh_node(const std::vector<shared_ptr<basic_hittable<T>>>& src_objects) {
+            std::vector<basic_aabb<T>> boxes;
+            boxes.reserve(src_objects.size());
+            for (const auto& object : src_objects)
+                boxes.push_back(object->bounding_box());
+
+            tree.build(boxes);
+
+            // store the objects in leaf order so every leaf reads a contiguous run
+            objects.reserve(src_objects.size());
+            for (int prim : tree.prim_indices)
+                objects.push_back(src_objects[prim]);
+        }
+
+        bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+            return tree.traverse(r, ray_t, [&](int slot, basic_interval<T>& t) {
+                if (!objects[slot]->hit(r, t, rec))
+                    return false;
+                t.max = rec.t;
+                return true;
+            });
+        }
+
+        basic_aabb<T> bounding_box() const override {return tree.bounding_box();}
+
+        // bytes held by the hierarchy and the object pointers, not by the objects themselves
+        size_t memory_bytes() const {
+            return tree.memory_bytes() + objects.capacity() * sizeof(shared_ptr<basic_hittable<T>>);
+        }
+
+    private:
+        basic_bvh_tree<T>                           tree;
+        std::vector<shared_ptr<basic_hittable<T>>>  objects;    // objects in leaf slot order
+};
+
+using bvh_node = basic_bvh_node<double>;
+
+#endif  // end of bvh header file
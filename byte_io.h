@@ -0,0 +1,50 @@
+#ifndef BYTE_IO_H   // start of byte_io header file
+#define BYTE_IO_H   // little-endian byte helper definitions
+
+// Import libraries
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// little-endian encoding of the fixed size fields of the binary file formats (scene
+// files, partial accumulation buffers, meshes), independent of the host byte order
+// NOTE: doubles are stored as the bits of their IEEE 754 representation
+
+inline void put_u32(std::vector<unsigned char>& bytes, uint32_t value) {
+    for (int b = 0; b < 4; b++)
+        bytes.push_back((unsigned char)(value >> (8*b)));
+}
+
+inline void put_u64(std::vector<unsigned char>& bytes, uint64_t value) {
+    for (int b = 0; b < 8; b++)
+        bytes.push_back((unsigned char)(value >> (8*b)));
+}
+
+inline void put_f64(std::vector<unsigned char>& bytes, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_u64(bytes, bits);
+}
+
+inline uint32_t get_u32(const unsigned char* src) {
+    uint32_t value = 0;
+    for (int b = 0; b < 4; b++)
+        value |= uint32_t(src[b]) << (8*b);
+    return value;
+}
+
+inline uint64_t get_u64(const unsigned char* src) {
+    uint64_t value = 0;
+    for (int b = 0; b < 8; b++)
+        value |= uint64_t(src[b]) << (8*b);
+    return value;
+}
+
+inline double get_f64(const unsigned char* src) {
+    uint64_t bits = get_u64(src);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+#endif  // end of byte_io header file
@@ -5,10 +5,28 @@
 #include "rtweekend.h"
 #include "hittable.h"
 #include "material.h"
+#include "ray_packet.h"
+#include "wavefront.h"
+#include "accumulation_buffer.h"
+#include "denoiser.h"
+#include "framebuffer.h"
+#include "image_encoder.h"
+#include "render_stats.h"
+#include "sampler.h"
+#include "thread_pool.h"
 
-// 1. Constructs and dispatches rays into the world
-// 2. Uses the results of these rays to construct a rendered image
-class camera {
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Public camera parameters, shared by the cameras of every scalar type
+class camera_settings {
     public:
         /* Public Camera Parameters*/
         double  aspect_ratio        = 1.0;  // Ratio of image width over height
@@ -24,35 +42,317 @@ class camera {
         double defocus_angle =  0;  // Variation angle of rays through each pixel
         double focus_dist  = 10;    // Distance from camera lookfrom point to plane of perfect focus (focus plane)
         
-        // Render an image
-        void render(const hittable& world) {
-            initialize();
+        int     thread_count    = 1;    // Worker threads used by render (0 uses every hardware thread)
+        int     tile_size       = 16;   // Width and height of the square image tiles handed to workers
+        uint64_t seed           = 0;    // Seed of the per-sample random number streams
+        int     roulette_depth  = 0;    // Bounces before Russian roulette may end a path (0 disables it)
+        int     packet_size     = 0;    // Width of the pixel blocks traced as primary ray packets (2, 4 or 8; 0 traces single rays)
+        int     wavefront_size  = 0;    // Paths each worker traces together bounce by bounce (0 traces one path at a time)
+        std::string sampler     = "independent";    // Sample dimensions: "independent", "stratified", "sobol" or "blue_noise"
 
-            std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+        std::string output_format = "p3";   // Image format written by render ("p3", "p6", "pfm", "qoi")
 
-            // pixels are written in rows from left -> right and top -> bottom
-            for (int j = 0; j <= image_height; j++) {        // Rows
-                std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
-                for (int i = 0; i < image_width; i++) {     // Columns
-                // additive pixel color
-                    color pixel_color(0,0,0);
-                    for (int sample = 0; sample < samples_per_pixel; sample++) {
-                        ray r = get_ray(i, j);
-                        // define pixel color
-                        pixel_color += ray_color(r, max_depth, world);
+        int         samples_per_pass    = 0;        // Samples per pixel added by each progressive pass (0 renders all in one pass)
+        std::string checkpoint_path     = "";       // File the accumulation buffer is saved to ("" disables checkpoints)
+        double      checkpoint_interval = 60;       // Minimum seconds between checkpoint saves
+        bool        resume              = false;    // Continue from the samples stored in checkpoint_path
+        double      time_budget         = 0;        // Seconds the sampling may take, up to samples_per_pixel (0: no deadline)
+
+        bool        adaptive_sampling   = false;    // Stop sampling a pixel once its estimate has converged
+        int         adaptive_min_samples = 16;      // Samples every pixel takes before convergence is tested
+        double      adaptive_threshold  = 0.02;     // Accepted 95% confidence half-width, relative to pixel luminance
+        std::string sample_heatmap_path = "";       // Image file showing the samples taken per pixel ("" disables it)
+
+        std::string stats_path          = "";       // JSON file for the render statistics (needs a -DRT_STATS build)
+
+        int         region_x0           = 0;        // Left edge of the rendered pixel region
+        int         region_y0           = 0;        // Top edge of the rendered pixel region
+        int         region_x1           = -1;       // Right edge of the region, exclusive (-1: image edge)
+        int         region_y1           = -1;       // Bottom edge of the region, exclusive (-1: image edge)
+        int         tile_share          = 0;        // Renders only the tiles t of the region with t % tile_shares == tile_share
+        int         tile_shares         = 1;        // Number of processes sharing the tiles of the region
+        int         sample_first        = 0;        // Index of the first sample every pixel takes (for sample range assignments)
+        int         sample_total        = 0;        // Samples per pixel of the whole render a sample range is part of (0: sample_first + samples_per_pixel)
+        std::string partial_path        = "";       // File render writes the accumulation buffer to instead of the image ("" writes the image)
+
+        bool        denoise             = false;    // Filter the image with the AOV guided nlmeans_denoiser
+        std::string aov_path            = "";       // Prefix of the normal, albedo and depth image files (<prefix>.normal.pfm, ...; "" writes none)
+        int         aov_samples         = 8;        // Primary rays per pixel averaged into the AOV images
+
+        // samples per pixel of the whole render, which the stratified sampler lays its
+        // strata out for, so every sample range draws the values of the single render
+        int sampler_samples() const {return sample_total > 0 ? sample_total : sample_first + samples_per_pixel;}
+};
+
+// 1. Constructs and dispatches rays into the world
+// 2. Uses the results of these rays to construct a rendered image
+// 3. Traces paths in the scalar type T, against worlds built for T; camera is the double
+//    reference path, basic_camera<float> the fast single precision one
+template <typename T>
+class basic_camera : public camera_settings {
+    public:
+        basic_camera() {}
+
+        // camera of this scalar type with the parameters of another camera
+        explicit basic_camera(const camera_settings& settings) : camera_settings(settings) {}
+
+        // Render an image and write it to standard output in output_format, or with a
+        // partial_path, write the accumulation buffer to that file for merging instead;
+        // returns false after printing why if nothing could be written
+        // NOTE: World is a hittable, or a scene type with the same non-virtual hit plus a
+        //       scatter member, such as closed_world
+        template <typename World>
+        bool render(const World& world) {
+            auto encoder = make_image_encoder(output_format);
+            if (!encoder) {
+                std::cerr << "Unknown output format: " << output_format << '\n';
+                return false;
+            }
+            if (sampler != "independent" && !make_pixel_sampler(sampler, sampler_samples(), image_width, seed)) {
+                std::cerr << "Unknown sampler: " << sampler << '\n';
+                return false;
+            }
+            // the sample counts go unsigned in render_accumulation, a negative one would
+            // become billions of samples
+            if (samples_per_pixel < 0 || samples_per_pass < 0) {
+                std::cerr << "Invalid sample count: " << samples_per_pixel << " samples per pixel, "
+                          << samples_per_pass << " per pass\n";
+                return false;
+            }
+
+            thread_pool pool(thread_count);
+            accumulation_buffer accum = render_accumulation(world, pool);
+            if (!partial_path.empty()) {
+                if (!accum.save(partial_path, seed)) {
+                    std::cerr << "Could not write partial buffer " << partial_path << '\n';
+                    return false;
+                }
+                return true;
+            }
+            framebuffer image = finish_image(world, pool, accum);
+
+            if (encoder->binary())
+                set_stdout_binary();
+            encoder->write(image, std::cout);
+            std::cout.flush();
+            return bool(std::cout);
+        }
+
+        // Render an image into a framebuffer of linear colors
+        // 1. The image is split into tiles that a work-stealing thread pool renders
+        //    into a shared accumulation buffer
+        // 2. Every pixel sample draws from its own generator, seeded by (seed, pixel, sample),
+        //    so the image is bit-identical for every thread count; with a sampler other than
+        //    "independent" the pixel offset, lens position and bounce directions of the sample
+        //    come from that pixel_sampler (see sampler.h) instead
+        // 3. With samples_per_pass > 0 the samples are added in progressive passes over the
+        //    whole image, and the buffer is saved to checkpoint_path between passes at most
+        //    every checkpoint_interval seconds; resume continues from that file
+        // 4. With adaptive_sampling, a pixel stops taking samples once the confidence interval
+        //    of its luminance is narrow enough (at most samples_per_pixel samples)
+        // 5. With packet_size > 1 the primary rays of packet_size x packet_size pixel blocks
+        //    are generated and intersected as one packet (World needs a hit_packet member)
+        // 6. With wavefront_size > 0 paths are traced in waves instead, see trace_wavefront
+        // 7. With denoise the image is filtered by nlmeans_denoiser, guided by AOV images
+        //    from render_aovs, which are also written to files with an aov_path
+        // 8. A distributed render gives each process a pixel region (region_*), a share of
+        //    its tiles (tile_share of tile_shares, interleaved so every share gets a mix of
+        //    cheap and expensive tiles) or a range of sample indices (sample_first,
+        //    samples_per_pixel, out of sample_total); pixels a process does not render keep
+        //    0 samples, and merging the partial buffers, see accumulation_buffer::merge,
+        //    gives the image of a single render
+        //    NOTE: a sample range other than the last needs sample_total, since the strata
+        //          of the stratified sampler depend on the sample count of the whole render
+        // 9. With a time_budget the samples are added in passes sized from the measured time
+        //    per sample of the previous pass, so the next pass still fits before the deadline;
+        //    sampling stops when none does, and tiles not yet started when the deadline
+        //    passes are skipped, which leaves them a pass behind but still normalized by
+        //    their own sample counts
+        //    NOTE: the first pass (1 sample, or samples_per_pass) always completes, so every
+        //          pixel has a sample however short the budget
+        template <typename World>
+        framebuffer render_image(const World& world) {
+            thread_pool pool(thread_count);
+            return render_image(world, pool);
+        }
+
+        // the same on the workers of an existing pool, which then decides the thread count;
+        // a long-running process keeps one pool for all its renders instead of starting
+        // threads for each
+        template <typename World>
+        framebuffer render_image(const World& world, thread_pool& pool) {
+            return finish_image(world, pool, render_accumulation(world, pool));
+        }
+
+        // the same, accumulating into accum, whose memory is reused from render to render
+        template <typename World>
+        framebuffer render_image(const World& world, thread_pool& pool, accumulation_buffer& accum) {
+            render_accumulation(world, pool, accum);
+            return finish_image(world, pool, accum);
+        }
+
+        // normal, albedo and depth at the first hit of the primary rays of the first
+        // aov_samples samples of every pixel, averaged per pixel
+        // NOTE: the rays are those of the image samples, drawn from copies of their
+        //       generators, so the AOVs are antialiased like the image and leave it unchanged
+        template <typename World>
+        aov_buffers render_aovs(const World& world, thread_pool& pool) {
+            initialize();
+            aov_buffers aovs{framebuffer(image_width, image_height), framebuffer(image_width, image_height),
+                             framebuffer(image_width, image_height)};
+            int count = std::max(1, aov_samples);
+
+            pool.parallel_for(image_height, [&](int j, int) {
+                for (int i = 0; i < image_width; i++) {
+                    color  normal(0, 0, 0), albedo(0, 0, 0);
+                    double depth = 0;
+                    for (int sample = 0; sample < count; sample++) {
+                        rng gen = sample_generator(i, j, uint32_t(sample));
+                        basic_ray<T> r = get_ray(i, j, gen);
+                        basic_hit_record<T> rec;
+                        if (world.hit(r, basic_interval<T>(T(0.001), std::numeric_limits<T>::infinity()), rec)) {
+                            normal += color(rec.normal);
+                            albedo += color(rec.mat->albedo_at(rec));
+                            depth  += double(rec.t) * double(r.direction().length());
+                        }
+                        else {
+                            albedo += color(1, 1, 1);
+                            depth  += aov_buffers::sky_depth;
+                        }
                     }
-                    // write out color components
-                    write_color(std::cout, pixel_samples_scale * pixel_color);
+                    aovs.normal.at(i, j) = normal / count;
+                    aovs.albedo.at(i, j) = albedo / count;
+                    aovs.depth.at(i, j)  = color(depth, depth, depth) / count;
+                }
+            });
+            return aovs;
+        }
+
+        // the same, returning the accumulation buffer with the sums and sample counts
+        template <typename World>
+        accumulation_buffer render_accumulation(const World& world, thread_pool& pool) {
+            accumulation_buffer accum;
+            render_accumulation(world, pool, accum);
+            return accum;
+        }
+
+        // the same into an existing buffer, which is reset to the image size first
+        template <typename World>
+        void render_accumulation(const World& world, thread_pool& pool, accumulation_buffer& accum) {
+            initialize();
+
+            accum.reset(image_width, image_height);
+            if (resume && !checkpoint_path.empty())
+                load_checkpoint(accum);
+
+            path_statistics stats;
+
+            // one set of counters per worker, merged when the render is done
+            std::vector<render_stats> worker_stats(pool.size());
+            auto render_start = std::chrono::steady_clock::now();
+
+            bool deadline           = time_budget > 0;
+            auto stop_at            = deadline ? render_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                     std::chrono::duration<double>(time_budget))
+                                               : std::chrono::steady_clock::time_point::max();
+            auto pass_size          = uint32_t(samples_per_pass > 0 ? samples_per_pass : deadline ? 1 : samples_per_pixel);
+            auto target_samples     = uint32_t(samples_per_pixel);
+            auto last_checkpoint    = std::chrono::steady_clock::now();
+            double pass_sample_time = 0;    // seconds one sample per pixel took in the last pass
+            int    skipped_tiles    = 0;
+
+            int pass = 0;
+            for (uint32_t done = accum.min_samples(); done < target_samples; pass++) {
+                if (deadline && pass > 0) {
+                    // samples per pixel the measured throughput fits into the time left
+                    std::chrono::duration<double> left = stop_at - std::chrono::steady_clock::now();
+                    double fits = deadline_margin * left.count() / pass_sample_time;
+                    if (fits < 1 || (samples_per_pass > 0 && fits < pass_size))
+                        break;
+                    if (samples_per_pass <= 0)
+                        pass_size = uint32_t(std::min(fits, 2.0 * pass_size));     // grows at most 2x per pass
+                }
+
+                auto pass_start  = std::chrono::steady_clock::now();
+                auto pass_target = std::min(done + pass_size, target_samples);
+                skipped_tiles += render_pass(world, pool, accum, pass_target, stats, worker_stats, pass,
+                                             pass > 0 ? stop_at : std::chrono::steady_clock::time_point::max());
+                std::chrono::duration<double> pass_time = std::chrono::steady_clock::now() - pass_start;
+                pass_sample_time = pass_time.count() / (pass_target - done);
+                done = pass_target;
+
+                std::chrono::duration<double> since_checkpoint = std::chrono::steady_clock::now() - last_checkpoint;
+                if (!checkpoint_path.empty() && (since_checkpoint.count() >= checkpoint_interval || done == target_samples)) {
+                    if (!accum.save(checkpoint_path, seed))
+                        std::cerr << "\nCould not write checkpoint " << checkpoint_path << '\n';
+                    last_checkpoint = std::chrono::steady_clock::now();
                 }
             }
 
-            std::clog << "\rDone.               \n";
+            std::clog << "\rDone.                                        \n";
+
+            if (deadline) {
+                std::chrono::duration<double> took = std::chrono::steady_clock::now() - render_start;
+                std::clog << "Deadline: " << accum.min_samples() << " samples per pixel (mean "
+                          << double(accum.total_samples()) / (double(image_width) * image_height) << ") in "
+                          << pass << " passes, " << took.count() << " of " << time_budget << " s";
+                if (skipped_tiles > 0)
+                    std::clog << " (" << skipped_tiles << " tiles of the last pass cut by the deadline)";
+                std::clog << '\n';
+            }
+
+            // per-path bounce statistic, shows how much work Russian roulette cuts
+            if (stats.paths > 0)
+                std::clog << "Average bounces per path: " << double(stats.bounces) / double(stats.paths)
+                          << " (longest " << stats.longest << ")\n";
+
+            if (adaptive_sampling)
+                std::clog << "Average samples per pixel: "
+                          << double(accum.total_samples()) / (double(image_width) * image_height) << '\n';
+
+            if (!sample_heatmap_path.empty() && !write_image_file(accum.sample_heatmap(target_samples), sample_heatmap_path))
+                std::cerr << "Could not write sample heatmap " << sample_heatmap_path << '\n';
+
+            if (!stats_path.empty()) {
+                std::chrono::duration<double> render_time = std::chrono::steady_clock::now() - render_start;
+                write_stats(worker_stats, render_time.count());
+            }
         }
 
     private:
+        // resolves the image, denoised and with its AOVs written as requested
+        template <typename World>
+        framebuffer finish_image(const World& world, thread_pool& pool, const accumulation_buffer& accum) {
+            framebuffer image = accum.resolve();
+            if (!denoise && aov_path.empty())
+                return image;
+
+            aov_buffers aovs = render_aovs(world, pool);
+            if (!aov_path.empty()) {
+                if (!write_image_file(aovs.normal, aov_path + ".normal.pfm")
+                 || !write_image_file(aovs.albedo, aov_path + ".albedo.pfm")
+                 || !write_image_file(aovs.depth, aov_path + ".depth.pfm"))
+                    std::cerr << "Could not write the AOV images " << aov_path << ".*.pfm\n";
+            }
+            if (!denoise)
+                return image;
+
+            // variance of each pixel mean: the sample variance over the sample count
+            std::vector<double> variance(size_t(image_width) * image_height);
+            for (int j = 0; j < image_height; j++)
+                for (int i = 0; i < image_width; i++)
+                    variance[size_t(j) * image_width + i] = accum.samples(i, j) > 0
+                        ? accum.luminance_variance(i, j) / accum.samples(i, j) : 0.0;
+
+            auto start = std::chrono::steady_clock::now();
+            framebuffer filtered = nlmeans_denoiser().apply(image, variance, aovs, pool);
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            std::clog << "Denoised in " << took.count() << " ms\n";
+            return filtered;
+        }
+
         /* Private Camera Paramters*/
         int     image_height;           // Rendered image height
-        double  pixel_samples_scale;    // Color scale factor for a sum of pixel samples
         point3  center;                 // Camera center
         point3  pixel00_loc;            // Location of pixel 0, 0
         vec3    pixel_delta_u;          // Offset to pixel to the right
@@ -60,14 +360,299 @@ class camera {
         vec3    u,v,w;                  // Camera frame basis vectors
         vec3    defocus_disk_u;         // Defocus disk horizontal radius
         vec3    defocus_disk_v;         // Defocus disk vertical radius
+        shared_ptr<const pixel_sampler> sample_source;  // Sampler of the sample dimensions (nullptr: independent)
+
+        // share of the time left before the deadline a pass is planned to fill, leaving room
+        // for a pass that runs slower than the one it was measured on
+        static constexpr double deadline_margin = 0.8;
+
+        // counters behind the per-path bounce statistic, shared by the worker threads
+        struct path_statistics {
+            std::atomic<long long>  bounces{0};     // scattering events over all paths
+            std::atomic<long long>  paths{0};       // paths traced
+            std::atomic<int>        longest{0};     // most scattering events on one path
+        };
+
+        // loads the checkpoint file into accum, if there is a usable one
+        void load_checkpoint(accumulation_buffer& accum) {
+            uint64_t saved_seed;
+            if (!accum.load(checkpoint_path, saved_seed)) {
+                std::clog << "No usable checkpoint in " << checkpoint_path << ", starting from scratch\n";
+                return;
+            }
+
+            // samples only continue the saved sums exactly when they come from the same streams
+            if (saved_seed != seed)
+                std::clog << "Checkpoint was rendered with seed " << saved_seed << ", using it\n";
+            seed = saved_seed;
+
+            std::clog << "Resuming from " << accum.min_samples() << " samples per pixel\n";
+        }
+
+        // brings every pixel up to target_samples samples, one tile per pool task; tiles
+        // that would start after stop_at are skipped, and their number returned
+        template <typename World>
+        int render_pass(const World& world, thread_pool& pool, accumulation_buffer& accum,
+                        uint32_t target_samples, path_statistics& stats,
+                        std::vector<render_stats>& worker_stats, int pass,
+                        std::chrono::steady_clock::time_point stop_at) const
+        {
+            int rx0, ry0, rx1, ry1;
+            region_bounds(rx0, ry0, rx1, ry1);
+            int tiles_x     = (rx1 - rx0 + tile_size - 1) / tile_size;
+            int tiles_y     = (ry1 - ry0 + tile_size - 1) / tile_size;
+            int shares      = std::max(tile_shares, 1);
+            int tile_count  = (tiles_x * tiles_y - tile_share + shares - 1) / shares;
+
+            std::atomic<int>    tiles_remaining(tile_count);
+            std::atomic<int>    tiles_skipped(0);
+            std::mutex          progress_mutex;
+
+            pool.parallel_for(tile_count, [&](int task, int worker) {
+                if (std::chrono::steady_clock::now() >= stop_at) {
+                    tiles_skipped++;
+                    return;
+                }
+                set_active_stats(&worker_stats[worker]);
+                int tile = tile_share + task * shares;
+#ifdef RT_STATS
+                auto tile_start = std::chrono::steady_clock::now();
+#endif
+
+                int x0 = rx0 + (tile % tiles_x) * tile_size;
+                int y0 = ry0 + (tile / tiles_x) * tile_size;
+                int x1 = std::min(x0 + tile_size, rx1);
+                int y1 = std::min(y0 + tile_size, ry1);
+                long long tile_bounces = 0;
+                long long tile_paths   = 0;
+                int       tile_longest = 0;
+
+                // additive pixel color
+                auto add_sample = [&](int i, int j, const basic_vec3<T>& sample, int bounces) {
+                    accum.add_sample(i, j, color(sample));
+                    RT_STATS_COUNT(add_path(bounces));
+                    tile_bounces += bounces;
+                    tile_paths++;
+                    tile_longest  = std::max(tile_longest, bounces);
+                };
+
+                if (wavefront_size > 0) {
+                    render_tile_wavefront(world, accum, x0, y0, x1, y1, target_samples, add_sample);
+                }
+                else if (packet_size > 1) {
+                    render_tile_packets(world, accum, x0, y0, x1, y1, target_samples, add_sample);
+                }
+                else {
+                    for (int j = y0; j < y1; j++) {             // Rows
+                        for (int i = x0; i < x1; i++) {         // Columns
+                            for (auto sample = accum.samples(i, j); sample < target_samples; sample++) {
+                                if (adaptive_sampling && converged(accum, i, j))
+                                    break;
+
+                                rng gen = sample_generator(i, j, sample);
+                                int bounces = 0;
+                                auto pixel_color = sample_pixel(world, i, j, gen, bounces);
+                                add_sample(i, j, pixel_color, bounces);
+                            }
+                        }
+                    }
+                }
+
+                stats.bounces += tile_bounces;
+                stats.paths   += tile_paths;
+                int longest = stats.longest.load();
+                while (tile_longest > longest && !stats.longest.compare_exchange_weak(longest, tile_longest)) {}
+
+#ifdef RT_STATS
+                std::chrono::duration<double> tile_time = std::chrono::steady_clock::now() - tile_start;
+                worker_stats[worker].tiles.push_back(tile_timing{pass, x0, y0, x1 - x0, y1 - y0, tile_time.count()});
+#else
+                (void)pass;
+#endif
+                set_active_stats(nullptr);
+
+                int remaining = --tiles_remaining;
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                std::clog << "\rSamples " << target_samples << '/' << samples_per_pixel
+                          << ", tiles remaining: " << remaining << "    " << std::flush;
+            });
+            return tiles_skipped;
+        }
 
+        // renders the samples of the tile [x0, x1) x [y0, y1) up to target_samples in packets
+        // of packet_size x packet_size pixels: sample s of every pixel of a block that still
+        // needs it is one lane of a packet, intersected together with the other lanes, after
+        // which every lane follows the rest of its path as a single ray
+        // NOTE: lane (i, j) of sample s draws from the generator of sample (i, j, s) in the
+        //       same order as sample_pixel, so packets do not change the image
+        template <typename World, typename add_sample_function>
+        void render_tile_packets(const World& world, const accumulation_buffer& accum,
+                                 int x0, int y0, int x1, int y1, uint32_t target_samples,
+                                 add_sample_function& add_sample) const
+        {
+            constexpr int max_lanes = basic_ray_packet<T>::max_lanes;
+            const int     block     = packet_size <= 2 ? 2 : packet_size <= 4 ? 4 : 8;
+
+            rng                 gens[max_lanes];
+            basic_hit_record<T> recs[max_lanes];
+
+            for (int by = y0; by < y1; by += block) {
+                for (int bx = x0; bx < x1; bx += block) {
+                    int bw = std::min(block, x1 - bx);
+                    int bh = std::min(block, y1 - by);
+
+                    uint32_t first_sample = target_samples;
+                    for (int j = by; j < by + bh; j++)
+                        for (int i = bx; i < bx + bw; i++)
+                            first_sample = std::min(first_sample, accum.samples(i, j));
+
+                    for (auto sample = first_sample; sample < target_samples; sample++) {
+                        // lanes whose pixel takes sample next
+                        uint64_t lanes = 0;
+                        for (int lane = 0; lane < block * block; lane++) {
+                            int i = bx + lane % block;
+                            int j = by + lane / block;
+                            if (i >= bx + bw || j >= by + bh || accum.samples(i, j) != sample
+                             || (adaptive_sampling && converged(accum, i, j)))
+                                continue;
+
+                            gens[lane] = sample_generator(i, j, sample);
+                            lanes |= uint64_t(1) << lane;
+                        }
+                        if (lanes == 0)
+                            continue;
+
+                        basic_ray_packet<T> packet;
+                        get_ray_packet(bx, by, block, lanes, gens, packet);
+                        uint64_t hits = world.hit_packet(packet, basic_interval<T>(T(0.001), std::numeric_limits<T>::infinity()),
+                                                         recs);
+
+                        for (int lane = 0; lane < packet.lanes; lane++) {
+                            if (!packet.is_active(lane))
+                                continue;
+
+                            RT_STATS_COUNT(primary_rays++);
+                            primary_hit first = {((hits >> lane) & 1u) != 0, &recs[lane]};
+                            int bounces = 0;
+                            auto pixel_color = ray_color(packet.ray(lane), world, gens[lane], bounces, &first);
+                            add_sample(bx + lane % block, by + lane / block, pixel_color, bounces);
+                        }
+                    }
+                }
+            }
+        }
+
+        // renders the samples of the tile [x0, x1) x [y0, y1) up to target_samples with the
+        // wavefront integrator, in waves of at most wavefront_size paths
+        // 1. waves are filled sample round by sample round over the tile, so the samples of
+        //    every pixel still reach the buffer in order
+        // 2. with adaptive_sampling a wave also ends with each round, since the next round
+        //    depends on which pixels have converged
+        template <typename World, typename add_sample_function>
+        void render_tile_wavefront(const World& world, const accumulation_buffer& accum,
+                                   int x0, int y0, int x1, int y1, uint32_t target_samples,
+                                   add_sample_function& add_sample) const
+        {
+            basic_path_queue<T>             paths;
+            std::vector<std::pair<int,int>> path_pixels;    // pixel of every path of the wave
+
+            // samples each pixel of the tile had before this pass
+            std::vector<uint32_t> start_samples;
+            uint32_t first_sample = target_samples;
+            for (int j = y0; j < y1; j++) {
+                for (int i = x0; i < x1; i++) {
+                    start_samples.push_back(accum.samples(i, j));
+                    first_sample = std::min(first_sample, start_samples.back());
+                }
+            }
+
+            auto trace_wave = [&]() {
+                trace_wavefront(world, paths);
+                for (int path = 0; path < paths.size(); path++)
+                    add_sample(path_pixels[path].first, path_pixels[path].second, paths.colors[path], paths.bounces[path]);
+                paths.clear();
+                path_pixels.clear();
+            };
+
+            for (auto sample = first_sample; sample < target_samples; sample++) {
+                for (int j = y0, k = 0; j < y1; j++) {
+                    for (int i = x0; i < x1; i++, k++) {
+                        if (sample < start_samples[k] || (adaptive_sampling && converged(accum, i, j)))
+                            continue;
+
+                        rng gen = sample_generator(i, j, sample);
+                        basic_ray<T> r = get_ray(i, j, gen);
+                        RT_STATS_COUNT(primary_rays++);
+                        paths.push(r, gen);
+                        path_pixels.push_back({i, j});
+
+                        if (paths.size() >= wavefront_size)
+                            trace_wave();
+                    }
+                }
+                if (adaptive_sampling && paths.size() > 0)
+                    trace_wave();
+            }
+            if (paths.size() > 0)
+                trace_wave();
+        }
+
+        // generator of the sample-th sample this render adds to pixel (i, j)
+        rng sample_generator(int i, int j, uint32_t sample) const {
+            auto pixel = uint64_t(j) * image_width + i;
+            auto index = uint64_t(sample_first) + sample;
+            rng gen = rng::for_sample(seed, pixel, index);
+            if (sample_source)
+                gen.use_sampler(sample_source.get(), pixel, index);
+            return gen;
+        }
+
+        // the rendered region clamped to the image, [x0, x1) x [y0, y1)
+        void region_bounds(int& x0, int& y0, int& x1, int& y1) const {
+            x0 = std::clamp(region_x0, 0, image_width);
+            y0 = std::clamp(region_y0, 0, image_height);
+            x1 = region_x1 < 0 ? image_width  : std::clamp(region_x1, x0, image_width);
+            y1 = region_y1 < 0 ? image_height : std::clamp(region_y1, y0, image_height);
+        }
+
+        // true once the 95% confidence interval of the mean luminance of pixel (i, j) is
+        // within adaptive_threshold of that mean
+        // NOTE: the mean is floored at 1% so black pixels can converge as well
+        bool converged(const accumulation_buffer& accum, int i, int j) const {
+            auto n = accum.samples(i, j);
+            if (n < uint32_t(std::max(adaptive_min_samples, 2)))
+                return false;
+
+            auto half_width = 1.96 * std::sqrt(accum.luminance_variance(i, j) / n);
+            return half_width <= adaptive_threshold * std::max(accum.mean_luminance(i, j), 0.01);
+        }
+
+    public:
+        // merges the per-worker counters and writes them to stats_path
+        void write_stats(const std::vector<render_stats>& worker_stats, double render_seconds) const {
+#ifdef RT_STATS
+            render_stats total;
+            for (const auto& stats : worker_stats)
+                total.merge(stats);
+
+            std::ofstream out(stats_path);
+            total.write_json(out, render_seconds);
+            if (!out)
+                std::cerr << "Could not write render statistics " << stats_path << '\n';
+#else
+            (void)worker_stats;
+            (void)render_seconds;
+            std::cerr << "Render statistics need a build with -DRT_STATS, " << stats_path << " not written\n";
+#endif
+        }
+
+        // Derive the image height and the viewing frame from the public parameters
+        // NOTE: render calls this itself, code calling get_ray directly must call it first
         void initialize() {
             // Calculate the image height, and ensure that it's at least 1
             image_height = int(image_width / aspect_ratio);
             image_height = (image_height < 1) ? 1 : image_height;
 
-            pixel_samples_scale = 1.0 / samples_per_pixel;
-
             center = lookfrom;
 
             // Determine viewport dimensions
@@ -99,77 +684,272 @@ class camera {
             auto defocus_radius = focus_dist * std::tan(degrees_to_radians(defocus_angle / 2));
             defocus_disk_u = u * defocus_radius;
             defocus_disk_v = v * defocus_radius;
+
+            sample_source = make_pixel_sampler(sampler, sampler_samples(), image_width, seed);
         }
 
-        ray get_ray(int i, int j) const {
+        // NOTE: the ray is set up in double and converted to T
+        basic_ray<T> get_ray(int i, int j, rng& gen) const {
             // Construct a camera ray originating from the defocus disk and directed at 
             // randomly sampled point around the pixel location i, j
 
-            auto offset = sample_square();
+            auto offset = sample_square(gen);
             // formerly pixel center
             auto pixel_sample = pixel00_loc
                                 + ((i + offset.x()) * pixel_delta_u)
                                 + ((j + offset.y()) * pixel_delta_v);
 
-            auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
+            auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample(gen);
             auto ray_direction = pixel_sample - ray_origin;
 
-            return ray(ray_origin, ray_direction);
+            return basic_ray<T>(basic_vec3<T>(ray_origin), basic_vec3<T>(ray_direction));
+        }
+
+        // Camera rays of the block of pixels with upper left pixel bx, by in packet form:
+        // lane l holds the ray of pixel (bx + l % block, by + l / block) if bit l of lanes
+        // is set, drawn from gens[l]
+        // NOTE: the random offsets are drawn lane by lane exactly as get_ray draws them,
+        //       the rays are then set up for all lanes at once in structure-of-arrays form
+        void get_ray_packet(int bx, int by, int block, uint64_t lanes, rng* gens, basic_ray_packet<T>& packet) const {
+            constexpr int max_lanes = basic_ray_packet<T>::max_lanes;
+
+            alignas(64) double sx[max_lanes] = {}, sy[max_lanes] = {};          // pixel + offset
+            alignas(64) double disk_x[max_lanes] = {}, disk_y[max_lanes] = {};  // defocus disk point
+
+            packet.lanes  = block * block;
+            packet.active = lanes;
+            for (int l = 0; l < packet.lanes; l++) {
+                if (!packet.is_active(l))
+                    continue;
+                auto offset = sample_square(gens[l]);
+                sx[l] = double(bx + l % block) + offset.x();
+                sy[l] = double(by + l / block) + offset.y();
+                if (defocus_angle > 0) {
+                    auto p = random_in_unit_disk(gens[l]);
+                    disk_x[l] = p[0];
+                    disk_y[l] = p[1];
+                }
+            }
+
+            T* origin[3]    = {packet.ox, packet.oy, packet.oz};
+            T* direction[3] = {packet.dx, packet.dy, packet.dz};
+            for (int axis = 0; axis < 3; axis++) {
+                for (int l = 0; l < packet.lanes; l++) {
+                    double pixel_sample = pixel00_loc[axis] + sx[l] * pixel_delta_u[axis] + sy[l] * pixel_delta_v[axis];
+                    double ray_origin   = defocus_angle <= 0 ? center[axis]
+                                        : center[axis] + disk_x[l] * defocus_disk_u[axis] + disk_y[l] * defocus_disk_v[axis];
+                    origin[axis][l]    = T(ray_origin);
+                    direction[axis][l] = T(pixel_sample - ray_origin);
+                }
+            }
         }
 
+        // Color of one sample of pixel i, j; bounces receives the scattering events on its path
+        template <typename World>
+        basic_vec3<T> sample_pixel(const World& world, int i, int j, rng& gen, int& bounces) const {
+            basic_ray<T> r = get_ray(i, j, gen);
+            RT_STATS_COUNT(primary_rays++);
+            return ray_color(r, world, gen, bounces);
+        }
+
+        // traces every path of the queue to its end, one bounce of all live paths at a time
+        // 1. every live path is intersected; paths that miss take the sky color and end
+        // 2. the hits are binned by the type of their material (material_kind)
+        // 3. each bin of a built-in type scatters in its own loop, calling the final
+        //    material class directly, so the loop runs the same code for every path in it;
+        //    the last bin takes the usual scatter call
+        // NOTE: every path makes the same random draws in the same order as in ray_color,
+        //       so a path has the same color in both integrators
+        template <typename World>
+        void trace_wavefront(const World& world, basic_path_queue<T>& paths) const {
+            paths.live.clear();
+            for (int path = 0; path < paths.size(); path++)
+                paths.live.push_back(path);
+
+            for (int depth = 0; depth < max_depth && !paths.live.empty(); depth++) {
+                for (auto& bin : paths.bins)
+                    bin.clear();
+
+                for (int path : paths.live) {
+                    basic_ray<T> current = paths.ray(path);
+                    if (!world.hit(current, basic_interval<T>(T(0.001), std::numeric_limits<T>::infinity()), paths.recs[path])) {
+                        basic_vec3<T> unit_direction = unit_vector(current.direction());
+                        auto a = T(0.5)*(unit_direction.y() + 1);
+                        paths.colors[path] = paths.throughput(path) * ((1-a)*basic_vec3<T>(1, 1, 1) + a*basic_vec3<T>(T(0.5), T(0.7), 1));
+                        continue;
+                    }
+                    paths.bins[material_bin(world, paths.recs[path])].push_back(path);
+                }
+
+                paths.live.clear();
+                scatter_bin<basic_lambertian<T>>(world, paths, paths.bins[material_lambertian]);
+                scatter_bin<basic_metal<T>>(world, paths, paths.bins[material_metal]);
+                scatter_bin<basic_dialectric<T>>(world, paths, paths.bins[material_dialectric]);
+                scatter_bin<void>(world, paths, paths.bins[material_kind_count]);
+            }
+
+            // paths still alive after max_depth bounces gather no light
+            for (int path : paths.live)
+                paths.colors[path] = basic_vec3<T>(0,0,0);
+        }
+
+    private:
+        // intersection of a primary ray that was already traced as part of a packet
+        struct primary_hit {
+            bool                        hit;    // true if the ray hit anything
+            const basic_hit_record<T>*  rec;    // the hit, if any
+        };
+
         // return color for a given scene ray
-        color ray_color(const ray& r, int depth, const hittable& world) {
+        // 1. Follows the path one bounce at a time, carrying the product of the surface
+        //    attenuations seen so far (the path throughput)
+        // 2. With roulette_depth > 0, paths that have bounced that many times survive each
+        //    further bounce with a probability equal to their brightest throughput component;
+        //    survivors are scaled up by the inverse probability, so the estimate stays unbiased
+        // 3. bounces receives the number of scattering events along the path
+        // 4. primary, if given, is the already known intersection of r itself
+        template <typename World>
+        basic_vec3<T> ray_color(const basic_ray<T>& r, const World& world, rng& gen, int& bounces,
+                                const primary_hit* primary = nullptr) const
+        {
+            basic_ray<T>  current = r;
+            basic_vec3<T> throughput(1, 1, 1);
+
             // If we've exceeded the ray bounce limit, no more light is gathered
-            // return black outside depth limit
-            if (depth <= 0) {
-                return color(0,0,0);
-            }
+            for (int depth = 0; depth < max_depth; depth++) {
+                basic_hit_record<T> rec;
+
+                // ignores hits close to the estimated intersection point
+                // calculating reflected ray origins with tolerance
+                bool hit;
+                if (depth == 0 && primary != nullptr) {
+                    hit = primary->hit;
+                    if (hit)
+                        rec = *primary->rec;
+                }
+                else hit = world.hit(current, basic_interval<T>(T(0.001), std::numeric_limits<T>::infinity()), rec);
 
-            hit_record rec;
+                if (!hit) {
+                    basic_vec3<T> unit_direction = unit_vector(current.direction());
+                    auto a = T(0.5)*(unit_direction.y() + 1);
+                    // blendedValue = (1-a)*startValue + a*endValue
+                    return throughput * ((1-a)*basic_vec3<T>(1, 1, 1) + a*basic_vec3<T>(T(0.5), T(0.7), 1));
+                }
 
-            // ignores hits close to the estimated intersection point
-            // calculating reflected ray origins with tolerance
-            if (world.hit(r,interval(0.001, infinity), rec)) {
                 // ray color is affected by material information
-                ray scattered;
-                color attenuation;
-                if(rec.mat->scatter(r, rec, attenuation, scattered))
-                    return attenuation * ray_color(scattered, depth-1, world);
-                // return matte gray (color is affected by ambient light)
-                return color(0,0,0);
+                basic_ray<T>  scattered;
+                basic_vec3<T> attenuation;
+                if (!scatter(world, current, rec, attenuation, scattered, gen))
+                    return basic_vec3<T>(0,0,0);    // absorbed
+
+                bounces++;
+                RT_STATS_COUNT(secondary_rays++);
+                throughput = throughput * attenuation;
+                current    = scattered;
+
+                if (roulette_depth > 0 && bounces >= roulette_depth) {
+                    auto survival = std::fmin(T(1), std::fmax(throughput.x(), std::fmax(throughput.y(), throughput.z())));
+                    if (gen.random_double() >= survival)
+                        return basic_vec3<T>(0,0,0);
+                    throughput /= survival;
+                }
             }
 
-            vec3 unit_direction = unit_vector(r.direction());
-            auto a = 0.5*(unit_direction.y() + 1.0);
-            // blendedValue = (1-a)*startValue + a*endValue
-            return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0);
+            return basic_vec3<T>(0,0,0);
+        }
+
+        // scatters the paths of one material bin, each through Material (void: any material)
+        // and keeps the survivors live, like one iteration of ray_color
+        template <typename Material, typename World>
+        void scatter_bin(const World& world, basic_path_queue<T>& paths, const std::vector<int>& bin) const {
+            for (int path : bin) {
+                const basic_hit_record<T>& rec = paths.recs[path];
+                basic_ray<T>  current = paths.ray(path);
+                basic_ray<T>  scattered;
+                basic_vec3<T> attenuation;
+
+                bool scatters;
+                if constexpr (std::is_void<Material>::value)
+                    scatters = scatter(world, current, rec, attenuation, scattered, paths.gens[path]);
+                else
+                    scatters = static_cast<const Material*>(rec.mat)->scatter(current, rec, attenuation, scattered, paths.gens[path]);
+
+                if (!scatters) {
+                    paths.colors[path] = basic_vec3<T>(0,0,0);  // absorbed
+                    continue;
+                }
+
+                int& bounces = paths.bounces[path];
+                bounces++;
+                RT_STATS_COUNT(secondary_rays++);
+                basic_vec3<T> throughput = paths.throughput(path) * attenuation;
+                paths.set_ray(path, scattered);
+
+                if (roulette_depth > 0 && bounces >= roulette_depth) {
+                    auto survival = std::fmin(T(1), std::fmax(throughput.x(), std::fmax(throughput.y(), throughput.z())));
+                    if (paths.gens[path].random_double() >= survival) {
+                        paths.colors[path] = basic_vec3<T>(0,0,0);
+                        continue;
+                    }
+                    throughput /= survival;
+                }
+
+                paths.set_throughput(path, throughput);
+                paths.live.push_back(path);
+            }
+        }
+
+        // wavefront bin of the material at rec: its material_kind, read without a virtual
+        // call when the scene knows its materials (closed_world::kind)
+        template <typename World>
+        static int material_bin(const World& world, const basic_hit_record<T>& rec) {
+            if constexpr (std::is_base_of<basic_hittable<T>, World>::value)
+                return rec.mat->kind();
+            else
+                return world.kind(rec);
+        }
+
+        // scatters off the surface in rec: a virtual call for hittable scenes, otherwise
+        // the scene's own (non-virtual) material dispatch
+        template <typename World>
+        static bool scatter(const World& world, const basic_ray<T>& r_in, const basic_hit_record<T>& rec,
+                            basic_vec3<T>& attenuation, basic_ray<T>& scattered, rng& gen)
+        {
+            if constexpr (std::is_base_of<basic_hittable<T>, World>::value)
+                return rec.mat->scatter(r_in, rec, attenuation, scattered, gen);
+            else
+                return world.scatter(r_in, rec, attenuation, scattered, gen);
         }
 
         // Returns the vector to a random point in the [-.5, -.5]-[+.5, +.5] unit square
-        vec3 sample_square() const {
-            return vec3(random_double() - 0.5, random_double() - 0.5, 0);
+        vec3 sample_square(rng& gen) const {
+            double x, y;
+            gen.next_2d(x, y);
+            return vec3(x - 0.5, y - 0.5, 0);
         }
         
         // Returns a random point in the unit (radius 0.5) disk centered at the origin
-        vec3 sample_disk(double radius) const {
-            return radius * random_in_unit_disk();
+        vec3 sample_disk(double radius, rng& gen) const {
+            return radius * random_in_unit_disk(gen);
         }
 
         // Returns a random point in the camera defocus disk
-        point3 defocus_disk_sample() const {
-            auto p = random_in_unit_disk();
+        point3 defocus_disk_sample(rng& gen) const {
+            auto p = random_in_unit_disk(gen);
             return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
         }
 
         // uniform diffuse
-        vec3 uniform_diffuse(vec3 normal) const {
-            return random_on_hemisphere(normal);
+        vec3 uniform_diffuse(vec3 normal, rng& gen) const {
+            return random_on_hemisphere(normal, gen);
         }
 
         // replacement diffuse with non-uniform Lambertian distribution
-        vec3 replacement_diffuse(vec3 normal) const {
-            return normal + random_unit_vector();
+        vec3 replacement_diffuse(vec3 normal, rng& gen) const {
+            return normal + random_unit_vector(gen);
         }
 };
 
+using camera = basic_camera<double>;
+
 #endif  // end of camera header file
\ No newline at end of file
@@ -18,24 +18,21 @@ inline double linear_to_gamma(double linear_component) {
     return 0;
 }
 
+// converts one linear color component to a gamma corrected byte value [0, 255]
+inline int component_to_byte(double linear_component) {
+    // Translate the [0,1] component values to the byte range [0, 255]
+    static const interval intensity(0.000, 0.999);
+    return int(255.999 * intensity.clamp(linear_to_gamma(linear_component)));
+}
+
 // output multi-sample pixel color components
 void write_color(std::ostream& out, const color& pixel_color) {
     // rgb triplet as vector positions
     // (auto keyword declares local storage variables)
-    auto r = pixel_color.x();
-    auto g = pixel_color.y();
-    auto b = pixel_color.z();
-
-    // Apply linear to gamma transform for gamma 2
-    r = linear_to_gamma(r);
-    g = linear_to_gamma(g);
-    b = linear_to_gamma(b);
-
-    // Translate the [0,1] component values to the byte range [0, 255]
-    static const interval intensity(0.000, 0.999);
-    int rbyte = int(255.999 * intensity.clamp(r));
-    int gbyte = int(255.999 * intensity.clamp(g));
-    int bbyte = int(255.999 * intensity.clamp(b));
+    // Apply linear to gamma transform for gamma 2 and convert to bytes
+    int rbyte = component_to_byte(pixel_color.x());
+    int gbyte = component_to_byte(pixel_color.y());
+    int bbyte = component_to_byte(pixel_color.z());
 
     // Write out the pixel color components
     out << rbyte << ' ' << gbyte << ' ' << bbyte << '\n';
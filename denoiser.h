@@ -0,0 +1,108 @@
+#ifndef DENOISER_H  // start of denoiser header file
+#define DENOISER_H  // aov_buffers and nlmeans_denoiser definitions
+
+// Import libraries
+#include "rtweekend.h"
+#include "framebuffer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// auxiliary images (AOVs) of a render, averaged over the primary rays of every pixel
+struct aov_buffers {
+    framebuffer normal;     // surface normal at the first hit, (0, 0, 0) where the rays miss
+    framebuffer albedo;     // material albedo at the first hit, white where the rays miss
+    framebuffer depth;      // distance to the first hit in every channel, sky_depth where the rays miss
+
+    static constexpr double sky_depth = 1e6;
+};
+
+// non-local means filter with variance normalized patch distances (Rousselle et al. 2012)
+// 1. every pixel becomes a weighted mean of the pixels within search_radius of it, each
+//    weighted by how alike the 3x3 patches around the two pixels are
+// 2. patch differences are measured in units of the variance of the pixel estimates, less
+//    the part of the difference the noise alone explains, so noisy pixels are smoothed
+//    more and converged pixels and edges are kept
+// 3. pixels whose first hits differ in albedo or normal are weighted down as well, so the
+//    filter does not blur across surface edges that the noise hides
+// NOTE: the depth image is not a feature: albedo and normal already separate the objects,
+//       and weighting by relative depth also splits pixels of one surface seen at a
+//       grazing angle, which raised the rmse of bench's denoiser section
+// NOTE: rows are filtered in parallel on a thread_pool; the result does not depend on
+//       the number of threads
+// NOTE: on the main.cc scene the filter removes about a third of the error of a 32 spp
+//       render, about what 70 spp give raw, not the quality of 500 spp: most of the error
+//       left is at silhouettes, in the defocus blur and in reflections, which the first
+//       hit features cannot describe (see bench's denoiser section)
+class nlmeans_denoiser {
+    public:
+        int     search_radius   = 5;        // pixels searched on every side
+        int     patch_radius    = 1;
+        double  strength        = 1;        // patch distance tolerance, in standard deviations
+        double  noise_offset    = 2;        // part of the patch distance credited to the noise
+        double  sigma_albedo    = 1;        // albedo tolerance
+        double  sigma_normal    = 1;        // normal tolerance
+
+        // filters image, whose pixel means have the given luminance variance (in row order)
+        framebuffer apply(const framebuffer& image, const std::vector<double>& variance,
+                          const aov_buffers& aovs, thread_pool& pool) const
+        {
+            int width  = image.width();
+            int height = image.height();
+            const auto& pixels = image.data();
+            framebuffer result(width, height);
+
+            pool.parallel_for(height, [&](int j, int) {
+                for (int i = 0; i < width; i++) {
+                    auto p = size_t(j) * width + i;
+
+                    color  sum(0, 0, 0);
+                    double weight_sum = 0;
+                    for (int y = std::max(j - search_radius, 0); y <= std::min(j + search_radius, height - 1); y++) {
+                        for (int x = std::max(i - search_radius, 0); x <= std::min(i + search_radius, width - 1); x++) {
+                            auto q = size_t(y) * width + x;
+
+                            // 1. patch distance, relative to the noise
+                            double distance = 0;
+                            int    terms    = 0;
+                            for (int dy = -patch_radius; dy <= patch_radius; dy++) {
+                                if (j + dy < 0 || j + dy >= height || y + dy < 0 || y + dy >= height)
+                                    continue;
+                                for (int dx = -patch_radius; dx <= patch_radius; dx++) {
+                                    if (i + dx < 0 || i + dx >= width || x + dx < 0 || x + dx >= width)
+                                        continue;
+                                    auto pp = p + std::ptrdiff_t(dy) * width + dx;
+                                    auto qq = q + std::ptrdiff_t(dy) * width + dx;
+                                    auto var_p = variance[pp];
+                                    auto var_q = variance[qq];
+                                    auto noise = noise_offset * (var_p + std::min(var_p, var_q));
+                                    auto scale = 1e-10 + strength * strength * (var_p + var_q);
+                                    for (int c = 0; c < 3; c++) {
+                                        auto difference = pixels[pp][c] - pixels[qq][c];
+                                        distance += (difference * difference - noise) / scale;
+                                    }
+                                    terms += 3;
+                                }
+                            }
+
+                            // 2. feature distance
+                            auto features = (aovs.albedo.data()[p] - aovs.albedo.data()[q]).length_squared()
+                                                / (sigma_albedo * sigma_albedo)
+                                          + (aovs.normal.data()[p] - aovs.normal.data()[q]).length_squared()
+                                                / (sigma_normal * sigma_normal);
+
+                            auto w = std::exp(-std::max(0.0, distance / terms) - features);
+                            sum        += w * pixels[q];
+                            weight_sum += w;
+                        }
+                    }
+                    result.data()[p] = (1.0 / weight_sum) * sum;
+                }
+            });
+            return result;
+        }
+};
+
+#endif  // end of denoiser header file
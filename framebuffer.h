@@ -0,0 +1,35 @@
+#ifndef FRAMEBUFFER_H   // start of framebuffer header file
+#define FRAMEBUFFER_H   // framebuffer class definition
+
+// Import libraries
+#include "rtweekend.h"
+
+#include <vector>
+
+// rendered image held in memory as linear colors
+// pixels are stored in rows from left -> right and top -> bottom
+class framebuffer {
+    public:
+        framebuffer() : image_width(0), image_height(0) {}
+
+        framebuffer(int width, int height)
+            : image_width(width), image_height(height), pixels(size_t(width) * height) {}
+
+        int width() const  {return image_width;}
+        int height() const {return image_height;}
+
+        // pixel access by column i and row j
+        const color& at(int i, int j) const {return pixels[size_t(j) * image_width + i];}
+        color& at(int i, int j) {return pixels[size_t(j) * image_width + i];}
+
+        // raw pixel array in row order
+        const std::vector<color>& data() const {return pixels;}
+        std::vector<color>& data() {return pixels;}
+
+    private:
+        int                 image_width;
+        int                 image_height;
+        std::vector<color>  pixels;
+};
+
+#endif  // end of framebuffer header file
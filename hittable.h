@@ -3,23 +3,31 @@
 
 // Import libraries
 #include "rtweekend.h"
+#include "aabb.h"
+#include "ray_packet.h"
+
+#include <cstdint>
 
 // abstract class
-class material;
+template <typename T> class basic_material;
 
 // contains information about the material assigned to the surface of 
 // an object that was hit by a ray
-class hit_record {
+// NOTE: mat does not own the material, the scene does; copying a record therefore
+//       never touches a reference count
+template <typename T>
+class basic_hit_record {
     public:
-        point3                  p;
-        vec3                    normal;
-        shared_ptr<material>    mat;   // material pointer
-        double                  t;
-        bool                    front_face;
+        basic_vec3<T>               p;
+        basic_vec3<T>               normal;
+        const basic_material<T>*    mat;   // material pointer
+        int                         mat_id = -1;    // material index in a closed_world, -1 elsewhere
+        T                           t;
+        bool                        front_face;
 
         // sets the hit record normal vector
         // NOTE: the parameter outward_normal is assumed to have unit length
-        void set_face_normal(const ray& r, const vec3& outward_normal) {
+        void set_face_normal(const basic_ray<T>& r, const basic_vec3<T>& outward_normal) {
             front_face  = dot(r.direction(), outward_normal) < 0;
             // surface side determination
             normal      = front_face ? outward_normal : -outward_normal;
@@ -27,11 +35,35 @@ class hit_record {
 };
 
 // generic object a ray can intersect with
-class hittable {
+// NOTE: every scene type is a template over the scalar type T (float or double);
+//       hittable, hit_record etc. name the double instantiations
+template <typename T>
+class basic_hittable {
     public:
-        virtual ~hittable() = default;
+        virtual ~basic_hittable() = default;
+
+        // NOTE: rec is only written when the ray hits, so callers can pass the same record
+        //       to several objects and keep the closest hit
+        virtual bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const = 0;
+
+        // returns the box enclosing the object, used to build acceleration structures
+        virtual basic_aabb<T> bounding_box() const = 0;
 
-        virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+        // intersects every active lane of the packet and returns the mask of lanes that
+        // hit something, with the record of lane l in recs[l]
+        // NOTE: traces the lanes one at a time unless a primitive container overrides it
+        virtual uint64_t hit_packet(const basic_ray_packet<T>& packet, basic_interval<T> ray_t,
+                                    basic_hit_record<T>* recs) const
+        {
+            uint64_t hits = 0;
+            for (int lane = 0; lane < packet.lanes; lane++)
+                if (packet.is_active(lane) && hit(packet.ray(lane), ray_t, recs[lane]))
+                    hits |= uint64_t(1) << lane;
+            return hits;
+        }
 };
 
-#endif  // end of hittable header file
\ No newline at end of file
+using hit_record = basic_hit_record<double>;
+using hittable   = basic_hittable<double>;
+
+#endif  // end of hittable header file
@@ -8,39 +8,51 @@
 #include <vector>
 
 // stores a list of hittable objects
-class hittable_list : public hittable {
+template <typename T>
+class basic_hittable_list : public basic_hittable<T> {
     public:
         // vector/list that stores hittable objects
-        std::vector<shared_ptr<hittable>> objects;
+        std::vector<shared_ptr<basic_hittable<T>>> objects;
 
-        hittable_list() {}
-        hittable_list(shared_ptr<hittable> object) {add(object);}
+        basic_hittable_list() {}
+        basic_hittable_list(shared_ptr<basic_hittable<T>> object) {add(object);}
 
         // empties the contents of a hittable_list
-        void clear() {objects.clear();}
+        void clear() {
+            objects.clear();
+            bbox = basic_aabb<T>();
+        }
 
         // adds a hittable object to a hittable_list
-        void add(shared_ptr<hittable> object) {
+        void add(shared_ptr<basic_hittable<T>> object) {
             objects.push_back(object);
+            bbox = basic_aabb<T>(bbox, object->bounding_box());
         }
 
         // returns true if a ray intersects with any object in the hittable_list 
         // within an acceptable range
-        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-            hit_record  temp_rec;
+        // NOTE: objects only write rec when they are hit, and every test is limited to the
+        //       closest hit so far, so rec can collect the closest hit without a temporary
+        bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
             bool        hit_anything    = false;
             auto        closest_so_far  = ray_t.max;
 
             for (const auto& object : objects) {
-                if (object->hit(r,  interval(ray_t.min, closest_so_far), temp_rec)) {
+                if (object->hit(r,  basic_interval<T>(ray_t.min, closest_so_far), rec)) {
                     hit_anything    = true;
-                    closest_so_far  = temp_rec.t;
-                    rec             = temp_rec;
+                    closest_so_far  = rec.t;
                 }
             }
 
             return hit_anything;
         }
+
+        basic_aabb<T> bounding_box() const override {return bbox;}
+
+    private:
+        basic_aabb<T> bbox;  // box enclosing every object in the list
 };
 
-#endif  // end of hittable_list header file
\ No newline at end of file
+using hittable_list = basic_hittable_list<double>;
+
+#endif  // end of hittable_list header file
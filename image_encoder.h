@@ -0,0 +1,262 @@
+#ifndef IMAGE_ENCODER_H // start of image_encoder header file
+#define IMAGE_ENCODER_H // image_encoder class definitions
+
+// Import libraries
+#include "rtweekend.h"
+#include "framebuffer.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <cstdio>
+#endif
+
+// abstract class for writing a framebuffer in some image file format
+// NOTE: every encoder builds the whole file in memory and hands it to the stream in
+//       a single write, instead of formatting one pixel at a time
+class image_encoder {
+    public:
+        virtual ~image_encoder() = default;
+
+        // writes the whole image to out
+        virtual void write(const framebuffer& image, std::ostream& out) const = 0;
+
+        // true if the format is binary, so the output stream must not translate newlines
+        virtual bool binary() const {return true;}
+
+    protected:
+        // gamma corrected 8 bit rgb triplets of the image in row order
+        static std::vector<unsigned char> rgb_bytes(const framebuffer& image) {
+            std::vector<unsigned char> bytes;
+            bytes.reserve(image.data().size() * 3);
+            for (const auto& pixel : image.data()) {
+                bytes.push_back((unsigned char)component_to_byte(pixel.x()));
+                bytes.push_back((unsigned char)component_to_byte(pixel.y()));
+                bytes.push_back((unsigned char)component_to_byte(pixel.z()));
+            }
+            return bytes;
+        }
+
+        static void write_buffer(std::ostream& out, const std::string& header,
+                                 const std::vector<unsigned char>& body)
+        {
+            out.write(header.data(), std::streamsize(header.size()));
+            out.write(reinterpret_cast<const char*>(body.data()), std::streamsize(body.size()));
+        }
+};
+
+// plain text PPM (P3), the original output format
+class ppm_ascii_encoder : public image_encoder {
+    public:
+        void write(const framebuffer& image, std::ostream& out) const override {
+            std::string header = "P3\n" + std::to_string(image.width()) + ' '
+                               + std::to_string(image.height()) + "\n255\n";
+
+            // "r g b\n" per pixel, at most 12 characters
+            auto bytes = rgb_bytes(image);
+            std::vector<unsigned char> body;
+            body.reserve(bytes.size() * 4);
+            for (size_t k = 0; k < bytes.size(); k++) {
+                append_decimal(body, bytes[k]);
+                body.push_back((k % 3 == 2) ? '\n' : ' ');
+            }
+
+            write_buffer(out, header, body);
+        }
+
+        bool binary() const override {return false;}
+
+    private:
+        static void append_decimal(std::vector<unsigned char>& body, unsigned value) {
+            if (value >= 100) body.push_back((unsigned char)('0' + value / 100));
+            if (value >= 10)  body.push_back((unsigned char)('0' + value / 10 % 10));
+            body.push_back((unsigned char)('0' + value % 10));
+        }
+};
+
+// binary PPM (P6), the same image as P3 at about a quarter of the size
+class ppm_binary_encoder : public image_encoder {
+    public:
+        void write(const framebuffer& image, std::ostream& out) const override {
+            std::string header = "P6\n" + std::to_string(image.width()) + ' '
+                               + std::to_string(image.height()) + "\n255\n";
+            write_buffer(out, header, rgb_bytes(image));
+        }
+};
+
+// portable float map (PFM), linear 32 bit float colors without gamma or clamping,
+// for keeping the full dynamic range of the render
+class pfm_encoder : public image_encoder {
+    public:
+        void write(const framebuffer& image, std::ostream& out) const override {
+            // a negative scale marks little-endian data
+            std::string header = "PF\n" + std::to_string(image.width()) + ' '
+                               + std::to_string(image.height()) + "\n-1.0\n";
+
+            std::vector<unsigned char> body(image.data().size() * 3 * sizeof(float));
+            unsigned char* dst = body.data();
+
+            // PFM stores rows from bottom -> top
+            for (int j = image.height() - 1; j >= 0; j--) {
+                for (int i = 0; i < image.width(); i++) {
+                    const color& pixel = image.at(i, j);
+                    for (int c = 0; c < 3; c++) {
+                        put_float_le(dst, float(pixel[c]));
+                        dst += 4;
+                    }
+                }
+            }
+
+            write_buffer(out, header, body);
+        }
+
+    private:
+        static void put_float_le(unsigned char* dst, float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            dst[0] = (unsigned char)(bits);
+            dst[1] = (unsigned char)(bits >> 8);
+            dst[2] = (unsigned char)(bits >> 16);
+            dst[3] = (unsigned char)(bits >> 24);
+        }
+};
+
+// "Quite OK Image" format (QOI), lossless compression of the 8 bit image that encodes
+// in a single pass (https://qoiformat.org/qoi-specification.pdf)
+class qoi_encoder : public image_encoder {
+    public:
+        void write(const framebuffer& image, std::ostream& out) const override {
+            std::vector<unsigned char> body;
+            body.reserve(14 + image.data().size() * 4 + 8);
+
+            // header: magic, width, height, 3 channels, sRGB with linear alpha
+            body.insert(body.end(), {'q', 'o', 'i', 'f'});
+            put_u32_be(body, uint32_t(image.width()));
+            put_u32_be(body, uint32_t(image.height()));
+            body.push_back(3);
+            body.push_back(0);
+
+            auto bytes = rgb_bytes(image);
+
+            pixel seen[64] = {};
+            pixel prev     = {0, 0, 0, 255};
+            int   run      = 0;
+
+            for (size_t k = 0; k < bytes.size(); k += 3) {
+                pixel px = {bytes[k], bytes[k+1], bytes[k+2], 255};
+
+                if (px == prev) {
+                    run++;
+                    if (run == 62) {
+                        body.push_back(op_run | (run - 1));
+                        run = 0;
+                    }
+                    continue;
+                }
+
+                if (run > 0) {
+                    body.push_back(op_run | (run - 1));
+                    run = 0;
+                }
+
+                int slot = px.hash();
+                if (seen[slot] == px) {
+                    body.push_back((unsigned char)(op_index | slot));
+                }
+                else {
+                    seen[slot] = px;
+
+                    int dr = int8_t(px.r - prev.r);
+                    int dg = int8_t(px.g - prev.g);
+                    int db = int8_t(px.b - prev.b);
+                    int dr_dg = dr - dg;
+                    int db_dg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        body.push_back((unsigned char)(op_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    }
+                    else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                        body.push_back((unsigned char)(op_luma | (dg + 32)));
+                        body.push_back((unsigned char)((dr_dg + 8) << 4 | (db_dg + 8)));
+                    }
+                    else {
+                        body.insert(body.end(), {op_rgb, px.r, px.g, px.b});
+                    }
+                }
+
+                prev = px;
+            }
+
+            if (run > 0)
+                body.push_back(op_run | (run - 1));
+
+            // end marker
+            body.insert(body.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+
+            write_buffer(out, "", body);
+        }
+
+    private:
+        static constexpr unsigned char op_index = 0x00;
+        static constexpr unsigned char op_diff  = 0x40;
+        static constexpr unsigned char op_luma  = 0x80;
+        static constexpr unsigned char op_run   = 0xc0;
+        static constexpr unsigned char op_rgb   = 0xfe;
+
+        struct pixel {
+            unsigned char r, g, b, a;
+
+            bool operator==(const pixel& o) const {return r == o.r && g == o.g && b == o.b && a == o.a;}
+            int hash() const {return (r*3 + g*5 + b*7 + a*11) % 64;}
+        };
+
+        static void put_u32_be(std::vector<unsigned char>& body, uint32_t value) {
+            body.push_back((unsigned char)(value >> 24));
+            body.push_back((unsigned char)(value >> 16));
+            body.push_back((unsigned char)(value >> 8));
+            body.push_back((unsigned char)(value));
+        }
+};
+
+// returns the encoder for a format name ("p3", "p6", "pfm", "qoi"), or nullptr if unknown
+inline shared_ptr<image_encoder> make_image_encoder(const std::string& format) {
+    if (format == "p3" || format == "ppm") return make_shared<ppm_ascii_encoder>();
+    if (format == "p6")                    return make_shared<ppm_binary_encoder>();
+    if (format == "pfm")                   return make_shared<pfm_encoder>();
+    if (format == "qoi")                   return make_shared<qoi_encoder>();
+    return nullptr;
+}
+
+// returns the encoder matching the extension of a file name: ".pfm", ".qoi",
+// and binary PPM (P6) for anything else
+inline shared_ptr<image_encoder> make_image_encoder_for_path(const std::string& path) {
+    auto dot = path.rfind('.');
+    auto extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+    if (extension == "pfm" || extension == "qoi")
+        return make_image_encoder(extension);
+    return make_image_encoder("p6");
+}
+
+// writes an image to a file in the format matching its extension
+inline bool write_image_file(const framebuffer& image, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    make_image_encoder_for_path(path)->write(image, out);
+    return bool(out);
+}
+
+// switches standard output to binary mode so binary formats survive on Windows,
+// where text mode would expand every 0x0a byte to "\r\n"
+inline void set_stdout_binary() {
+#ifdef _WIN32
+    std::fflush(stdout);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+#endif  // end of image_encoder header file
@@ -0,0 +1,179 @@
+#ifndef INSTANCE_H  // start of instance header file
+#define INSTANCE_H  // affine_transform and instance class definitions
+
+// Import libraries
+#include "rtweekend.h"
+#include "aabb.h"
+#include "hittable.h"
+#include "render_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+// affine map p -> A p + b, stored as the 3 x 4 matrix [A | b]
+// affine_transform is the double instantiation used by scene descriptions
+template <typename T>
+class basic_affine_transform {
+    public:
+        T m[3][4];
+
+        // identity
+        basic_affine_transform() : m{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}} {}
+
+        // conversion between float and double transforms
+        template <typename U>
+        explicit basic_affine_transform(const basic_affine_transform<U>& other) {
+            for (int row = 0; row < 3; row++)
+                for (int col = 0; col < 4; col++)
+                    m[row][col] = T(other.m[row][col]);
+        }
+
+        static basic_affine_transform translation(const basic_vec3<T>& offset) {
+            basic_affine_transform result;
+            for (int row = 0; row < 3; row++)
+                result.m[row][3] = offset[row];
+            return result;
+        }
+
+        static basic_affine_transform scaling(const basic_vec3<T>& factors) {
+            basic_affine_transform result;
+            for (int row = 0; row < 3; row++)
+                result.m[row][row] = factors[row];
+            return result;
+        }
+
+        // rotation by degrees about axis through the origin, counterclockwise looking
+        // down the axis towards the origin (Rodrigues' formula)
+        static basic_affine_transform rotation(const basic_vec3<T>& axis, T degrees) {
+            auto a = unit_vector(axis);
+            auto c = std::cos(T(degrees_to_radians(degrees)));
+            auto s = std::sin(T(degrees_to_radians(degrees)));
+            basic_affine_transform result;
+            for (int row = 0; row < 3; row++)
+                for (int col = 0; col < 3; col++)
+                    result.m[row][col] = (1 - c) * a[row] * a[col] + (row == col ? c : 0);
+            result.m[0][1] -= s * a[2];   result.m[1][0] += s * a[2];
+            result.m[0][2] += s * a[1];   result.m[2][0] -= s * a[1];
+            result.m[1][2] -= s * a[0];   result.m[2][1] += s * a[0];
+            return result;
+        }
+
+        // the map "apply second, then first"
+        friend basic_affine_transform operator*(const basic_affine_transform& first, const basic_affine_transform& second) {
+            basic_affine_transform result;
+            for (int row = 0; row < 3; row++) {
+                for (int col = 0; col < 4; col++) {
+                    T sum = col == 3 ? first.m[row][3] : T(0);
+                    for (int k = 0; k < 3; k++)
+                        sum += first.m[row][k] * second.m[k][col];
+                    result.m[row][col] = sum;
+                }
+            }
+            return result;
+        }
+
+        basic_vec3<T> point(const basic_vec3<T>& p) const {
+            return vector(p) + basic_vec3<T>(m[0][3], m[1][3], m[2][3]);
+        }
+
+        // maps a direction, which the translation does not move
+        basic_vec3<T> vector(const basic_vec3<T>& v) const {
+            return basic_vec3<T>(m[0][0]*v[0] + m[0][1]*v[1] + m[0][2]*v[2],
+                                 m[1][0]*v[0] + m[1][1]*v[1] + m[1][2]*v[2],
+                                 m[2][0]*v[0] + m[2][1]*v[1] + m[2][2]*v[2]);
+        }
+
+        // maps v by the transpose of A; a surface normal of the image of this map is the
+        // transpose of its inverse applied to the normal
+        basic_vec3<T> transposed_vector(const basic_vec3<T>& v) const {
+            return basic_vec3<T>(m[0][0]*v[0] + m[1][0]*v[1] + m[2][0]*v[2],
+                                 m[0][1]*v[0] + m[1][1]*v[1] + m[2][1]*v[2],
+                                 m[0][2]*v[0] + m[1][2]*v[1] + m[2][2]*v[2]);
+        }
+
+        T determinant() const {
+            return m[0][0] * (m[1][1]*m[2][2] - m[1][2]*m[2][1])
+                 - m[0][1] * (m[1][0]*m[2][2] - m[1][2]*m[2][0])
+                 + m[0][2] * (m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+        }
+
+        // inverse map, by the adjugate of A
+        // NOTE: A must be invertible (no zero scale factor)
+        basic_affine_transform inverse() const {
+            basic_affine_transform result;
+            auto inv_det = 1 / determinant();
+            for (int row = 0; row < 3; row++) {
+                for (int col = 0; col < 3; col++) {
+                    int r0 = (col + 1) % 3, r1 = (col + 2) % 3;
+                    int c0 = (row + 1) % 3, c1 = (row + 2) % 3;
+                    result.m[row][col] = (m[r0][c0]*m[r1][c1] - m[r0][c1]*m[r1][c0]) * inv_det;
+                }
+            }
+            auto offset = result.vector(basic_vec3<T>(m[0][3], m[1][3], m[2][3]));
+            for (int row = 0; row < 3; row++)
+                result.m[row][3] = -offset[row];
+            return result;
+        }
+
+        // box enclosing the image of box, through its 8 corners
+        basic_aabb<T> bounding_box(const basic_aabb<T>& box) const {
+            T low[3]  = { T(infinity),  T(infinity),  T(infinity)};
+            T high[3] = {-T(infinity), -T(infinity), -T(infinity)};
+            for (int corner = 0; corner < 8; corner++) {
+                auto p = point(basic_vec3<T>(corner & 1 ? box.x.max : box.x.min,
+                                             corner & 2 ? box.y.max : box.y.min,
+                                             corner & 4 ? box.z.max : box.z.min));
+                for (int axis = 0; axis < 3; axis++) {
+                    low[axis]  = std::min(low[axis], p[axis]);
+                    high[axis] = std::max(high[axis], p[axis]);
+                }
+            }
+            return basic_aabb<T>(basic_vec3<T>(low[0], low[1], low[2]), basic_vec3<T>(high[0], high[1], high[2]));
+        }
+};
+
+// one placement of a shared object (typically a whole sub-hierarchy) in the scene
+// 1. the ray is moved into the object's space by the inverse transform and tested there,
+//    so any number of instances share one copy of the object's geometry and hierarchy
+// 2. the direction is not renormalized, so a hit's t is the same in both spaces and the
+//    hit point is found on the world ray
+// 3. the normal is mapped back by the transpose of the inverse transform; front_face
+//    keeps its meaning under every invertible transform
+// NOTE: only the inverse transform and the world box are stored, so an instance costs
+//       about 150 bytes (double) next to the shared object
+template <typename T>
+class basic_instance : public basic_hittable<T> {
+    public:
+        // places object with the object-to-world transform
+        basic_instance(shared_ptr<const basic_hittable<T>> object, const basic_affine_transform<T>& transform)
+            : object(std::move(object)), to_object(transform.inverse())
+        {
+            bbox = transform.bounding_box(this->object->bounding_box());
+        }
+
+        bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+            RT_STATS_COUNT(hit_calls[primitive_instance]++);
+
+            basic_ray<T> object_ray(to_object.point(r.origin()), to_object.vector(r.direction()));
+            if (!object->hit(object_ray, ray_t, rec))
+                return false;
+
+            rec.p      = r.at(rec.t);
+            rec.normal = unit_vector(to_object.transposed_vector(rec.normal));
+
+            RT_STATS_COUNT(hits[primitive_instance]++);
+            return true;
+        }
+
+        basic_aabb<T> bounding_box() const override {return bbox;}
+
+    private:
+        shared_ptr<const basic_hittable<T>> object;
+        basic_affine_transform<T>           to_object;  // world to object space
+        basic_aabb<T>                       bbox;       // world box, for the top level hierarchy
+};
+
+using affine_transform = basic_affine_transform<double>;
+using instance         = basic_instance<double>;
+
+#endif  // end of instance header file
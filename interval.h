@@ -5,41 +5,67 @@
 #include "rtweekend.h"
 
 // manages real-valued intervals with a minimum and a maximum
-class interval {
+// interval is the double instantiation, basic_interval<float> the single precision one
+template <typename T>
+class basic_interval {
     public:
-        double min, max;
+        T min, max;
 
-        interval() : min(+infinity), max(-infinity) {}  // Default interval is empty
+        constexpr basic_interval() : min(+std::numeric_limits<T>::infinity()),
+                                     max(-std::numeric_limits<T>::infinity()) {}  // Default interval is empty
 
-        interval(double min, double max) : min(min), max(max) {}
+        constexpr basic_interval(T min, T max) : min(min), max(max) {}
 
-        double size() const {
+        // creates the interval tightly enclosing the two input intervals
+        basic_interval(const basic_interval& a, const basic_interval& b) {
+            min = a.min <= b.min ? a.min : b.min;
+            max = a.max >= b.max ? a.max : b.max;
+        }
+
+        // conversion between float and double intervals
+        template <typename U>
+        explicit basic_interval(const basic_interval<U>& other) : min(T(other.min)), max(T(other.max)) {}
+
+        T size() const {
             return max - min;
         }
 
         // returns true if x is within the bounds of the interval
         // NOTE: includes min and max interval values
-        bool contains(double x) const {
+        bool contains(T x) const {
             return min <= x && x <= max;
         }
 
         // returns true if x is within the bounds of the interval
         // NOTE: does NOT include min and max interval values
-        bool surrounds(double x) const {
+        bool surrounds(T x) const {
             return min < x && x < max;
         }
 
         // clamps/bounds sample area color components to [min, max]
-        double clamp(double x) const {
+        T clamp(T x) const {
             if (x < min) return min;
             if (x > max) return max;
             return x;
         }
 
-        static const interval empty, universe;
+        // returns the interval padded by delta/2 on each side
+        basic_interval expand(T delta) const {
+            auto padding = delta/2;
+            return basic_interval(min - padding, max + padding);
+        }
+
+        static const basic_interval empty, universe;
 };
 
-const interval interval::empty      = interval(+infinity, -infinity);
-const interval interval::universe   = interval(-infinity, +infinity);
+// constant-initialized, so other statics may use them during their own initialization
+template <typename T>
+constexpr basic_interval<T> basic_interval<T>::empty    = basic_interval<T>(+std::numeric_limits<T>::infinity(),
+                                                                            -std::numeric_limits<T>::infinity());
+template <typename T>
+constexpr basic_interval<T> basic_interval<T>::universe = basic_interval<T>(-std::numeric_limits<T>::infinity(),
+                                                                            +std::numeric_limits<T>::infinity());
+
+using interval = basic_interval<double>;
 
-#endif  // end of interval header file
\ No newline at end of file
+#endif  // end of interval header file
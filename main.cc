@@ -5,61 +5,56 @@
 // Import libraries
 #include "rtweekend.h"
 
+#include "animation.h"
 #include "camera.h"
 #include "hittable.h"
-#include "hittable_list.h"
-#include "sphere.h"
+#include "mesh_file.h"
+#include "scene.h"
+#include "scene_file.h"
 
-int main() {
-    // World
-    hittable_list world;
-
-    // create and add ground material to world scene
-    auto material_ground    = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, material_ground));
+#include <chrono>
+#include <cstring>
+#include <string>
 
-    // generate random spheres
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            // random value to choose a material
-            auto choose_mat = random_double();
-            // random position in the viewport
-            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+// builds the scene as the requested kind of world in the scalar type of the camera and renders it;
+// returns false after printing why if the world cannot be built or nothing was written
+// the spheres are stored packed for the SIMD intersection kernel by default; "closed"
+// also removes the virtual material calls, but holds no instances or meshes
+template <typename T>
+bool render_scene(basic_camera<T> cam, const scene_description& scene, const std::string& world_kind) {
+    size_t world_bytes = 0;
+    auto report_footprint = [&]() {
+        auto spheres = scene.sphere_count();
+        std::clog << "World: " << spheres << " spheres";
+        if (!scene.instances.empty())
+            std::clog << " (" << scene.instances.size() << " instances)";
+        if (!scene.meshes.empty())
+            std::clog << ", " << scene.triangle_count() << " triangles";
+        std::clog << " in " << world_bytes << " bytes (" << world_bytes / std::max<size_t>(spheres, 1) << " bytes per sphere)\n";
+    };
 
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else {
-                    // glass
-                    sphere_material = make_shared<dialectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-            }
-        }
+    if (world_kind == "closed" && (!scene.instances.empty() || !scene.meshes.empty())) {
+        std::cerr << "The closed world cannot hold instances or meshes, use --world packed or objects\n";
+        return false;
     }
+    if (world_kind == "closed") {
+        auto world = scene.build_closed<T>(&world_bytes);
+        report_footprint();
+        return cam.render(world);
+    }
+    if (world_kind == "objects" || world_kind == "packed") {
+        auto world = world_kind == "objects" ? scene.build_objects<T>(&world_bytes)
+                                             : scene.build_packed<T>(&world_bytes);
+        report_footprint();
+        return cam.render(*world);
+    }
+    std::cerr << "Unknown world: " << world_kind << '\n';
+    return false;
+}
 
-    // create and add 3 large spheres to the world scene
-    auto material1 = make_shared<dialectric>(1.5);
-    world.add(make_shared<sphere>(point3(0,1,0), 1.0, material1));
-
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
-
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+int main(int argc, char* argv[]) {
+    // World
+    auto scene = random_spheres_scene();
 
     // Camera
     camera cam;
@@ -78,6 +73,200 @@ int main() {
     cam.defocus_angle   = 0.6;
     cam.focus_dist      = 10.0;
 
+    // parallel rendering (--threads N, 0 uses every hardware thread)
+    // per-sample random streams (--seed S)
+    // Russian roulette after N bounces (--roulette N)
+    // sample dimensions (--sampler independent|stratified|sobol|blue_noise), see sampler.h
+    // output image format (--format p3|p6|pfm|qoi)
+    // progressive passes (--pass-spp N) saved to a checkpoint file (--checkpoint FILE,
+    // --checkpoint-interval SECONDS) that a later run continues from (--resume)
+    // a deadline for the sampling (--time-budget SECONDS), which then takes as many passes,
+    // up to the samples per pixel, as fit before it
+    // adaptive sampling to a relative error (--adaptive THRESHOLD, --min-spp N) and a
+    // sample count image (--heatmap FILE)
+    // render statistics as JSON (--stats FILE, needs a -DRT_STATS build)
+    // world representation (--world packed|objects|closed), see scene_description
+    // scalar type of the world and the paths (--precision double|float)
+    // primary rays traced in packets of N x N pixels (--packet 2|4|8)
+    // wavefront integrator with N paths in flight per worker (--wavefront N)
+    // scene and camera read from a text or binary scene file (--scene FILE), so the flags
+    // after it still override its camera, or written to one instead of rendering
+    // (--save-scene FILE, binary for *.rtsb), see scene_file
+    // one part of a distributed render, written as a partial accumulation buffer
+    // (--partial FILE) for merge_partials: a pixel region (--region X0 Y0 X1 Y1), every
+    // Nth tile starting at tile K (--tiles K N) or samples [FIRST, LAST) of every pixel
+    // (--sample-range FIRST LAST) out of the samples of the whole render (--sample-total N,
+    // default LAST); render_coordinator runs the parts as local processes
+    // image width (--width N) and samples per pixel (--spp N)
+    // the sphere cluster of the scene instanced N times on a grid (--instances N), see
+    // instanced_clusters_scene
+    // denoising guided by normal, albedo and depth images (--denoise), which can also be
+    // written as PREFIX.normal.pfm, PREFIX.albedo.pfm and PREFIX.depth.pfm (--aov PREFIX)
+    // a diffuse triangle mesh read from an OBJ or binary mesh file (--mesh FILE), or the
+    // last one converted to a binary mesh file instead of rendering (--save-mesh FILE),
+    // see mesh_file
+    // an animation of N frames rendered to numbered files (--animate N, --frame-rate FPS,
+    // --frame-prefix PREFIX) in which every Kth sphere bounces (--bounce-every K) and the
+    // large spheres turn about the vertical axis, refitting the world's hierarchy each
+    // frame and rebuilding it once its boxes have grown R times (--rebuild-threshold R), see
+    // basic_animation_renderer
+    cam.thread_count    = 0;
+    std::string world_kind = "packed";
+    std::string precision  = "double";
+    std::string save_path;
+    std::string save_mesh_path;
+    shared_ptr<const mesh_buffers> last_mesh;
+    bool animate     = false;
+    int bounce_every = 10;
+    animation_settings animation;
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc)
+            cam.thread_count = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc)
+            cam.seed = std::strtoull(argv[++arg], nullptr, 10);
+        else if (std::strcmp(argv[arg], "--roulette") == 0 && arg + 1 < argc)
+            cam.roulette_depth = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--format") == 0 && arg + 1 < argc)
+            cam.output_format = argv[++arg];
+        else if (std::strcmp(argv[arg], "--sampler") == 0 && arg + 1 < argc)
+            cam.sampler = argv[++arg];
+        else if (std::strcmp(argv[arg], "--pass-spp") == 0 && arg + 1 < argc)
+            cam.samples_per_pass = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--time-budget") == 0 && arg + 1 < argc)
+            cam.time_budget = std::atof(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--checkpoint") == 0 && arg + 1 < argc)
+            cam.checkpoint_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--checkpoint-interval") == 0 && arg + 1 < argc)
+            cam.checkpoint_interval = std::atof(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--resume") == 0)
+            cam.resume = true;
+        else if (std::strcmp(argv[arg], "--adaptive") == 0 && arg + 1 < argc) {
+            cam.adaptive_sampling  = true;
+            cam.adaptive_threshold = std::atof(argv[++arg]);
+        }
+        else if (std::strcmp(argv[arg], "--min-spp") == 0 && arg + 1 < argc)
+            cam.adaptive_min_samples = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--heatmap") == 0 && arg + 1 < argc)
+            cam.sample_heatmap_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--stats") == 0 && arg + 1 < argc)
+            cam.stats_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--world") == 0 && arg + 1 < argc)
+            world_kind = argv[++arg];
+        else if (std::strcmp(argv[arg], "--precision") == 0 && arg + 1 < argc)
+            precision = argv[++arg];
+        else if (std::strcmp(argv[arg], "--packet") == 0 && arg + 1 < argc)
+            cam.packet_size = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--wavefront") == 0 && arg + 1 < argc)
+            cam.wavefront_size = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--scene") == 0 && arg + 1 < argc) {
+            std::string path = argv[++arg];
+            std::string error;
+            auto start = std::chrono::steady_clock::now();
+            if (!scene_file::load(path, scene, cam, error)) {
+                std::cerr << "Cannot load scene: " << error << '\n';
+                return 1;
+            }
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            std::clog << "Scene: " << scene.spheres.size() << " spheres loaded from " << path
+                      << " in " << took.count() << " ms\n";
+        }
+        else if (std::strcmp(argv[arg], "--save-scene") == 0 && arg + 1 < argc)
+            save_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--denoise") == 0)
+            cam.denoise = true;
+        else if (std::strcmp(argv[arg], "--aov") == 0 && arg + 1 < argc)
+            cam.aov_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--spp") == 0 && arg + 1 < argc)
+            cam.samples_per_pixel = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--width") == 0 && arg + 1 < argc)
+            cam.image_width = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--instances") == 0 && arg + 1 < argc)
+            scene = instanced_clusters_scene(std::atoi(argv[++arg]));
+        else if (std::strcmp(argv[arg], "--mesh") == 0 && arg + 1 < argc) {
+            std::string path = argv[++arg];
+            std::string error;
+            auto start = std::chrono::steady_clock::now();
+            if (!mesh_file::load(path, last_mesh, error)) {
+                std::cerr << "Cannot load mesh: " << error << '\n';
+                return 1;
+            }
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            std::clog << "Mesh: " << last_mesh->triangle_count() << " triangles loaded from " << path
+                      << " in " << took.count() << " ms\n";
+            scene.add_mesh(last_mesh, scene.add_material(lambertian(color(0.6, 0.6, 0.6))));
+        }
+        else if (std::strcmp(argv[arg], "--save-mesh") == 0 && arg + 1 < argc)
+            save_mesh_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--animate") == 0 && arg + 1 < argc) {
+            animate = true;
+            animation.frame_count = std::atoi(argv[++arg]);
+        }
+        else if (std::strcmp(argv[arg], "--frame-rate") == 0 && arg + 1 < argc)
+            animation.frame_rate = std::atof(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--frame-prefix") == 0 && arg + 1 < argc)
+            animation.frame_prefix = argv[++arg];
+        else if (std::strcmp(argv[arg], "--rebuild-threshold") == 0 && arg + 1 < argc)
+            animation.rebuild_threshold = std::atof(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--bounce-every") == 0 && arg + 1 < argc)
+            bounce_every = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--partial") == 0 && arg + 1 < argc)
+            cam.partial_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--region") == 0 && arg + 4 < argc) {
+            cam.region_x0 = std::atoi(argv[++arg]);
+            cam.region_y0 = std::atoi(argv[++arg]);
+            cam.region_x1 = std::atoi(argv[++arg]);
+            cam.region_y1 = std::atoi(argv[++arg]);
+        }
+        else if (std::strcmp(argv[arg], "--tiles") == 0 && arg + 2 < argc) {
+            cam.tile_share  = std::atoi(argv[++arg]);
+            cam.tile_shares = std::atoi(argv[++arg]);
+        }
+        else if (std::strcmp(argv[arg], "--sample-range") == 0 && arg + 2 < argc) {
+            cam.sample_first      = std::atoi(argv[++arg]);
+            cam.samples_per_pixel = std::atoi(argv[++arg]) - cam.sample_first;
+        }
+        else if (std::strcmp(argv[arg], "--sample-total") == 0 && arg + 1 < argc)
+            cam.sample_total = std::atoi(argv[++arg]);
+    }
+
+    if (!save_mesh_path.empty()) {
+        std::string error;
+        if (!last_mesh)
+            error = "no mesh loaded, use --mesh FILE";
+        if (!last_mesh || !mesh_file::save(save_mesh_path, *last_mesh, error)) {
+            std::cerr << "Cannot save mesh: " << error << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!save_path.empty()) {
+        std::string error;
+        if (!scene_file::save(save_path, scene, cam, error)) {
+            std::cerr << "Cannot save scene: " << error << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
     // Render
-    cam.render(world);
-}
\ No newline at end of file
+    if (animate) {
+        auto frames = bouncing_spheres_animation(scene, bounce_every);
+        bool rendered = false;
+        if (precision == "float")
+            rendered = basic_animation_renderer<float>(basic_camera<float>(cam), animation).render(frames, world_kind);
+        else if (precision == "double")
+            rendered = animation_renderer(cam, animation).render(frames, world_kind);
+        else
+            std::cerr << "Unknown precision: " << precision << '\n';
+        return rendered ? 0 : 1;
+    }
+
+    if (precision == "float")
+        return render_scene(basic_camera<float>(cam), scene, world_kind) ? 0 : 1;
+    if (precision == "double")
+        return render_scene(cam, scene, world_kind) ? 0 : 1;
+
+    std::cerr << "Unknown precision: " << precision << '\n';
+    return 1;
+}
@@ -0,0 +1,94 @@
+#ifndef MAPPED_FILE_H   // start of mapped_file header file
+#define MAPPED_FILE_H   // mapped_file class definition
+
+// Import libraries
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RT_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read-only view of a whole file, memory-mapped so that loading a large file costs no
+// copy and no allocation; the pages are read in by the OS as they are touched
+// NOTE: where mmap is not available the file is read into memory instead
+class mapped_file {
+    public:
+        mapped_file() {}
+        explicit mapped_file(const std::string& path) {open(path);}
+        ~mapped_file() {close();}
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        // maps path, replacing any file mapped before; false if it cannot be read
+        bool open(const std::string& path) {
+            close();
+#ifdef RT_HAVE_MMAP
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                ::close(fd);
+                return false;
+            }
+
+            length = size_t(info.st_size);
+            if (length > 0) {
+                void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    ::close(fd);
+                    length = 0;
+                    return false;
+                }
+                bytes = static_cast<const unsigned char*>(mapping);
+            }
+            ::close(fd);    // the mapping stays valid without the descriptor
+#else
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return false;
+            buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            bytes  = buffer.data();
+            length = buffer.size();
+#endif
+            opened = true;
+            return true;
+        }
+
+        void close() {
+#ifdef RT_HAVE_MMAP
+            if (bytes != nullptr)
+                munmap(const_cast<unsigned char*>(bytes), length);
+#else
+            buffer.clear();
+#endif
+            bytes  = nullptr;
+            length = 0;
+            opened = false;
+        }
+
+        bool is_open() const {return opened;}
+
+        const unsigned char* data() const {return bytes;}
+        size_t size() const {return length;}
+
+    private:
+        const unsigned char*    bytes   = nullptr;
+        size_t                  length  = 0;
+        bool                    opened  = false;
+#ifndef RT_HAVE_MMAP
+        std::vector<unsigned char> buffer;
+#endif
+};
+
+#endif  // end of mapped_file header file
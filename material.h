@@ -3,127 +3,304 @@
 
 // Import libraries
 #include "rtweekend.h"
+#include "arena.h"
 #include "hittable.h"
+#include "render_stats.h"
 
-// abstract class
-class hit_record;
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 
 // abstract class for defining materials
-class material {
+// NOTE: templated on the scalar type T like the rest of the scene; material, lambertian,
+//       metal and dialectric name the double instantiations
+template <typename T>
+class basic_material {
     public:
         // default constructor
-        virtual ~material() = default;
+        virtual ~basic_material() = default;
 
         // 1. Produce a scattered ray (or say it absorbed the incident ray).
         // 2. If scattered, say how much the ray should be attenuated.
+        // 3. Random decisions draw from gen, the generator of the current pixel sample.
         virtual bool scatter (
-            const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
+            const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_vec3<T>& attenuation,
+            basic_ray<T>& scattered, rng& gen
         ) const {
             return false;
         }
+
+        // built-in type of the material, which the wavefront integrator sorts hits by;
+        // material_kind_count for any other material
+        virtual material_kind kind() const {return material_kind_count;}
+
+        // surface color at the hit in rec, for the albedo buffer that guides the denoiser;
+        // white for materials without one
+        virtual basic_vec3<T> albedo_at(const basic_hit_record<T>& rec) const {return basic_vec3<T>(1, 1, 1);}
 };
 
 // lambertian material class definition
 // supports matte surfaces
-class lambertian : public material {
+template <typename T>
+class basic_lambertian final : public basic_material<T> {
     public:
         // implements abstract constructor of material class
-        lambertian(const color& albedo) : albedo(albedo) {}
+        basic_lambertian(const basic_vec3<T>& albedo) : albedo(albedo) {}
+
+        // conversion between float and double materials
+        template <typename U>
+        explicit basic_lambertian(const basic_lambertian<U>& other) : albedo(basic_vec3<T>(other.albedo)) {}
 
         // implements abstract method of material class
-        bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
+        bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_vec3<T>& attenuation,
+                     basic_ray<T>& scattered, rng& gen)
         const override {
-            auto scatter_direction = rec.normal + random_unit_vector();
+            RT_STATS_COUNT(scatter_calls[material_lambertian]++);
+            RT_STATS_COUNT(scattered[material_lambertian]++);
+
+            auto scatter_direction = rec.normal + random_unit_vector<T>(gen);
 
             // catch degenerate scatter direction
             if (scatter_direction.near_zero())
                 scatter_direction = rec.normal;
             
-            scattered = ray(rec.p, scatter_direction);
+            scattered = basic_ray<T>(rec.p, scatter_direction);
             // scatter with fixed probability p
             attenuation = albedo/rec.p.length();
             return true;
         }
 
+        material_kind kind() const override {return material_lambertian;}
+
+        basic_vec3<T> albedo_at(const basic_hit_record<T>&) const override {return albedo;}
+
+        // parameters, e.g. for writing the material to a scene file
+        const basic_vec3<T>& get_albedo() const {return albedo;}
+
     private:
+        template <typename> friend class basic_lambertian;
+
         // fractional reflectance
         // material color and incident viewing direction (direction of incoming ray)
-        color albedo;
+        basic_vec3<T> albedo;
 };
 
 // metal material class definition
 // supports regular and brushed metals
-class metal : public material {
+template <typename T>
+class basic_metal final : public basic_material<T> {
     public:
         // implements abstract constructor of material class
-        metal(const color& albedo, double fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+        basic_metal(const basic_vec3<T>& albedo, T fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
 
-        bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
+        // conversion between float and double materials
+        template <typename U>
+        explicit basic_metal(const basic_metal<U>& other) : albedo(basic_vec3<T>(other.albedo)), fuzz(T(other.fuzz)) {}
+
+        bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_vec3<T>& attenuation,
+                     basic_ray<T>& scattered, rng& gen)
         const override {
-            vec3 reflected  = reflect(r_in.direction(), rec.normal);
-            reflected       = unit_vector(reflected) + (fuzz * random_unit_vector());
-            scattered       = ray(rec.p, reflected);
+            RT_STATS_COUNT(scatter_calls[material_metal]++);
+
+            basic_vec3<T> reflected = reflect(r_in.direction(), rec.normal);
+            reflected       = unit_vector(reflected) + (fuzz * random_unit_vector<T>(gen));
+            scattered       = basic_ray<T>(rec.p, reflected);
 
             // ray from brushed metal does not scatter as much, more concentrated reflection
             attenuation     = albedo;
 
-            return (dot(scattered.direction(), rec.normal) > 0);
+            bool reflects = dot(scattered.direction(), rec.normal) > 0;
+            if (reflects)
+                RT_STATS_COUNT(scattered[material_metal]++);
+            return reflects;
         }
 
+        material_kind kind() const override {return material_metal;}
+
+        basic_vec3<T> albedo_at(const basic_hit_record<T>&) const override {return albedo;}
+
+        // parameters, e.g. for writing the material to a scene file
+        const basic_vec3<T>& get_albedo() const {return albedo;}
+        T get_fuzz() const {return fuzz;}
+
     private:
+        template <typename> friend class basic_metal;
+
         // fractional reflectance
         // material color and incident viewing direction (direction of incoming ray)
-        color   albedo;
+        basic_vec3<T>   albedo;
         // controls the randomness of reflected direction (fuzz factor)
-        double  fuzz;
+        T               fuzz;
 };
 
 // dialectric material class definition
 // supports clear materials like water, glass, diamond, etc.
-class dialectric : public material {
+template <typename T>
+class basic_dialectric final : public basic_material<T> {
     public:
-        dialectric(double refraction_index) : refraction_index(refraction_index) {}
+        basic_dialectric(T refraction_index) : refraction_index(refraction_index) {}
+
+        // conversion between float and double materials
+        template <typename U>
+        explicit basic_dialectric(const basic_dialectric<U>& other) : refraction_index(T(other.refraction_index)) {}
 
-        bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
+        bool scatter(const basic_ray<T>& r_in, const basic_hit_record<T>& rec, basic_vec3<T>& attenuation,
+                     basic_ray<T>& scattered, rng& gen)
         const override {
+            RT_STATS_COUNT(scatter_calls[material_dialectric]++);
+            RT_STATS_COUNT(scattered[material_dialectric]++);
+
             // attenuation = 1 means the glass surface absorbs nothing
-            attenuation         = color(1.0, 1.0, 1.0);
+            attenuation         = basic_vec3<T>(1, 1, 1);
 
             // refraction index: the amount a refracted ray bends
             // ri = 1.0 for air
-            double ri           = rec.front_face ? (1.0/refraction_index) : refraction_index;
+            T ri                = rec.front_face ? (1/refraction_index) : refraction_index;
 
-            vec3 unit_direction = unit_vector(r_in.direction());
-            double cos_theta    = fmin(dot(-unit_direction, rec.normal), 1.0);
-            double sin_theta    = sqrt(1.0 - cos_theta*cos_theta);
+            basic_vec3<T> unit_direction = unit_vector(r_in.direction());
+            T cos_theta         = std::fmin(dot(-unit_direction, rec.normal), T(1));
+            T sin_theta         = sqrt(1 - cos_theta*cos_theta);
 
-            bool cannot_refract = ri * sin_theta > 1.0;
-            vec3 direction;
+            bool cannot_refract = ri * sin_theta > 1;
+            basic_vec3<T> direction;
             
             // dialectric that always refracts if possible and reflects otherwise
-            if (cannot_refract || reflectance(cos_theta, ri) > random_double())
+            if (cannot_refract || reflectance(cos_theta, ri) > gen.random_double())
                 // total internal reflection (used for rays that glance/graze surface)
                 direction = reflect(unit_direction, rec.normal);
             else
                 // refraction for near-direct rays
                 direction = refract(unit_direction, rec.normal, ri);
 
-            scattered = ray(rec.p, direction);
+            scattered = basic_ray<T>(rec.p, direction);
             return true;
         }
 
+        material_kind kind() const override {return material_dialectric;}
+
+        // parameters, e.g. for writing the material to a scene file
+        T get_refraction_index() const {return refraction_index;}
+
     private:
+        template <typename> friend class basic_dialectric;
+
         // Refractive index in vacuum or air, or the ratio of the material's refractive index
         // over the refractive index of the enclosing media
-        double refraction_index;
+        T refraction_index;
 
-        static double reflectance(double cosine, double refraction_index) {
+        static T reflectance(T cosine, T refraction_index) {
             // Use Schlick's approximation for reflectance.
             auto r0 = (1 - refraction_index) / (1 + refraction_index);
             r0 = r0*r0;
 
-            return r0 + (1-r0)*pow((1-cosine), 5);
+            return r0 + (1-r0)*std::pow((1-cosine), T(5));
         }
 };
 
+using material   = basic_material<double>;
+using lambertian = basic_lambertian<double>;
+using metal      = basic_metal<double>;
+using dialectric = basic_dialectric<double>;
+
+// flat table owning the materials of a scene
+// primitives store a small index into the table and hit records get a raw pointer,
+// so intersection never copies a shared_ptr
+template <typename T>
+class basic_material_table {
+    public:
+        // adds a material (once, however often it is added) and returns its index
+        int add(const shared_ptr<basic_material<T>>& mat) {
+            auto found = ids.find(mat.get());
+            if (found != ids.end())
+                return found->second;
+
+            int id = int(materials.size());
+            materials.push_back(mat);
+            ids.emplace(mat.get(), id);
+            return id;
+        }
+
+        // material with the given index
+        const basic_material<T>* get(int id) const {return materials[id].get();}
+
+        int size() const {return int(materials.size());}
+
+        // bytes held by the table itself, approximating the hash map by one node per entry
+        size_t memory_bytes() const {
+            return materials.capacity() * sizeof(shared_ptr<basic_material<T>>)
+                 + ids.bucket_count() * sizeof(void*)
+                 + ids.size() * (sizeof(std::pair<const basic_material<T>*, int>) + 2 * sizeof(void*));
+        }
+
+    private:
+        std::vector<shared_ptr<basic_material<T>>>          materials;
+        std::unordered_map<const basic_material<T>*, int>   ids;
+};
+
+using material_table = basic_material_table<double>;
+
+// closed set of the built-in materials, stored by value for scenes rendered without
+// virtual calls (see closed_world)
+// NOTE: the shared_ptr alternative keeps any other material usable; only it is called virtually
+// NOTE: the built-in alternatives are listed in material_kind order
+template <typename T>
+using basic_material_variant = std::variant<basic_lambertian<T>, basic_metal<T>, basic_dialectric<T>,
+                                            shared_ptr<basic_material<T>>>;
+
+using material_variant = basic_material_variant<double>;
+
+// scatter through a material_variant
+// the built-in materials are final, so each case is a direct call the compiler can inline
+template <typename T>
+inline bool scatter(const basic_material_variant<T>& mat, const basic_ray<T>& r_in, const basic_hit_record<T>& rec,
+                    basic_vec3<T>& attenuation, basic_ray<T>& scattered, rng& gen)
+{
+    switch (mat.index()) {
+        case 0:  return std::get_if<0>(&mat)->scatter(r_in, rec, attenuation, scattered, gen);
+        case 1:  return std::get_if<1>(&mat)->scatter(r_in, rec, attenuation, scattered, gen);
+        case 2:  return std::get_if<2>(&mat)->scatter(r_in, rec, attenuation, scattered, gen);
+        default: return (*std::get_if<3>(&mat))->scatter(r_in, rec, attenuation, scattered, gen);
+    }
+}
+
+// the material held by a material_variant as a plain material pointer
+template <typename T>
+inline const basic_material<T>* material_pointer(const basic_material_variant<T>& mat) {
+    switch (mat.index()) {
+        case 0:  return std::get_if<0>(&mat);
+        case 1:  return std::get_if<1>(&mat);
+        case 2:  return std::get_if<2>(&mat);
+        default: return std::get_if<3>(&mat)->get();
+    }
+}
+
+// a copy of the material held by a material_variant placed in storage, for hittable scenes
+template <typename T>
+inline shared_ptr<basic_material<T>> make_material(const basic_material_variant<T>& mat,
+                                                   const shared_ptr<arena>& storage)
+{
+    switch (mat.index()) {
+        case 0:  return arena_shared<basic_lambertian<T>>(storage, *std::get_if<0>(&mat));
+        case 1:  return arena_shared<basic_metal<T>>(storage, *std::get_if<1>(&mat));
+        case 2:  return arena_shared<basic_dialectric<T>>(storage, *std::get_if<2>(&mat));
+        default: return *std::get_if<3>(&mat);
+    }
+}
+
+// the built-in material of a material_variant converted to the scalar type T
+// NOTE: other materials cannot be converted and become the base material, which absorbs
+//       every ray; scenes using them should be rendered in their own precision
+template <typename T, typename U>
+inline basic_material_variant<T> convert_material(const basic_material_variant<U>& mat) {
+    if constexpr (std::is_same<T, U>::value)
+        return mat;
+    else switch (mat.index()) {
+        case 0:  return basic_lambertian<T>(*std::get_if<0>(&mat));
+        case 1:  return basic_metal<T>(*std::get_if<1>(&mat));
+        case 2:  return basic_dialectric<T>(*std::get_if<2>(&mat));
+        default: return make_shared<basic_material<T>>();
+    }
+}
+
 #endif  // end of material header class
\ No newline at end of file
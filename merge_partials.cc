@@ -0,0 +1,74 @@
+/*  Merge tool for distributed renders
+*   Combines the partial accumulation buffers that the processes of a distributed render
+*   wrote (main.exe --partial FILE with --region, --tiles or --sample-range) and writes
+*   the final image. Partials of disjoint pixels give an image bit-identical to a single
+*   render with the same seed, see accumulation_buffer::merge.
+*
+*   usage: merge_partials.exe [--format p3|p6|pfm|qoi] [--output FILE] [--merged FILE] PARTIAL...
+*       --output    writes the image to FILE in the format of its extension instead of
+*                   standard output
+*       --merged    also writes the merged buffer, e.g. to merge it again with more parts
+*/
+
+// Import libraries
+#include "rtweekend.h"
+
+#include "accumulation_buffer.h"
+#include "image_encoder.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    std::string format = "p3";
+    std::string output_path, merged_path;
+    std::vector<std::string> partials;
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--format") == 0 && arg + 1 < argc)
+            format = argv[++arg];
+        else if (std::strcmp(argv[arg], "--output") == 0 && arg + 1 < argc)
+            output_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--merged") == 0 && arg + 1 < argc)
+            merged_path = argv[++arg];
+        else
+            partials.push_back(argv[arg]);
+    }
+
+    auto encoder = make_image_encoder(format);
+    if (partials.empty() || !encoder) {
+        std::cerr << "usage: merge_partials [--format p3|p6|pfm|qoi] [--output FILE] [--merged FILE] PARTIAL...\n";
+        return 1;
+    }
+
+    accumulation_buffer merged;
+    uint64_t seed;
+    std::string error;
+    if (!merge_partial_files(partials, merged, seed, error)) {
+        std::cerr << "Cannot merge: " << error << '\n';
+        return 1;
+    }
+
+    if (merged.min_samples() == 0)
+        std::cerr << "Warning: some pixels have no samples in any partial\n";
+    std::clog << "Merged " << partials.size() << " partials, " << merged.total_samples() << " samples\n";
+
+    if (!merged_path.empty() && !merged.save(merged_path, seed)) {
+        std::cerr << "Could not write " << merged_path << '\n';
+        return 1;
+    }
+
+    framebuffer image = merged.resolve();
+    if (!output_path.empty()) {
+        if (!write_image_file(image, output_path)) {
+            std::cerr << "Could not write " << output_path << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (encoder->binary())
+        set_stdout_binary();
+    encoder->write(image, std::cout);
+    std::cout.flush();
+}
@@ -0,0 +1,209 @@
+#ifndef MESH_FILE_H     // start of mesh_file header file
+#define MESH_FILE_H     // mesh_file class definition
+
+// Import libraries
+#include "rtweekend.h"
+#include "byte_io.h"
+#include "mapped_file.h"
+#include "triangle_mesh.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Mesh files
+// triangle meshes are read from one of two formats into mesh_buffers:
+// 1. Wavefront OBJ: "v x y z" lines give the vertices, "f a b c ..." lines the polygons,
+//    which are split into triangle fans; indices count from 1, negative ones from the
+//    end, and "a/t/n" references keep only the vertex; all other statements are skipped
+// 2. binary, little-endian, used in place from a memory mapping:
+//        "RTMS", version (u32), vertex count (u32), triangle count (u32)
+//        per vertex: x, y, z (3 x f32)
+//        per triangle: vertex indices (3 x u32)
+// NOTE: load tells the formats apart by the "RTMS" magic; save always writes binary
+// NOTE: a binary file's arrays are not copied, the buffers point into the mapping, so a
+//       mesh of millions of triangles loads in the time it takes to map and validate it
+class mesh_file {
+    public:
+        // replaces mesh with the mesh in the file at path; on failure returns false with a
+        // message in error
+        static bool load(const std::string& path, shared_ptr<const mesh_buffers>& mesh, std::string& error) {
+            auto file = make_shared<mapped_file>(path);
+            if (!file->is_open()) {
+                error = "cannot read " + path;
+                return false;
+            }
+
+            auto buffers = make_shared<mesh_buffers>();
+            bool binary  = file->size() >= 4 && std::memcmp(file->data(), "RTMS", 4) == 0;
+            bool loaded  = binary ? read_binary(file, *buffers, error) : read_obj(*file, *buffers, error);
+            if (loaded) {
+                auto bad = buffers->first_bad_triangle();
+                if (bad < buffers->triangle_count()) {
+                    error  = "triangle " + std::to_string(bad) + " uses an undefined vertex";
+                    loaded = false;
+                }
+            }
+            if (!loaded) {
+                error = path + ": " + error;
+                return false;
+            }
+            mesh = std::move(buffers);
+            return true;
+        }
+
+        // writes mesh to path in the binary format
+        static bool save(const std::string& path, const mesh_buffers& mesh, std::string& error) {
+            std::vector<unsigned char> bytes;
+            bytes.reserve(header_size + 12 * (mesh.vertex_count() + mesh.triangle_count()));
+            bytes.insert(bytes.end(), {'R', 'T', 'M', 'S'});
+            put_u32(bytes, file_version);
+            put_u32(bytes, uint32_t(mesh.vertex_count()));
+            put_u32(bytes, uint32_t(mesh.triangle_count()));
+            for (size_t k = 0; k < 3 * mesh.vertex_count(); k++) {
+                uint32_t bits;
+                std::memcpy(&bits, mesh.positions() + k, sizeof(bits));
+                put_u32(bytes, bits);
+            }
+            for (size_t k = 0; k < 3 * mesh.triangle_count(); k++)
+                put_u32(bytes, mesh.indices()[k]);
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+            if (!out) {
+                error = "cannot write " + path;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        static constexpr uint32_t file_version  = 1;
+        static constexpr size_t   header_size   = 16;
+
+        /* OBJ format */
+
+        static bool read_obj(const mapped_file& file, mesh_buffers& mesh, std::string& error) {
+            const char* p   = reinterpret_cast<const char*>(file.data());
+            const char* end = p + file.size();
+
+            std::vector<float>    positions;
+            std::vector<uint32_t> indices;
+            std::vector<long>     polygon;
+            for (int line = 1; p < end; line++) {
+                auto eol = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+                if (eol == nullptr)
+                    eol = end;
+                const char* q = p;
+                p = eol < end ? eol + 1 : end;
+
+                skip_space(q, eol);
+                if (eol - q < 2 || (q[1] != ' ' && q[1] != '\t') || (q[0] != 'v' && q[0] != 'f'))
+                    continue;   // blank line, comment or a statement without geometry
+                char statement = q[0];
+                q += 2;
+
+                if (statement == 'v') {
+                    for (int axis = 0; axis < 3; axis++) {
+                        float value;
+                        skip_space(q, eol);
+                        auto result = std::from_chars(q, eol, value);
+                        if (result.ec != std::errc()) {
+                            error = "line " + std::to_string(line) + ": malformed vertex";
+                            return false;
+                        }
+                        positions.push_back(value);
+                        q = result.ptr;
+                    }
+                    continue;
+                }
+
+                // face: the vertex of every "v/t/n" reference, split into a fan
+                polygon.clear();
+                while (true) {
+                    skip_space(q, eol);
+                    if (q == eol || *q == '#' || *q == '\r')
+                        break;
+                    long index;
+                    auto result = std::from_chars(q, eol, index);
+                    long vertices = long(positions.size() / 3);
+                    if (result.ec != std::errc() || index == 0 || index > vertices || -index > vertices) {
+                        error = "line " + std::to_string(line) + ": bad vertex reference";
+                        return false;
+                    }
+                    polygon.push_back(index > 0 ? index - 1 : vertices + index);
+                    q = result.ptr;
+                    while (q < eol && *q != ' ' && *q != '\t' && *q != '\r')
+                        q++;    // texture and normal references
+                }
+                if (polygon.size() < 3) {
+                    error = "line " + std::to_string(line) + ": face with fewer than 3 vertices";
+                    return false;
+                }
+                for (size_t k = 1; k + 1 < polygon.size(); k++)
+                    indices.insert(indices.end(), {uint32_t(polygon[0]), uint32_t(polygon[k]), uint32_t(polygon[k + 1])});
+            }
+
+            mesh.assign(std::move(positions), std::move(indices));
+            return true;
+        }
+
+        static void skip_space(const char*& p, const char* end) {
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+        }
+
+        /* Binary format */
+
+        static bool read_binary(const shared_ptr<const mapped_file>& file, mesh_buffers& mesh, std::string& error) {
+            const unsigned char* data = file->data();
+            if (file->size() < header_size) {
+                error = "truncated mesh file";
+                return false;
+            }
+            if (get_u32(data + 4) != file_version) {
+                error = "mesh file version " + std::to_string(get_u32(data + 4)) + " is not supported";
+                return false;
+            }
+
+            uint64_t vertex_count   = get_u32(data + 8);
+            uint64_t triangle_count = get_u32(data + 12);
+            if (file->size() != header_size + 12 * (vertex_count + triangle_count)) {
+                error = "file size does not match its vertex and triangle counts";
+                return false;
+            }
+
+            // the arrays are read in place where the file's byte order is the machine's
+            // and copied with the bytes swapped elsewhere
+            const unsigned char* vertex_bytes = data + header_size;
+            const unsigned char* index_bytes  = vertex_bytes + 12 * vertex_count;
+            if (little_endian()) {
+                mesh.view(file, reinterpret_cast<const float*>(vertex_bytes), size_t(vertex_count),
+                          reinterpret_cast<const uint32_t*>(index_bytes), size_t(triangle_count));
+                return true;
+            }
+
+            std::vector<float>    positions(size_t(3 * vertex_count));
+            std::vector<uint32_t> indices(size_t(3 * triangle_count));
+            for (size_t k = 0; k < positions.size(); k++) {
+                uint32_t bits = get_u32(vertex_bytes + 4*k);
+                std::memcpy(&positions[k], &bits, sizeof(bits));
+            }
+            for (size_t k = 0; k < indices.size(); k++)
+                indices[k] = get_u32(index_bytes + 4*k);
+            mesh.assign(std::move(positions), std::move(indices));
+            return true;
+        }
+
+        static bool little_endian() {
+            uint32_t probe = 1;
+            unsigned char first;
+            std::memcpy(&first, &probe, 1);
+            return first == 1;
+        }
+};
+
+#endif  // end of mesh_file header file
@@ -0,0 +1,1084 @@
+#ifndef PACKED_SPHERES_H    // start of packed_spheres header file
+#define PACKED_SPHERES_H    // packed_spheres class definition
+
+// Import libraries
+#include "rtweekend.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "material.h"
+#include "render_stats.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RT_SPHERE_SIMD_X86 1
+#include <immintrin.h>
+
+// keeps GCC from fusing the kernel multiplies and adds into FMA instructions,
+// which would round differently from the scalar reference
+#if defined(__clang__)
+#define RT_NO_FP_CONTRACT
+#else
+#define RT_NO_FP_CONTRACT , optimize("fp-contract=off")
+#endif
+#endif
+
+// read-only view of the packed sphere arrays handed to the intersection kernels
+template <typename T>
+struct basic_sphere_arrays {
+    const T* cx;            // center x coordinates
+    const T* cy;            // center y coordinates
+    const T* cz;            // center z coordinates
+    const T* radius_sq;     // squared radii
+};
+
+using sphere_arrays = basic_sphere_arrays<double>;
+
+// nearest-hit kernel: tests one ray against spheres [first, last) and returns the index of
+// the sphere with the nearest root inside ray_t (-1 on a miss), lowering ray_t.max to it
+// NOTE: every kernel follows the arithmetic of sphere::hit operation for operation, so all
+//       of them return the same sphere and the same root as the scalar reference of
+//       their scalar type
+template <typename T>
+using basic_sphere_kernel = int (*)(const basic_sphere_arrays<T>& s, int first, int last,
+                                    const basic_ray<T>& r, basic_interval<T>& ray_t);
+
+using sphere_kernel = basic_sphere_kernel<double>;
+
+// scalar reference kernel
+template <typename T>
+inline int nearest_sphere_scalar(const basic_sphere_arrays<T>& s, int first, int last,
+                                 const basic_ray<T>& r, basic_interval<T>& ray_t)
+{
+    const basic_vec3<T>& o = r.origin();
+    const basic_vec3<T>& d = r.direction();
+    auto a = d.length_squared();
+
+    int best = -1;
+    for (int i = first; i < last; i++) {
+        auto ocx = s.cx[i] - o.x();
+        auto ocy = s.cy[i] - o.y();
+        auto ocz = s.cz[i] - o.z();
+        auto h   = d.x()*ocx + d.y()*ocy + d.z()*ocz;
+        auto c   = (ocx*ocx + ocy*ocy + ocz*ocz) - s.radius_sq[i];
+
+        auto discriminant = h*h - a*c;
+        if (discriminant < 0)
+            continue;
+
+        auto sqrtd = sqrt(discriminant);
+        auto root  = (h - sqrtd) / a;
+        if (!ray_t.surrounds(root)) {
+            root = (h + sqrtd) / a;
+            if (!ray_t.surrounds(root))
+                continue;
+        }
+
+        ray_t.max = root;
+        best      = i;
+    }
+    return best;
+}
+
+// packet kernel: tests the active lanes of a ray packet against spheres [first, last)
+// and, for every lane in lanes whose nearest root inside (t_min, t_max[l]) belongs to one
+// of them, lowers t_max[l] to that root and sets best[l] to the sphere
+// 1. a[l] is the squared length of the direction of lane l
+// 2. the SIMD kernels put packet lanes, not spheres, into the vector lanes, so one sphere
+//    is broadcast and tested against 2 to 16 rays at once
+// NOTE: the arithmetic is that of nearest_sphere_scalar, so every lane finds the same
+//       sphere and root as its ray would alone; a, t_max and best need room for
+//       basic_ray_packet<T>::max_lanes entries
+template <typename T>
+using basic_sphere_packet_kernel = void (*)(const basic_sphere_arrays<T>& s, int first, int last,
+                                            const basic_ray_packet<T>& p, const T* a, uint64_t lanes,
+                                            T t_min, T* t_max, int* best);
+
+// scalar reference packet kernel, one lane at a time
+template <typename T>
+inline void nearest_sphere_packet_scalar(const basic_sphere_arrays<T>& s, int first, int last,
+                                         const basic_ray_packet<T>& p, const T*, uint64_t lanes,
+                                         T t_min, T* t_max, int* best)
+{
+    for (int lane = 0; lane < p.lanes; lane++) {
+        if (!((lanes >> lane) & 1u))
+            continue;
+
+        basic_interval<T> ray_t(t_min, t_max[lane]);
+        int i = nearest_sphere_scalar(s, first, last, p.ray(lane), ray_t);
+        if (i >= 0) {
+            t_max[lane] = ray_t.max;
+            best[lane]  = i;
+        }
+    }
+}
+
+#ifdef RT_SPHERE_SIMD_X86
+
+// picks the nearest of the candidate roots of one block in lane order, so ties resolve to
+// the lowest index exactly like the scalar loop
+template <typename T>
+inline void merge_sphere_lanes(const T* roots, int lanes, unsigned mask, int base,
+                               basic_interval<T>& ray_t, int& best)
+{
+    for (int lane = 0; lane < lanes; lane++) {
+        if ((mask >> lane) & 1u) {
+            if (roots[lane] < ray_t.max) {
+                ray_t.max = roots[lane];
+                best      = base + lane;
+            }
+        }
+    }
+}
+
+// records the roots one sphere has in a group of packet lanes starting at lane base
+template <typename T>
+inline void merge_packet_lanes(const T* roots, unsigned mask, int base, int sphere, T* t_max, int* best) {
+    for (; mask; mask &= mask - 1) {
+        int lane = __builtin_ctz(mask);
+        t_max[base + lane] = roots[lane];
+        best[base + lane]  = sphere;
+    }
+}
+
+// SSE2 kernel, 2 spheres per step
+__attribute__((target("sse2") RT_NO_FP_CONTRACT))
+inline int nearest_sphere_sse2(const sphere_arrays& s, int first, int last, const ray& r, interval& ray_t) {
+    const point3& o = r.origin();
+    const vec3&   d = r.direction();
+    auto a = d.length_squared();
+
+    const __m128d ox = _mm_set1_pd(o.x()), oy = _mm_set1_pd(o.y()), oz = _mm_set1_pd(o.z());
+    const __m128d dx = _mm_set1_pd(d.x()), dy = _mm_set1_pd(d.y()), dz = _mm_set1_pd(d.z());
+    const __m128d va = _mm_set1_pd(a);
+    const __m128d zero = _mm_setzero_pd();
+
+    int best = -1;
+    int i    = first;
+    for (; i + 2 <= last; i += 2) {
+        __m128d ocx = _mm_sub_pd(_mm_loadu_pd(s.cx + i), ox);
+        __m128d ocy = _mm_sub_pd(_mm_loadu_pd(s.cy + i), oy);
+        __m128d ocz = _mm_sub_pd(_mm_loadu_pd(s.cz + i), oz);
+        __m128d h   = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, ocx), _mm_mul_pd(dy, ocy)), _mm_mul_pd(dz, ocz));
+        __m128d len = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)), _mm_mul_pd(ocz, ocz));
+        __m128d c   = _mm_sub_pd(len, _mm_loadu_pd(s.radius_sq + i));
+        __m128d disc = _mm_sub_pd(_mm_mul_pd(h, h), _mm_mul_pd(va, c));
+
+        __m128d has_roots = _mm_cmpge_pd(disc, zero);
+        if (_mm_movemask_pd(has_roots) == 0)
+            continue;
+
+        __m128d sqrtd = _mm_sqrt_pd(_mm_max_pd(disc, zero));
+        __m128d tmin  = _mm_set1_pd(ray_t.min), tmax = _mm_set1_pd(ray_t.max);
+        __m128d near  = _mm_div_pd(_mm_sub_pd(h, sqrtd), va);
+        __m128d far   = _mm_div_pd(_mm_add_pd(h, sqrtd), va);
+        __m128d near_ok = _mm_and_pd(_mm_cmplt_pd(tmin, near), _mm_cmplt_pd(near, tmax));
+        __m128d far_ok  = _mm_and_pd(_mm_cmplt_pd(tmin, far),  _mm_cmplt_pd(far,  tmax));
+        __m128d root    = _mm_or_pd(_mm_and_pd(near_ok, near), _mm_andnot_pd(near_ok, far));
+        __m128d ok      = _mm_and_pd(has_roots, _mm_or_pd(near_ok, far_ok));
+
+        unsigned mask = unsigned(_mm_movemask_pd(ok));
+        if (mask) {
+            alignas(16) double roots[2];
+            _mm_store_pd(roots, root);
+            merge_sphere_lanes(roots, 2, mask, i, ray_t, best);
+        }
+    }
+
+    int tail = nearest_sphere_scalar(s, i, last, r, ray_t);
+    return tail >= 0 ? tail : best;
+}
+
+// AVX2 kernel, 4 spheres per step
+__attribute__((target("avx2") RT_NO_FP_CONTRACT))
+inline int nearest_sphere_avx2(const sphere_arrays& s, int first, int last, const ray& r, interval& ray_t) {
+    const point3& o = r.origin();
+    const vec3&   d = r.direction();
+    auto a = d.length_squared();
+
+    const __m256d ox = _mm256_set1_pd(o.x()), oy = _mm256_set1_pd(o.y()), oz = _mm256_set1_pd(o.z());
+    const __m256d dx = _mm256_set1_pd(d.x()), dy = _mm256_set1_pd(d.y()), dz = _mm256_set1_pd(d.z());
+    const __m256d va = _mm256_set1_pd(a);
+    const __m256d zero = _mm256_setzero_pd();
+
+    int best = -1;
+    int i    = first;
+    for (; i + 4 <= last; i += 4) {
+        __m256d ocx = _mm256_sub_pd(_mm256_loadu_pd(s.cx + i), ox);
+        __m256d ocy = _mm256_sub_pd(_mm256_loadu_pd(s.cy + i), oy);
+        __m256d ocz = _mm256_sub_pd(_mm256_loadu_pd(s.cz + i), oz);
+        __m256d h   = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, ocx), _mm256_mul_pd(dy, ocy)), _mm256_mul_pd(dz, ocz));
+        __m256d len = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz));
+        __m256d c   = _mm256_sub_pd(len, _mm256_loadu_pd(s.radius_sq + i));
+        __m256d disc = _mm256_sub_pd(_mm256_mul_pd(h, h), _mm256_mul_pd(va, c));
+
+        __m256d has_roots = _mm256_cmp_pd(disc, zero, _CMP_GE_OQ);
+        if (_mm256_movemask_pd(has_roots) == 0)
+            continue;
+
+        __m256d sqrtd = _mm256_sqrt_pd(_mm256_max_pd(disc, zero));
+        __m256d tmin  = _mm256_set1_pd(ray_t.min), tmax = _mm256_set1_pd(ray_t.max);
+        __m256d near  = _mm256_div_pd(_mm256_sub_pd(h, sqrtd), va);
+        __m256d far   = _mm256_div_pd(_mm256_add_pd(h, sqrtd), va);
+        __m256d near_ok = _mm256_and_pd(_mm256_cmp_pd(tmin, near, _CMP_LT_OQ), _mm256_cmp_pd(near, tmax, _CMP_LT_OQ));
+        __m256d far_ok  = _mm256_and_pd(_mm256_cmp_pd(tmin, far,  _CMP_LT_OQ), _mm256_cmp_pd(far,  tmax, _CMP_LT_OQ));
+        __m256d root    = _mm256_blendv_pd(far, near, near_ok);
+        __m256d ok      = _mm256_and_pd(has_roots, _mm256_or_pd(near_ok, far_ok));
+
+        unsigned mask = unsigned(_mm256_movemask_pd(ok));
+        if (mask) {
+            alignas(32) double roots[4];
+            _mm256_store_pd(roots, root);
+            merge_sphere_lanes(roots, 4, mask, i, ray_t, best);
+        }
+    }
+
+    int tail = nearest_sphere_scalar(s, i, last, r, ray_t);
+    return tail >= 0 ? tail : best;
+}
+
+// SSE kernel for float spheres, 4 spheres per step
+// NOTE: the float kernels are overloads of the double ones, find_sphere_kernel<float>
+//       picks them by their signature
+__attribute__((target("sse2") RT_NO_FP_CONTRACT))
+inline int nearest_sphere_sse2(const basic_sphere_arrays<float>& s, int first, int last,
+                               const basic_ray<float>& r, basic_interval<float>& ray_t)
+{
+    const basic_vec3<float>& o = r.origin();
+    const basic_vec3<float>& d = r.direction();
+    auto a = d.length_squared();
+
+    const __m128 ox = _mm_set1_ps(o.x()), oy = _mm_set1_ps(o.y()), oz = _mm_set1_ps(o.z());
+    const __m128 dx = _mm_set1_ps(d.x()), dy = _mm_set1_ps(d.y()), dz = _mm_set1_ps(d.z());
+    const __m128 va = _mm_set1_ps(a);
+    const __m128 zero = _mm_setzero_ps();
+
+    int best = -1;
+    int i    = first;
+    for (; i + 4 <= last; i += 4) {
+        __m128 ocx = _mm_sub_ps(_mm_loadu_ps(s.cx + i), ox);
+        __m128 ocy = _mm_sub_ps(_mm_loadu_ps(s.cy + i), oy);
+        __m128 ocz = _mm_sub_ps(_mm_loadu_ps(s.cz + i), oz);
+        __m128 h   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ocx), _mm_mul_ps(dy, ocy)), _mm_mul_ps(dz, ocz));
+        __m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz));
+        __m128 c   = _mm_sub_ps(len, _mm_loadu_ps(s.radius_sq + i));
+        __m128 disc = _mm_sub_ps(_mm_mul_ps(h, h), _mm_mul_ps(va, c));
+
+        __m128 has_roots = _mm_cmpge_ps(disc, zero);
+        if (_mm_movemask_ps(has_roots) == 0)
+            continue;
+
+        __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+        __m128 tmin  = _mm_set1_ps(ray_t.min), tmax = _mm_set1_ps(ray_t.max);
+        __m128 near  = _mm_div_ps(_mm_sub_ps(h, sqrtd), va);
+        __m128 far   = _mm_div_ps(_mm_add_ps(h, sqrtd), va);
+        __m128 near_ok = _mm_and_ps(_mm_cmplt_ps(tmin, near), _mm_cmplt_ps(near, tmax));
+        __m128 far_ok  = _mm_and_ps(_mm_cmplt_ps(tmin, far),  _mm_cmplt_ps(far,  tmax));
+        __m128 root    = _mm_or_ps(_mm_and_ps(near_ok, near), _mm_andnot_ps(near_ok, far));
+        __m128 ok      = _mm_and_ps(has_roots, _mm_or_ps(near_ok, far_ok));
+
+        unsigned mask = unsigned(_mm_movemask_ps(ok));
+        if (mask) {
+            alignas(16) float roots[4];
+            _mm_store_ps(roots, root);
+            merge_sphere_lanes(roots, 4, mask, i, ray_t, best);
+        }
+    }
+
+    int tail = nearest_sphere_scalar(s, i, last, r, ray_t);
+    return tail >= 0 ? tail : best;
+}
+
+// AVX2 kernel for float spheres, 8 spheres per step
+__attribute__((target("avx2") RT_NO_FP_CONTRACT))
+inline int nearest_sphere_avx2(const basic_sphere_arrays<float>& s, int first, int last,
+                               const basic_ray<float>& r, basic_interval<float>& ray_t)
+{
+    const basic_vec3<float>& o = r.origin();
+    const basic_vec3<float>& d = r.direction();
+    auto a = d.length_squared();
+
+    const __m256 ox = _mm256_set1_ps(o.x()), oy = _mm256_set1_ps(o.y()), oz = _mm256_set1_ps(o.z());
+    const __m256 dx = _mm256_set1_ps(d.x()), dy = _mm256_set1_ps(d.y()), dz = _mm256_set1_ps(d.z());
+    const __m256 va = _mm256_set1_ps(a);
+    const __m256 zero = _mm256_setzero_ps();
+
+    int best = -1;
+    int i    = first;
+    for (; i + 8 <= last; i += 8) {
+        __m256 ocx = _mm256_sub_ps(_mm256_loadu_ps(s.cx + i), ox);
+        __m256 ocy = _mm256_sub_ps(_mm256_loadu_ps(s.cy + i), oy);
+        __m256 ocz = _mm256_sub_ps(_mm256_loadu_ps(s.cz + i), oz);
+        __m256 h   = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ocx), _mm256_mul_ps(dy, ocy)), _mm256_mul_ps(dz, ocz));
+        __m256 len = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+        __m256 c   = _mm256_sub_ps(len, _mm256_loadu_ps(s.radius_sq + i));
+        __m256 disc = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(va, c));
+
+        __m256 has_roots = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+        if (_mm256_movemask_ps(has_roots) == 0)
+            continue;
+
+        __m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+        __m256 tmin  = _mm256_set1_ps(ray_t.min), tmax = _mm256_set1_ps(ray_t.max);
+        __m256 near  = _mm256_div_ps(_mm256_sub_ps(h, sqrtd), va);
+        __m256 far   = _mm256_div_ps(_mm256_add_ps(h, sqrtd), va);
+        __m256 near_ok = _mm256_and_ps(_mm256_cmp_ps(tmin, near, _CMP_LT_OQ), _mm256_cmp_ps(near, tmax, _CMP_LT_OQ));
+        __m256 far_ok  = _mm256_and_ps(_mm256_cmp_ps(tmin, far,  _CMP_LT_OQ), _mm256_cmp_ps(far,  tmax, _CMP_LT_OQ));
+        __m256 root    = _mm256_blendv_ps(far, near, near_ok);
+        __m256 ok      = _mm256_and_ps(has_roots, _mm256_or_ps(near_ok, far_ok));
+
+        unsigned mask = unsigned(_mm256_movemask_ps(ok));
+        if (mask) {
+            alignas(32) float roots[8];
+            _mm256_store_ps(roots, root);
+            merge_sphere_lanes(roots, 8, mask, i, ray_t, best);
+        }
+    }
+
+    int tail = nearest_sphere_scalar(s, i, last, r, ray_t);
+    return tail >= 0 ? tail : best;
+}
+
+// SSE2 packet kernel, 2 lanes per step
+__attribute__((target("sse2") RT_NO_FP_CONTRACT))
+inline void nearest_sphere_packet_sse2(const sphere_arrays& s, int first, int last, const ray_packet& p,
+                                       const double* a, uint64_t lanes, double t_min, double* t_max, int* best)
+{
+    const __m128d zero = _mm_setzero_pd(), tmin = _mm_set1_pd(t_min);
+
+    for (int g = 0; g < p.lanes; g += 2) {
+        unsigned live = unsigned(lanes >> g) & 0x3u;
+        if (live == 0)
+            continue;
+
+        const __m128d ox = _mm_load_pd(p.ox + g), oy = _mm_load_pd(p.oy + g), oz = _mm_load_pd(p.oz + g);
+        const __m128d dx = _mm_load_pd(p.dx + g), dy = _mm_load_pd(p.dy + g), dz = _mm_load_pd(p.dz + g);
+        const __m128d va = _mm_loadu_pd(a + g);
+        __m128d tmax = _mm_loadu_pd(t_max + g);
+
+        for (int i = first; i < last; i++) {
+            __m128d ocx = _mm_sub_pd(_mm_set1_pd(s.cx[i]), ox);
+            __m128d ocy = _mm_sub_pd(_mm_set1_pd(s.cy[i]), oy);
+            __m128d ocz = _mm_sub_pd(_mm_set1_pd(s.cz[i]), oz);
+            __m128d h   = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, ocx), _mm_mul_pd(dy, ocy)), _mm_mul_pd(dz, ocz));
+            __m128d len = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)), _mm_mul_pd(ocz, ocz));
+            __m128d c   = _mm_sub_pd(len, _mm_set1_pd(s.radius_sq[i]));
+            __m128d disc = _mm_sub_pd(_mm_mul_pd(h, h), _mm_mul_pd(va, c));
+
+            __m128d has_roots = _mm_cmpge_pd(disc, zero);
+            if ((unsigned(_mm_movemask_pd(has_roots)) & live) == 0)
+                continue;
+
+            __m128d sqrtd = _mm_sqrt_pd(_mm_max_pd(disc, zero));
+            __m128d near  = _mm_div_pd(_mm_sub_pd(h, sqrtd), va);
+            __m128d far   = _mm_div_pd(_mm_add_pd(h, sqrtd), va);
+            __m128d near_ok = _mm_and_pd(_mm_cmplt_pd(tmin, near), _mm_cmplt_pd(near, tmax));
+            __m128d far_ok  = _mm_and_pd(_mm_cmplt_pd(tmin, far),  _mm_cmplt_pd(far,  tmax));
+            __m128d root    = _mm_or_pd(_mm_and_pd(near_ok, near), _mm_andnot_pd(near_ok, far));
+            __m128d ok      = _mm_and_pd(has_roots, _mm_or_pd(near_ok, far_ok));
+
+            unsigned mask = unsigned(_mm_movemask_pd(ok)) & live;
+            if (mask) {
+                alignas(16) double roots[2];
+                _mm_store_pd(roots, root);
+                merge_packet_lanes(roots, mask, g, i, t_max, best);
+                tmax = _mm_loadu_pd(t_max + g);
+            }
+        }
+    }
+}
+
+// AVX2 packet kernel, 4 lanes per step
+__attribute__((target("avx2") RT_NO_FP_CONTRACT))
+inline void nearest_sphere_packet_avx2(const sphere_arrays& s, int first, int last, const ray_packet& p,
+                                       const double* a, uint64_t lanes, double t_min, double* t_max, int* best)
+{
+    const __m256d zero = _mm256_setzero_pd(), tmin = _mm256_set1_pd(t_min);
+
+    for (int g = 0; g < p.lanes; g += 4) {
+        unsigned live = unsigned(lanes >> g) & 0xfu;
+        if (live == 0)
+            continue;
+
+        const __m256d ox = _mm256_load_pd(p.ox + g), oy = _mm256_load_pd(p.oy + g), oz = _mm256_load_pd(p.oz + g);
+        const __m256d dx = _mm256_load_pd(p.dx + g), dy = _mm256_load_pd(p.dy + g), dz = _mm256_load_pd(p.dz + g);
+        const __m256d va = _mm256_loadu_pd(a + g);
+        __m256d tmax = _mm256_loadu_pd(t_max + g);
+
+        for (int i = first; i < last; i++) {
+            __m256d ocx = _mm256_sub_pd(_mm256_set1_pd(s.cx[i]), ox);
+            __m256d ocy = _mm256_sub_pd(_mm256_set1_pd(s.cy[i]), oy);
+            __m256d ocz = _mm256_sub_pd(_mm256_set1_pd(s.cz[i]), oz);
+            __m256d h   = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, ocx), _mm256_mul_pd(dy, ocy)), _mm256_mul_pd(dz, ocz));
+            __m256d len = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz));
+            __m256d c   = _mm256_sub_pd(len, _mm256_set1_pd(s.radius_sq[i]));
+            __m256d disc = _mm256_sub_pd(_mm256_mul_pd(h, h), _mm256_mul_pd(va, c));
+
+            __m256d has_roots = _mm256_cmp_pd(disc, zero, _CMP_GE_OQ);
+            if ((unsigned(_mm256_movemask_pd(has_roots)) & live) == 0)
+                continue;
+
+            __m256d sqrtd = _mm256_sqrt_pd(_mm256_max_pd(disc, zero));
+            __m256d near  = _mm256_div_pd(_mm256_sub_pd(h, sqrtd), va);
+            __m256d far   = _mm256_div_pd(_mm256_add_pd(h, sqrtd), va);
+            __m256d near_ok = _mm256_and_pd(_mm256_cmp_pd(tmin, near, _CMP_LT_OQ), _mm256_cmp_pd(near, tmax, _CMP_LT_OQ));
+            __m256d far_ok  = _mm256_and_pd(_mm256_cmp_pd(tmin, far,  _CMP_LT_OQ), _mm256_cmp_pd(far,  tmax, _CMP_LT_OQ));
+            __m256d root    = _mm256_blendv_pd(far, near, near_ok);
+            __m256d ok      = _mm256_and_pd(has_roots, _mm256_or_pd(near_ok, far_ok));
+
+            unsigned mask = unsigned(_mm256_movemask_pd(ok)) & live;
+            if (mask) {
+                alignas(32) double roots[4];
+                _mm256_store_pd(roots, root);
+                merge_packet_lanes(roots, mask, g, i, t_max, best);
+                tmax = _mm256_loadu_pd(t_max + g);
+            }
+        }
+    }
+}
+
+// SSE packet kernel for float packets, 4 lanes per step
+__attribute__((target("sse2") RT_NO_FP_CONTRACT))
+inline void nearest_sphere_packet_sse2(const basic_sphere_arrays<float>& s, int first, int last,
+                                       const basic_ray_packet<float>& p, const float* a, uint64_t lanes,
+                                       float t_min, float* t_max, int* best)
+{
+    const __m128 zero = _mm_setzero_ps(), tmin = _mm_set1_ps(t_min);
+
+    for (int g = 0; g < p.lanes; g += 4) {
+        unsigned live = unsigned(lanes >> g) & 0xfu;
+        if (live == 0)
+            continue;
+
+        const __m128 ox = _mm_load_ps(p.ox + g), oy = _mm_load_ps(p.oy + g), oz = _mm_load_ps(p.oz + g);
+        const __m128 dx = _mm_load_ps(p.dx + g), dy = _mm_load_ps(p.dy + g), dz = _mm_load_ps(p.dz + g);
+        const __m128 va = _mm_loadu_ps(a + g);
+        __m128 tmax = _mm_loadu_ps(t_max + g);
+
+        for (int i = first; i < last; i++) {
+            __m128 ocx = _mm_sub_ps(_mm_set1_ps(s.cx[i]), ox);
+            __m128 ocy = _mm_sub_ps(_mm_set1_ps(s.cy[i]), oy);
+            __m128 ocz = _mm_sub_ps(_mm_set1_ps(s.cz[i]), oz);
+            __m128 h   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ocx), _mm_mul_ps(dy, ocy)), _mm_mul_ps(dz, ocz));
+            __m128 len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz));
+            __m128 c   = _mm_sub_ps(len, _mm_set1_ps(s.radius_sq[i]));
+            __m128 disc = _mm_sub_ps(_mm_mul_ps(h, h), _mm_mul_ps(va, c));
+
+            __m128 has_roots = _mm_cmpge_ps(disc, zero);
+            if ((unsigned(_mm_movemask_ps(has_roots)) & live) == 0)
+                continue;
+
+            __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+            __m128 near  = _mm_div_ps(_mm_sub_ps(h, sqrtd), va);
+            __m128 far   = _mm_div_ps(_mm_add_ps(h, sqrtd), va);
+            __m128 near_ok = _mm_and_ps(_mm_cmplt_ps(tmin, near), _mm_cmplt_ps(near, tmax));
+            __m128 far_ok  = _mm_and_ps(_mm_cmplt_ps(tmin, far),  _mm_cmplt_ps(far,  tmax));
+            __m128 root    = _mm_or_ps(_mm_and_ps(near_ok, near), _mm_andnot_ps(near_ok, far));
+            __m128 ok      = _mm_and_ps(has_roots, _mm_or_ps(near_ok, far_ok));
+
+            unsigned mask = unsigned(_mm_movemask_ps(ok)) & live;
+            if (mask) {
+                alignas(16) float roots[4];
+                _mm_store_ps(roots, root);
+                merge_packet_lanes(roots, mask, g, i, t_max, best);
+                tmax = _mm_loadu_ps(t_max + g);
+            }
+        }
+    }
+}
+
+// AVX2 packet kernel for float packets, 8 lanes per step
+__attribute__((target("avx2") RT_NO_FP_CONTRACT))
+inline void nearest_sphere_packet_avx2(const basic_sphere_arrays<float>& s, int first, int last,
+                                       const basic_ray_packet<float>& p, const float* a, uint64_t lanes,
+                                       float t_min, float* t_max, int* best)
+{
+    const __m256 zero = _mm256_setzero_ps(), tmin = _mm256_set1_ps(t_min);
+
+    for (int g = 0; g < p.lanes; g += 8) {
+        unsigned live = unsigned(lanes >> g) & 0xffu;
+        if (live == 0)
+            continue;
+
+        const __m256 ox = _mm256_load_ps(p.ox + g), oy = _mm256_load_ps(p.oy + g), oz = _mm256_load_ps(p.oz + g);
+        const __m256 dx = _mm256_load_ps(p.dx + g), dy = _mm256_load_ps(p.dy + g), dz = _mm256_load_ps(p.dz + g);
+        const __m256 va = _mm256_loadu_ps(a + g);
+        __m256 tmax = _mm256_loadu_ps(t_max + g);
+
+        for (int i = first; i < last; i++) {
+            __m256 ocx = _mm256_sub_ps(_mm256_set1_ps(s.cx[i]), ox);
+            __m256 ocy = _mm256_sub_ps(_mm256_set1_ps(s.cy[i]), oy);
+            __m256 ocz = _mm256_sub_ps(_mm256_set1_ps(s.cz[i]), oz);
+            __m256 h   = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ocx), _mm256_mul_ps(dy, ocy)), _mm256_mul_ps(dz, ocz));
+            __m256 len = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+            __m256 c   = _mm256_sub_ps(len, _mm256_set1_ps(s.radius_sq[i]));
+            __m256 disc = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(va, c));
+
+            __m256 has_roots = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+            if ((unsigned(_mm256_movemask_ps(has_roots)) & live) == 0)
+                continue;
+
+            __m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+            __m256 near  = _mm256_div_ps(_mm256_sub_ps(h, sqrtd), va);
+            __m256 far   = _mm256_div_ps(_mm256_add_ps(h, sqrtd), va);
+            __m256 near_ok = _mm256_and_ps(_mm256_cmp_ps(tmin, near, _CMP_LT_OQ), _mm256_cmp_ps(near, tmax, _CMP_LT_OQ));
+            __m256 far_ok  = _mm256_and_ps(_mm256_cmp_ps(tmin, far,  _CMP_LT_OQ), _mm256_cmp_ps(far,  tmax, _CMP_LT_OQ));
+            __m256 root    = _mm256_blendv_ps(far, near, near_ok);
+            __m256 ok      = _mm256_and_ps(has_roots, _mm256_or_ps(near_ok, far_ok));
+
+            unsigned mask = unsigned(_mm256_movemask_ps(ok)) & live;
+            if (mask) {
+                alignas(32) float roots[8];
+                _mm256_store_ps(roots, root);
+                merge_packet_lanes(roots, mask, g, i, t_max, best);
+                tmax = _mm256_loadu_ps(t_max + g);
+            }
+        }
+    }
+}
+
+// AVX-512 kernel, 8 spheres per step
+// NOTE: GCC reports the undefined pass-through operands of its AVX-512 intrinsics
+//       as maybe-uninitialized, silenced for this kernel only
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f") RT_NO_FP_CONTRACT))
+inline int nearest_sphere_avx512(const sphere_arrays& s, int first, int last, const ray& r, interval& ray_t) {
+    const point3& o = r.origin();
+    const vec3&   d = r.direction();
+    auto a = d.length_squared();
+
+    const __m512d ox = _mm512_set1_pd(o.x()), oy = _mm512_set1_pd(o.y()), oz = _mm512_set1_pd(o.z());
+    const __m512d dx = _mm512_set1_pd(d.x()), dy = _mm512_set1_pd(d.y()), dz = _mm512_set1_pd(d.z());
+    const __m512d va = _mm512_set1_pd(a);
+    const __m512d zero = _mm512_setzero_pd();
+
+    int best = -1;
+    int i    = first;
+    for (; i + 8 <= last; i += 8) {
+        __m512d ocx = _mm512_sub_pd(_mm512_loadu_pd(s.cx + i), ox);
+        __m512d ocy = _mm512_sub_pd(_mm512_loadu_pd(s.cy + i), oy);
+        __m512d ocz = _mm512_sub_pd(_mm512_loadu_pd(s.cz + i), oz);
+        __m512d h   = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, ocx), _mm512_mul_pd(dy, ocy)), _mm512_mul_pd(dz, ocz));
+        __m512d len = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(ocx, ocx), _mm512_mul_pd(ocy, ocy)), _mm512_mul_pd(ocz, ocz));
+        __m512d c   = _mm512_sub_pd(len, _mm512_loadu_pd(s.radius_sq + i));
+        __m512d disc = _mm512_sub_pd(_mm512_mul_pd(h, h), _mm512_mul_pd(va, c));
+
+        __mmask8 has_roots = _mm512_cmp_pd_mask(disc, zero, _CMP_GE_OQ);
+        if (has_roots == 0)
+            continue;
+
+        __m512d sqrtd = _mm512_sqrt_pd(_mm512_max_pd(disc, zero));
+        __m512d tmin  = _mm512_set1_pd(ray_t.min), tmax = _mm512_set1_pd(ray_t.max);
+        __m512d near  = _mm512_div_pd(_mm512_sub_pd(h, sqrtd), va);
+        __m512d far   = _mm512_div_pd(_mm512_add_pd(h, sqrtd), va);
+        __mmask8 near_ok = _mm512_cmp_pd_mask(tmin, near, _CMP_LT_OQ) & _mm512_cmp_pd_mask(near, tmax, _CMP_LT_OQ);
+        __mmask8 far_ok  = _mm512_cmp_pd_mask(tmin, far,  _CMP_LT_OQ) & _mm512_cmp_pd_mask(far,  tmax, _CMP_LT_OQ);
+        __m512d root     = _mm512_mask_blend_pd(near_ok, far, near);
+
+        unsigned mask = unsigned(has_roots & (near_ok | far_ok));
+        if (mask) {
+            alignas(64) double roots[8];
+            _mm512_store_pd(roots, root);
+            merge_sphere_lanes(roots, 8, mask, i, ray_t, best);
+        }
+    }
+
+    int tail = nearest_sphere_scalar(s, i, last, r, ray_t);
+    return tail >= 0 ? tail : best;
+}
+
+// AVX-512 kernel for float spheres, 16 spheres per step
+__attribute__((target("avx512f") RT_NO_FP_CONTRACT))
+inline int nearest_sphere_avx512(const basic_sphere_arrays<float>& s, int first, int last,
+                                 const basic_ray<float>& r, basic_interval<float>& ray_t)
+{
+    const basic_vec3<float>& o = r.origin();
+    const basic_vec3<float>& d = r.direction();
+    auto a = d.length_squared();
+
+    const __m512 ox = _mm512_set1_ps(o.x()), oy = _mm512_set1_ps(o.y()), oz = _mm512_set1_ps(o.z());
+    const __m512 dx = _mm512_set1_ps(d.x()), dy = _mm512_set1_ps(d.y()), dz = _mm512_set1_ps(d.z());
+    const __m512 va = _mm512_set1_ps(a);
+    const __m512 zero = _mm512_setzero_ps();
+
+    int best = -1;
+    int i    = first;
+    for (; i + 16 <= last; i += 16) {
+        __m512 ocx = _mm512_sub_ps(_mm512_loadu_ps(s.cx + i), ox);
+        __m512 ocy = _mm512_sub_ps(_mm512_loadu_ps(s.cy + i), oy);
+        __m512 ocz = _mm512_sub_ps(_mm512_loadu_ps(s.cz + i), oz);
+        __m512 h   = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, ocx), _mm512_mul_ps(dy, ocy)), _mm512_mul_ps(dz, ocz));
+        __m512 len = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ocx, ocx), _mm512_mul_ps(ocy, ocy)), _mm512_mul_ps(ocz, ocz));
+        __m512 c   = _mm512_sub_ps(len, _mm512_loadu_ps(s.radius_sq + i));
+        __m512 disc = _mm512_sub_ps(_mm512_mul_ps(h, h), _mm512_mul_ps(va, c));
+
+        __mmask16 has_roots = _mm512_cmp_ps_mask(disc, zero, _CMP_GE_OQ);
+        if (has_roots == 0)
+            continue;
+
+        __m512 sqrtd = _mm512_sqrt_ps(_mm512_max_ps(disc, zero));
+        __m512 tmin  = _mm512_set1_ps(ray_t.min), tmax = _mm512_set1_ps(ray_t.max);
+        __m512 near  = _mm512_div_ps(_mm512_sub_ps(h, sqrtd), va);
+        __m512 far   = _mm512_div_ps(_mm512_add_ps(h, sqrtd), va);
+        __mmask16 near_ok = _mm512_cmp_ps_mask(tmin, near, _CMP_LT_OQ) & _mm512_cmp_ps_mask(near, tmax, _CMP_LT_OQ);
+        __mmask16 far_ok  = _mm512_cmp_ps_mask(tmin, far,  _CMP_LT_OQ) & _mm512_cmp_ps_mask(far,  tmax, _CMP_LT_OQ);
+        __m512 root       = _mm512_mask_blend_ps(near_ok, far, near);
+
+        unsigned mask = unsigned(has_roots & (near_ok | far_ok));
+        if (mask) {
+            alignas(64) float roots[16];
+            _mm512_store_ps(roots, root);
+            merge_sphere_lanes(roots, 16, mask, i, ray_t, best);
+        }
+    }
+
+    int tail = nearest_sphere_scalar(s, i, last, r, ray_t);
+    return tail >= 0 ? tail : best;
+}
+// AVX-512 packet kernel, 8 lanes per step
+__attribute__((target("avx512f") RT_NO_FP_CONTRACT))
+inline void nearest_sphere_packet_avx512(const sphere_arrays& s, int first, int last, const ray_packet& p,
+                                         const double* a, uint64_t lanes, double t_min, double* t_max, int* best)
+{
+    const __m512d zero = _mm512_setzero_pd(), tmin = _mm512_set1_pd(t_min);
+
+    for (int g = 0; g < p.lanes; g += 8) {
+        __mmask8 live = __mmask8(lanes >> g);
+        if (live == 0)
+            continue;
+
+        const __m512d ox = _mm512_load_pd(p.ox + g), oy = _mm512_load_pd(p.oy + g), oz = _mm512_load_pd(p.oz + g);
+        const __m512d dx = _mm512_load_pd(p.dx + g), dy = _mm512_load_pd(p.dy + g), dz = _mm512_load_pd(p.dz + g);
+        const __m512d va = _mm512_loadu_pd(a + g);
+        __m512d tmax = _mm512_loadu_pd(t_max + g);
+
+        for (int i = first; i < last; i++) {
+            __m512d ocx = _mm512_sub_pd(_mm512_set1_pd(s.cx[i]), ox);
+            __m512d ocy = _mm512_sub_pd(_mm512_set1_pd(s.cy[i]), oy);
+            __m512d ocz = _mm512_sub_pd(_mm512_set1_pd(s.cz[i]), oz);
+            __m512d h   = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, ocx), _mm512_mul_pd(dy, ocy)), _mm512_mul_pd(dz, ocz));
+            __m512d len = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(ocx, ocx), _mm512_mul_pd(ocy, ocy)), _mm512_mul_pd(ocz, ocz));
+            __m512d c   = _mm512_sub_pd(len, _mm512_set1_pd(s.radius_sq[i]));
+            __m512d disc = _mm512_sub_pd(_mm512_mul_pd(h, h), _mm512_mul_pd(va, c));
+
+            __mmask8 has_roots = _mm512_cmp_pd_mask(disc, zero, _CMP_GE_OQ) & live;
+            if (has_roots == 0)
+                continue;
+
+            __m512d sqrtd = _mm512_sqrt_pd(_mm512_max_pd(disc, zero));
+            __m512d near  = _mm512_div_pd(_mm512_sub_pd(h, sqrtd), va);
+            __m512d far   = _mm512_div_pd(_mm512_add_pd(h, sqrtd), va);
+            __mmask8 near_ok = _mm512_cmp_pd_mask(tmin, near, _CMP_LT_OQ) & _mm512_cmp_pd_mask(near, tmax, _CMP_LT_OQ);
+            __mmask8 far_ok  = _mm512_cmp_pd_mask(tmin, far,  _CMP_LT_OQ) & _mm512_cmp_pd_mask(far,  tmax, _CMP_LT_OQ);
+            __m512d root     = _mm512_mask_blend_pd(near_ok, far, near);
+
+            unsigned mask = unsigned(has_roots & (near_ok | far_ok));
+            if (mask) {
+                alignas(64) double roots[8];
+                _mm512_store_pd(roots, root);
+                merge_packet_lanes(roots, mask, g, i, t_max, best);
+                tmax = _mm512_loadu_pd(t_max + g);
+            }
+        }
+    }
+}
+
+// AVX-512 packet kernel for float packets, 16 lanes per step
+__attribute__((target("avx512f") RT_NO_FP_CONTRACT))
+inline void nearest_sphere_packet_avx512(const basic_sphere_arrays<float>& s, int first, int last,
+                                         const basic_ray_packet<float>& p, const float* a, uint64_t lanes,
+                                         float t_min, float* t_max, int* best)
+{
+    const __m512 zero = _mm512_setzero_ps(), tmin = _mm512_set1_ps(t_min);
+
+    for (int g = 0; g < p.lanes; g += 16) {
+        __mmask16 live = __mmask16(lanes >> g);
+        if (live == 0)
+            continue;
+
+        const __m512 ox = _mm512_load_ps(p.ox + g), oy = _mm512_load_ps(p.oy + g), oz = _mm512_load_ps(p.oz + g);
+        const __m512 dx = _mm512_load_ps(p.dx + g), dy = _mm512_load_ps(p.dy + g), dz = _mm512_load_ps(p.dz + g);
+        const __m512 va = _mm512_loadu_ps(a + g);
+        __m512 tmax = _mm512_loadu_ps(t_max + g);
+
+        for (int i = first; i < last; i++) {
+            __m512 ocx = _mm512_sub_ps(_mm512_set1_ps(s.cx[i]), ox);
+            __m512 ocy = _mm512_sub_ps(_mm512_set1_ps(s.cy[i]), oy);
+            __m512 ocz = _mm512_sub_ps(_mm512_set1_ps(s.cz[i]), oz);
+            __m512 h   = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, ocx), _mm512_mul_ps(dy, ocy)), _mm512_mul_ps(dz, ocz));
+            __m512 len = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ocx, ocx), _mm512_mul_ps(ocy, ocy)), _mm512_mul_ps(ocz, ocz));
+            __m512 c   = _mm512_sub_ps(len, _mm512_set1_ps(s.radius_sq[i]));
+            __m512 disc = _mm512_sub_ps(_mm512_mul_ps(h, h), _mm512_mul_ps(va, c));
+
+            __mmask16 has_roots = _mm512_cmp_ps_mask(disc, zero, _CMP_GE_OQ) & live;
+            if (has_roots == 0)
+                continue;
+
+            __m512 sqrtd = _mm512_sqrt_ps(_mm512_max_ps(disc, zero));
+            __m512 near  = _mm512_div_ps(_mm512_sub_ps(h, sqrtd), va);
+            __m512 far   = _mm512_div_ps(_mm512_add_ps(h, sqrtd), va);
+            __mmask16 near_ok = _mm512_cmp_ps_mask(tmin, near, _CMP_LT_OQ) & _mm512_cmp_ps_mask(near, tmax, _CMP_LT_OQ);
+            __mmask16 far_ok  = _mm512_cmp_ps_mask(tmin, far,  _CMP_LT_OQ) & _mm512_cmp_ps_mask(far,  tmax, _CMP_LT_OQ);
+            __m512 root       = _mm512_mask_blend_ps(near_ok, far, near);
+
+            unsigned mask = unsigned(has_roots & (near_ok | far_ok));
+            if (mask) {
+                alignas(64) float roots[16];
+                _mm512_store_ps(roots, root);
+                merge_packet_lanes(roots, mask, g, i, t_max, best);
+                tmax = _mm512_loadu_ps(t_max + g);
+            }
+        }
+    }
+}
+#pragma GCC diagnostic pop
+
+#endif  // RT_SPHERE_SIMD_X86
+
+// returns the kernel for scalar type T with the given name ("scalar", "sse2", "avx2",
+// "avx512"), or nullptr if it is unknown or the CPU does not support it
+template <typename T = double>
+inline basic_sphere_kernel<T> find_sphere_kernel(const char* name) {
+    if (std::strcmp(name, "scalar") == 0)
+        return nearest_sphere_scalar<T>;
+#ifdef RT_SPHERE_SIMD_X86
+    __builtin_cpu_init();
+    if (std::strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+        return nearest_sphere_sse2;
+    if (std::strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+        return nearest_sphere_avx2;
+    if (std::strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f"))
+        return nearest_sphere_avx512;
+#endif
+    return nullptr;
+}
+
+// returns the packet kernel for scalar type T with the given name, like find_sphere_kernel
+template <typename T = double>
+inline basic_sphere_packet_kernel<T> find_sphere_packet_kernel(const char* name) {
+    if (std::strcmp(name, "scalar") == 0)
+        return nearest_sphere_packet_scalar<T>;
+#ifdef RT_SPHERE_SIMD_X86
+    __builtin_cpu_init();
+    if (std::strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+        return nearest_sphere_packet_sse2;
+    if (std::strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+        return nearest_sphere_packet_avx2;
+    if (std::strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f"))
+        return nearest_sphere_packet_avx512;
+#endif
+    return nullptr;
+}
+
+// name of the widest kernel the running CPU supports
+// NOTE: the RT_SPHERE_KERNEL environment variable forces a specific kernel
+inline const char* best_sphere_kernel_name() {
+    static const char* const names[] = {"avx512", "avx2", "sse2", "scalar"};
+
+    const char* forced = std::getenv("RT_SPHERE_KERNEL");
+    if (forced != nullptr && find_sphere_kernel(forced) != nullptr)
+        return forced;
+
+    for (const char* name : names)
+        if (find_sphere_kernel(name) != nullptr)
+            return name;
+    return "scalar";
+}
+
+// kernel for scalar type T chosen once at startup by CPU dispatch
+template <typename T = double>
+inline basic_sphere_kernel<T> dispatched_sphere_kernel() {
+    static const basic_sphere_kernel<T> kernel = find_sphere_kernel<T>(best_sphere_kernel_name());
+    return kernel;
+}
+
+// packet kernel for scalar type T of the same instruction set as dispatched_sphere_kernel
+template <typename T = double>
+inline basic_sphere_packet_kernel<T> dispatched_sphere_packet_kernel() {
+    static const basic_sphere_packet_kernel<T> kernel = find_sphere_packet_kernel<T>(best_sphere_kernel_name());
+    return kernel;
+}
+
+// spheres in structure-of-arrays form, without materials or virtual calls
+// 1. centers, squared radii and a caller defined tag (e.g. a material id) live in
+//    separate contiguous arrays
+// 2. an internal bvh_tree with wide leaves groups nearby spheres into runs,
+//    and each run is tested against the ray by the SIMD kernel in one call
+// 3. with T = float every SIMD step tests twice as many spheres as with double
+// 4. spheres that move between frames are updated by their index in add order and the
+//    hierarchy refit around them, which is far cheaper than a build, see refit
+template <typename T>
+class basic_sphere_batch {
+    public:
+        // appends a sphere; build() must be called before rendering
+        void add(const basic_vec3<T>& center, T radius, int tag) {
+            slots.push_back(size());
+            radius = std::fmax(T(0), radius);
+            cx.push_back(center.x());
+            cy.push_back(center.y());
+            cz.push_back(center.z());
+            radii.push_back(radius);
+            radius_sq.push_back(radius*radius);
+            tags.push_back(tag);
+
+            auto rvec = basic_vec3<T>(radius, radius, radius);
+            bbox = basic_aabb<T>(bbox, basic_aabb<T>(center - rvec, center + rvec));
+        }
+
+        // reserves exactly count spheres, so the arrays never hold spare capacity
+        void reserve(int count) {
+            for (auto array : {&cx, &cy, &cz, &radii, &radius_sq})
+                array->reserve(count);
+            tags.reserve(count);
+            slots.reserve(count);
+        }
+
+        // builds the hierarchy and reorders the arrays into leaf order
+        void build() {
+            std::vector<basic_aabb<T>> boxes(size());
+            for (int i = 0; i < size(); i++) {
+                auto rvec = basic_vec3<T>(radii[i], radii[i], radii[i]);
+                auto c    = basic_vec3<T>(cx[i], cy[i], cz[i]);
+                boxes[i]  = basic_aabb<T>(c - rvec, c + rvec);
+            }
+
+            tree.build(boxes, leaf_size);
+
+            reorder(cx);
+            reorder(cy);
+            reorder(cz);
+            reorder(radii);
+            reorder(radius_sq);
+            reorder(tags);
+
+            // follow every sphere to its new slot
+            std::vector<int> new_slot(size());
+            for (int slot = 0; slot < size(); slot++)
+                new_slot[tree.prim_indices[slot]] = slot;
+            for (int& slot : slots)
+                slot = new_slot[slot];
+        }
+
+        // moves sphere index (in the order the spheres were added) to center with radius;
+        // the hierarchy is stale until the next refit or build
+        void update(int index, const basic_vec3<T>& center, T radius) {
+            int slot = slots[index];
+            radius   = std::fmax(T(0), radius);
+            cx[slot] = center.x();
+            cy[slot] = center.y();
+            cz[slot] = center.z();
+            radii[slot]     = radius;
+            radius_sq[slot] = radius*radius;
+        }
+
+        // refits the hierarchy around the updated spheres without changing its topology and
+        // returns the growth of its boxes since the last build (see
+        // basic_bvh_tree::area_growth); callers build again once that has grown too far
+        double refit() {
+            tree.refit([&](int slot) {
+                auto rvec = basic_vec3<T>(radii[slot], radii[slot], radii[slot]);
+                auto c    = basic_vec3<T>(cx[slot], cy[slot], cz[slot]);
+                return basic_aabb<T>(c - rvec, c + rvec);
+            });
+            if (!tree.nodes.empty())
+                bbox = tree.bounding_box();
+            return tree.area_growth();
+        }
+
+        int size() const {return int(cx.size());}
+
+        // index of the nearest sphere hit within ray_t, or -1; on a hit ray_t.max is the
+        // distance to it
+        int nearest(const basic_ray<T>& r, basic_interval<T>& ray_t) const {
+            basic_sphere_kernel<T> kernel = dispatched_sphere_kernel<T>();
+            basic_sphere_arrays<T> s      = arrays();
+
+            int best = -1;
+            if (tree.nodes.empty()) {   // not built yet, test every sphere
+                RT_STATS_COUNT(hit_calls[primitive_packed_sphere] += size());
+                best = kernel(s, 0, size(), r, ray_t);
+            }
+            else tree.traverse_leaves(r, ray_t, [&](int first, int count, basic_interval<T>& t) {
+                RT_STATS_COUNT(hit_calls[primitive_packed_sphere] += count);
+                int i = kernel(s, first, first + count, r, t);
+                if (i < 0)
+                    return false;
+                best      = i;
+                ray_t.max = t.max;
+                return true;
+            });
+
+            if (best >= 0)
+                RT_STATS_COUNT(hits[primitive_packed_sphere]++);
+            return best;
+        }
+
+        // nearest sphere of every active lane of a packet: best[l] is its index (-1 on a
+        // miss) and t_hit[l] the distance to it; a lane finds the same sphere as nearest
+        // NOTE: best and t_hit need room for basic_ray_packet<T>::max_lanes entries
+        void nearest_packet(const basic_ray_packet<T>& packet, basic_interval<T> ray_t, int* best, T* t_hit) const {
+            basic_sphere_packet_kernel<T> kernel = dispatched_sphere_packet_kernel<T>();
+            basic_sphere_arrays<T>        s      = arrays();
+
+            alignas(64) T a[basic_ray_packet<T>::max_lanes];
+            for (int l = 0; l < basic_ray_packet<T>::max_lanes; l++) {
+                a[l]     = packet.dx[l]*packet.dx[l] + packet.dy[l]*packet.dy[l] + packet.dz[l]*packet.dz[l];
+                t_hit[l] = ray_t.max;
+                best[l]  = -1;
+            }
+
+            auto test_leaf = [&](int first, int count, uint64_t lanes) {
+                RT_STATS_COUNT(hit_calls[primitive_packed_sphere] += uint64_t(count) * lane_count(lanes));
+                kernel(s, first, first + count, packet, a, lanes, ray_t.min, t_hit, best);
+            };
+
+            if (tree.nodes.empty())     // not built yet, test every sphere
+                test_leaf(0, size(), packet.active);
+            else
+                tree.traverse_packet(packet, ray_t.min, t_hit, test_leaf);
+
+#ifdef RT_STATS
+            for (int l = 0; l < packet.lanes; l++)
+                if (best[l] >= 0)
+                    RT_STATS_COUNT(hits[primitive_packed_sphere]++);
+#endif
+        }
+
+        // same query through the scalar reference kernel over every sphere
+        int nearest_reference(const basic_ray<T>& r, basic_interval<T>& ray_t) const {
+            return nearest_sphere_scalar(arrays(), 0, size(), r, ray_t);
+        }
+
+        // fills the geometry of the hit record for sphere i hit at distance t, the same way
+        // sphere::hit does; the material is left to the caller
+        void fill_record(int i, const basic_ray<T>& r, T t, basic_hit_record<T>& rec) const {
+            auto center = basic_vec3<T>(cx[i], cy[i], cz[i]);
+
+            rec.t = t;
+            rec.p = r.at(rec.t);
+            // surface side determination
+            basic_vec3<T> outward_normal = (rec.p - center) / radii[i];
+            rec.set_face_normal(r, outward_normal);
+        }
+
+        int tag(int i) const {return tags[i];}
+
+        // bytes held by the arrays and the hierarchy: 5 scalars and two ints per sphere plus
+        // up to two nodes per sphere (64 bytes each for double, 36 for float)
+        size_t memory_bytes() const {
+            return (cx.capacity() + cy.capacity() + cz.capacity() + radii.capacity()
+                  + radius_sq.capacity()) * sizeof(T)
+                 + (tags.capacity() + slots.capacity()) * sizeof(int) + tree.memory_bytes();
+        }
+
+        basic_aabb<T> bounding_box() const {return bbox;}
+
+        basic_sphere_arrays<T> arrays() const {
+            return basic_sphere_arrays<T>{cx.data(), cy.data(), cz.data(), radius_sq.data()};
+        }
+
+    private:
+        static constexpr int leaf_size = 64 / sizeof(T);    // one AVX-512 step
+
+        std::vector<T>                      cx, cy, cz;     // centers
+        std::vector<T>                      radii;
+        std::vector<T>                      radius_sq;
+        std::vector<int>                    tags;
+        std::vector<int>                    slots;          // slot of every sphere, in add order
+        basic_bvh_tree<T>                   tree;
+        basic_aabb<T>                       bbox;
+
+        template <typename V>
+        void reorder(std::vector<V>& values) const {
+            std::vector<V> sorted(values.size());
+            for (size_t slot = 0; slot < values.size(); slot++)
+                sorted[slot] = values[tree.prim_indices[slot]];
+            values.swap(sorted);
+        }
+};
+
+using sphere_batch = basic_sphere_batch<double>;
+
+// sphere container for hittable scenes: a sphere_batch tagged with material ids
+template <typename T>
+class basic_packed_spheres : public basic_hittable<T> {
+    public:
+        basic_packed_spheres() {}
+
+        // appends a sphere; build() must be called before rendering
+        void add(const basic_vec3<T>& center, T radius, shared_ptr<basic_material<T>> mat) {
+            spheres.add(center, radius, materials.add(mat));
+        }
+
+        // builds the hierarchy and reorders the arrays into leaf order
+        void build() {spheres.build();}
+
+        // moves sphere index, counted in add order; see basic_sphere_batch::update
+        void update_sphere(int index, const basic_vec3<T>& center, T radius) {spheres.update(index, center, radius);}
+
+        // refits the hierarchy to the moved spheres, see basic_sphere_batch::refit
+        double refit() {return spheres.refit();}
+
+        void reserve(int count) {spheres.reserve(count);}
+
+        int size() const {return spheres.size();}
+
+        // bytes held by the spheres and the material table, not by the materials themselves
+        size_t memory_bytes() const {return spheres.memory_bytes() + materials.memory_bytes();}
+
+        bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+            int best = spheres.nearest(r, ray_t);
+            if (best < 0)
+                return false;
+
+            spheres.fill_record(best, r, ray_t.max, rec);
+            rec.mat = materials.get(spheres.tag(best));
+            return true;
+        }
+
+        // intersects the whole packet through the packet traversal of the sphere batch
+        uint64_t hit_packet(const basic_ray_packet<T>& packet, basic_interval<T> ray_t,
+                            basic_hit_record<T>* recs) const override
+        {
+            int best[basic_ray_packet<T>::max_lanes];
+            T   t_hit[basic_ray_packet<T>::max_lanes];
+            spheres.nearest_packet(packet, ray_t, best, t_hit);
+
+            uint64_t hits = 0;
+            for (int lane = 0; lane < packet.lanes; lane++) {
+                if (best[lane] < 0)
+                    continue;
+                spheres.fill_record(best[lane], packet.ray(lane), t_hit[lane], recs[lane]);
+                recs[lane].mat = materials.get(spheres.tag(best[lane]));
+                hits |= uint64_t(1) << lane;
+            }
+            return hits;
+        }
+
+        // same query through the scalar reference kernel, used to check the SIMD kernels
+        bool hit_reference(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const {
+            int best = spheres.nearest_reference(r, ray_t);
+            if (best < 0)
+                return false;
+
+            spheres.fill_record(best, r, ray_t.max, rec);
+            rec.mat = materials.get(spheres.tag(best));
+            return true;
+        }
+
+        basic_aabb<T> bounding_box() const override {return spheres.bounding_box();}
+
+        basic_sphere_arrays<T> arrays() const {return spheres.arrays();}
+
+    private:
+        basic_sphere_batch<T>   spheres;
+        basic_material_table<T> materials;  // distinct materials of the spheres, indexed by tag
+};
+
+using packed_spheres = basic_packed_spheres<double>;
+
+#endif  // end of packed_spheres header file
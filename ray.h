@@ -4,26 +4,30 @@
 // Import libraries
 #include "vec3.h"
 
-class ray {
+// ray is the double instantiation, basic_ray<float> the single precision one
+template <typename T>
+class basic_ray {
     public:
         // constructors
-        ray() {}
+        basic_ray() {}
 
-        ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {}
+        basic_ray(const basic_vec3<T>& origin, const basic_vec3<T>& direction) : orig(origin), dir(direction) {}
 
         // accessor methods for returning origin and direction values
-        const point3& origin() const {return orig;}
-        const vec3& direction() const {return dir;}
+        const basic_vec3<T>& origin() const {return orig;}
+        const basic_vec3<T>& direction() const {return dir;}
 
         // returns the value of a point along a ray
-        point3 at(double t) const {
+        basic_vec3<T> at(T t) const {
             return orig + t*dir;
         }
 
     private:
-        point3  orig;
-        vec3    dir;
+        basic_vec3<T>   orig;
+        basic_vec3<T>   dir;
 
 };
 
-#endif  // end of header file
\ No newline at end of file
+using ray = basic_ray<double>;
+
+#endif  // end of header file
@@ -0,0 +1,52 @@
+#ifndef RAY_PACKET_H    // start of ray_packet header file
+#define RAY_PACKET_H    // ray_packet class definition
+
+// Import libraries
+#include "rtweekend.h"
+
+#include <cstdint>
+
+// bundle of up to 64 coherent rays in structure-of-arrays form, e.g. the primary rays of
+// an 8x8 pixel block, traced together so every box and sphere is loaded once per packet
+// instead of once per ray
+// NOTE: lanes is 4, 16 or 64 (2x2, 4x4 or 8x8 pixel blocks); the packet traversal code is
+//       instantiated for those sizes so its per-lane loops have fixed trip counts
+template <typename T>
+class basic_ray_packet {
+    public:
+        static constexpr int max_lanes = 64;
+
+        int         lanes   = 0;    // lanes in use
+        uint64_t    active  = 0;    // bit l is set if lane l carries a ray
+
+        // origins and directions per lane; unused lanes stay zero
+        alignas(64) T ox[max_lanes] = {}, oy[max_lanes] = {}, oz[max_lanes] = {};
+        alignas(64) T dx[max_lanes] = {}, dy[max_lanes] = {}, dz[max_lanes] = {};
+
+        bool is_active(int lane) const {return (active >> lane) & 1u;}
+
+        // stores r in lane and marks the lane active
+        void set(int lane, const basic_ray<T>& r) {
+            ox[lane] = r.origin().x();    oy[lane] = r.origin().y();    oz[lane] = r.origin().z();
+            dx[lane] = r.direction().x(); dy[lane] = r.direction().y(); dz[lane] = r.direction().z();
+            active |= uint64_t(1) << lane;
+        }
+
+        // the ray of one lane
+        basic_ray<T> ray(int lane) const {
+            return basic_ray<T>(basic_vec3<T>(ox[lane], oy[lane], oz[lane]),
+                                basic_vec3<T>(dx[lane], dy[lane], dz[lane]));
+        }
+};
+
+using ray_packet = basic_ray_packet<double>;
+
+// number of lanes set in a lane mask
+inline int lane_count(uint64_t lanes) {
+    int count = 0;
+    for (; lanes != 0; lanes &= lanes - 1)
+        count++;
+    return count;
+}
+
+#endif  // end of ray_packet header file
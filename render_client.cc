@@ -0,0 +1,90 @@
+/*  Render client
+*   Sends requests to a running render server (see render_server.cc) and prints the replies;
+*   the image of a render request is written to the --output file, or to standard output.
+*
+*   usage: render_client.exe [--socket PATH] [--output FILE] REQUEST [; REQUEST...]
+*   e.g.   render_client.exe load demo scene.rtsb
+*          render_client.exe --output turn.ppm render demo lookfrom 13 2 3 samples 64
+*   NOTE: requests separated by ";" share one connection; with several renders the images
+*         are written to the output one after another
+*/
+
+// Import libraries
+#include "unix_socket.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef RT_HAVE_UNIX_SOCKETS
+
+int main(int argc, char* argv[]) {
+    std::string socket_path = "/tmp/raytracer.sock";
+    std::string output_path;
+    std::vector<std::string> requests(1);
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--socket") == 0 && arg + 1 < argc)
+            socket_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--output") == 0 && arg + 1 < argc)
+            output_path = argv[++arg];
+        else if (std::strcmp(argv[arg], ";") == 0)
+            requests.emplace_back();
+        else
+            requests.back() += (requests.back().empty() ? "" : " ") + std::string(argv[arg]);
+    }
+
+    auto server = socket_connection::connect(socket_path);
+    if (!server) {
+        std::cerr << "No render server on " << socket_path << '\n';
+        return 1;
+    }
+
+    std::ofstream output_file;
+    if (!output_path.empty())
+        output_file.open(output_path, std::ios::binary | std::ios::trunc);
+    std::ostream& output = output_path.empty() ? std::cout : output_file;
+
+    int status = 0;
+    for (const auto& request : requests) {
+        std::string reply;
+        if (request.empty())
+            continue;
+        if (!server->write_line(request) || !server->read_line(reply)) {
+            std::cerr << "Connection to the render server lost\n";
+            return 1;
+        }
+        std::clog << reply << '\n';
+
+        // an image follows the reply of a render request
+        std::istringstream fields(reply);
+        std::string result, command;
+        size_t bytes = 0;
+        fields >> result;
+        std::istringstream(request) >> command;
+        if (result != "ok") {
+            status = 1;
+            continue;
+        }
+        if (command == "render" && fields >> bytes) {
+            std::vector<unsigned char> image;
+            if (!server->read_bytes(bytes, image)) {
+                std::cerr << "Connection to the render server lost\n";
+                return 1;
+            }
+            output.write(reinterpret_cast<const char*>(image.data()), std::streamsize(image.size()));
+        }
+    }
+    return status;
+}
+
+#else
+
+int main() {
+    std::cerr << "The render client needs Unix domain sockets\n";
+    return 1;
+}
+
+#endif  // RT_HAVE_UNIX_SOCKETS
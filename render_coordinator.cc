@@ -0,0 +1,169 @@
+/*  Coordinator for distributed renders on one machine
+*   Splits one render into parts, runs every part as its own renderer process (main.exe),
+*   waits for them and merges their partial accumulation buffers into the final image,
+*   the same way the parts of a render farm job are merged with merge_partials.
+*   1. --split tiles (default): process k of N renders every Nth tile starting at tile k;
+*      the image is bit-identical to a single render with the same seed
+*   2. --split samples: process k renders its share of the --samples samples of every
+*      pixel; the image matches a single render up to rounding
+*
+*   usage: render_coordinator.exe [--workers N] [--split tiles|samples] [--samples N]
+*                                 [--renderer PATH] [--work-dir DIR] [--keep]
+*                                 [--format p3|p6|pfm|qoi] [--output FILE] [-- RENDERER ARGS...]
+*   NOTE: the renderer arguments come after the coordinator's own --threads, so they can
+*         override it; each process gets an equal share of the hardware threads by default
+*   NOTE: needs POSIX processes (Linux, macOS)
+*/
+
+// Import libraries
+#include "rtweekend.h"
+
+#include "accumulation_buffer.h"
+#include "image_encoder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+// starts the renderer with args; 0 if it cannot be started
+static pid_t start_process(const std::vector<std::string>& args) {
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        return 0;
+    return pid;
+}
+
+int main(int argc, char* argv[]) {
+    int         workers  = 4;
+    int         samples  = 0;
+    std::string split    = "tiles";
+    std::string renderer = "./main.exe";
+    std::string work_dir = ".";
+    std::string format   = "p3";
+    std::string output_path;
+    bool        keep     = false;
+    std::vector<std::string> renderer_args;
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--") == 0) {
+            renderer_args.assign(argv + arg + 1, argv + argc);
+            break;
+        }
+        else if (std::strcmp(argv[arg], "--workers") == 0 && arg + 1 < argc)
+            workers = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--split") == 0 && arg + 1 < argc)
+            split = argv[++arg];
+        else if (std::strcmp(argv[arg], "--samples") == 0 && arg + 1 < argc)
+            samples = std::atoi(argv[++arg]);
+        else if (std::strcmp(argv[arg], "--renderer") == 0 && arg + 1 < argc)
+            renderer = argv[++arg];
+        else if (std::strcmp(argv[arg], "--work-dir") == 0 && arg + 1 < argc)
+            work_dir = argv[++arg];
+        else if (std::strcmp(argv[arg], "--format") == 0 && arg + 1 < argc)
+            format = argv[++arg];
+        else if (std::strcmp(argv[arg], "--output") == 0 && arg + 1 < argc)
+            output_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--keep") == 0)
+            keep = true;
+    }
+
+    auto encoder = make_image_encoder(format);
+    if (workers < 1 || !encoder || (split != "tiles" && split != "samples") || (split == "samples" && samples < 1)) {
+        std::cerr << "usage: render_coordinator [--workers N] [--split tiles|samples] [--samples N] "
+                     "[--renderer PATH] [--work-dir DIR] [--keep] [--format p3|p6|pfm|qoi] [--output FILE] "
+                     "[-- RENDERER ARGS...]\n";
+        return 1;
+    }
+
+    int hardware_threads = int(std::thread::hardware_concurrency());
+    int threads_each     = std::max(1, hardware_threads / workers);
+    auto start = std::chrono::steady_clock::now();
+
+    // 1. start every part
+    std::vector<std::string> partials;
+    std::vector<pid_t>       pids;
+    for (int k = 0; k < workers; k++) {
+        partials.push_back(work_dir + "/part_" + std::to_string(k) + ".rtck");
+
+        std::vector<std::string> args = {renderer, "--threads", std::to_string(threads_each)};
+        args.insert(args.end(), renderer_args.begin(), renderer_args.end());
+        args.insert(args.end(), {"--partial", partials.back()});
+        if (split == "tiles")
+            args.insert(args.end(), {"--tiles", std::to_string(k), std::to_string(workers)});
+        else
+            args.insert(args.end(), {"--sample-range", std::to_string(samples * k / workers),
+                                     std::to_string(samples * (k + 1) / workers),
+                                     "--sample-total", std::to_string(samples)});
+
+        pid_t pid = start_process(args);
+        if (pid == 0) {
+            std::cerr << "Cannot start " << renderer << '\n';
+            return 1;
+        }
+        pids.push_back(pid);
+    }
+
+    // 2. wait for all of them
+    bool failed = false;
+    for (int k = 0; k < workers; k++) {
+        int status;
+        if (waitpid(pids[k], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Part " << k << " failed\n";
+            failed = true;
+        }
+    }
+    if (failed)
+        return 1;
+
+    // 3. merge the partial buffers
+    accumulation_buffer merged;
+    uint64_t seed;
+    std::string error;
+    if (!merge_partial_files(partials, merged, seed, error)) {
+        std::cerr << "Cannot merge: " << error << '\n';
+        return 1;
+    }
+    if (!keep)
+        for (const auto& path : partials)
+            std::remove(path.c_str());
+
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    std::clog << "Rendered " << workers << " parts in " << took.count() << " s\n";
+
+    framebuffer image = merged.resolve();
+    if (!output_path.empty()) {
+        if (!write_image_file(image, output_path)) {
+            std::cerr << "Could not write " << output_path << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (encoder->binary())
+        set_stdout_binary();
+    encoder->write(image, std::cout);
+    std::cout.flush();
+}
+
+#else
+
+int main() {
+    std::cerr << "The render coordinator needs POSIX processes\n";
+    return 1;
+}
+
+#endif
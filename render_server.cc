@@ -0,0 +1,367 @@
+/*  Render server
+*   Long-running process that keeps scenes and their built worlds resident and renders
+*   them on request, so repeated renders of one scene (turntables, previews) pay neither
+*   the process start nor the scene load and build again.
+*
+*   Clients connect to a Unix domain socket and send one request per line; every request
+*   gets one reply line, "ok ..." or "error MESSAGE":
+*       load NAME FILE          reads a scene file (see scene_file.h) and builds its world
+*                               -> ok SPHERES BUILD_MS
+*       render NAME [FIELD VALUE...]
+*                               renders the scene with its camera, overriding the given
+*                               fields: lookfrom X Y Z, lookat X Y Z, vup X Y Z, vfov DEGREES,
+*                               samples N, width N, max_depth N, seed N, defocus_angle DEGREES,
+*                               focus_dist D, format p3|p6|pfm|qoi (default p6)
+*                               -> ok BYTES WIDTH HEIGHT RENDER_MS, then BYTES bytes of image
+*       unload NAME             frees the scene once no queued render uses it -> ok
+*       scenes                  -> ok NAME...
+*       shutdown                stops the server once the queued renders are done -> ok
+*   Renders from all clients are queued and run one at a time on a single thread pool
+*   that lives as long as the server.
+*
+*   usage: render_server.exe [--socket PATH] [--threads N]
+*   NOTE: needs Unix domain sockets (Linux, macOS); see render_client.cc for a client
+*/
+
+// Import libraries
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "closed_world.h"
+#include "image_encoder.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "thread_pool.h"
+#include "unix_socket.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef RT_HAVE_UNIX_SOCKETS
+
+// a loaded scene with its camera and built world, shared by the renders that use it
+struct resident_scene {
+    scene_description   scene;
+    camera_settings     settings;   // camera of the scene file, the base of every render
+    closed_world        world;
+};
+
+// finished render of one job: the encoded image or an error message
+struct render_result {
+    bool                        ok = false;
+    std::string                 error;
+    std::vector<unsigned char>  image;
+    int                         width = 0, height = 0;
+    double                      milliseconds = 0;
+};
+
+// render waiting in the queue
+struct render_job {
+    shared_ptr<const resident_scene>    scene;
+    camera                              cam;
+    std::string                         format;
+    std::promise<render_result>         result;
+};
+
+class render_server {
+    public:
+        explicit render_server(int thread_count) : pool(thread_count) {}
+
+        // accepts clients on listen_fd until a shutdown request, then finishes the queued
+        // renders and returns
+        void run(int listen_fd) {
+            this->listen_fd = listen_fd;
+            std::thread renderer([this] { render_loop(); });
+
+            while (true) {
+                int fd = ::accept(listen_fd, nullptr, nullptr);
+                if (fd < 0) {
+                    if (stopping())
+                        break;
+                    continue;   // interrupted, or a client gave up before being accepted
+                }
+
+                std::lock_guard<std::mutex> lock(clients_mutex);
+                reap_clients();
+                clients.push_back(client_thread{std::thread(), fd});
+                client_thread* client = &clients.back();
+                client->thread = std::thread([this, client] { serve(*client); });
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                queue_closed = true;
+            }
+            queue_ready.notify_all();
+            renderer.join();
+
+            // wake clients idling in a read, so their threads end
+            {
+                std::lock_guard<std::mutex> lock(clients_mutex);
+                for (auto& client : clients)
+                    if (!client.done)
+                        ::shutdown(client.fd, SHUT_RDWR);
+            }
+            for (auto& client : clients)
+                client.thread.join();
+        }
+
+    private:
+        thread_pool     pool;           // workers shared by every render
+        int             listen_fd = -1;
+
+        std::mutex                                              scenes_mutex;
+        std::map<std::string, shared_ptr<const resident_scene>> scenes;
+
+        std::mutex                  queue_mutex;
+        std::condition_variable     queue_ready;
+        std::deque<render_job*>     queue;          // jobs owned by the waiting client threads
+        bool                        queue_closed    = false;
+        bool                        shutdown_asked  = false;
+
+        // connection served by its own thread
+        struct client_thread {
+            std::thread thread;
+            int         fd;                 // closed by the thread itself
+            bool        done = false;       // serve returned, the thread only awaits its join
+        };
+
+        std::mutex                  clients_mutex;
+        std::list<client_thread>    clients;        // connections not joined yet
+
+        // joins the threads of connections that ended, so a long-running server holds
+        // only its live clients; called with clients_mutex held
+        void reap_clients() {
+            for (auto it = clients.begin(); it != clients.end(); ) {
+                if (it->done) {
+                    it->thread.join();
+                    it = clients.erase(it);
+                }
+                else
+                    ++it;
+            }
+        }
+
+        bool stopping() {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            return shutdown_asked;
+        }
+
+        // runs the queued renders one after another on the shared pool
+        void render_loop() {
+            while (true) {
+                render_job* job;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    queue_ready.wait(lock, [this] {return queue_closed || !queue.empty();});
+                    if (queue.empty())
+                        return;
+                    job = queue.front();
+                    queue.pop_front();
+                }
+
+                // a failed render (e.g. out of memory for a huge image) fails only its job
+                render_result result;
+                try {
+                    auto start = std::chrono::steady_clock::now();
+                    framebuffer image = job->cam.render_image(job->scene->world, pool);
+                    std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+
+                    std::ostringstream out;
+                    make_image_encoder(job->format)->write(image, out);
+                    auto bytes = out.str();
+
+                    result.ok           = true;
+                    result.image.assign(bytes.begin(), bytes.end());
+                    result.width        = image.width();
+                    result.height       = image.height();
+                    result.milliseconds = took.count();
+                }
+                catch (const std::exception& e) {
+                    result.error = e.what();
+                }
+                job->result.set_value(std::move(result));
+            }
+        }
+
+        // answers the requests of one client until it disconnects
+        void serve(client_thread& self) {
+            socket_connection client(self.fd);
+            std::string line;
+            while (client.read_line(line)) {
+                std::istringstream request(line);
+                std::string command;
+                request >> command;
+
+                bool replied;
+                if (command == "load")          replied = handle_load(request, client);
+                else if (command == "render")   replied = handle_render(request, client);
+                else if (command == "unload")   replied = handle_unload(request, client);
+                else if (command == "scenes")   replied = handle_scenes(client);
+                else if (command == "shutdown") replied = handle_shutdown(client);
+                else if (command.empty())       replied = true;
+                else                            replied = client.write_line("error unknown request '" + command + "'");
+                if (!replied)
+                    break;
+            }
+
+            // mark the connection ended before it closes the descriptor and the number is reused
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            self.done = true;
+        }
+
+        bool handle_load(std::istringstream& request, socket_connection& client) {
+            std::string name, path, error;
+            if (!(request >> name >> path))
+                return client.write_line("error usage: load NAME FILE");
+
+            auto start    = std::chrono::steady_clock::now();
+            auto resident = make_shared<resident_scene>();
+            if (!scene_file::load(path, resident->scene, resident->settings, error))
+                return client.write_line("error " + error);
+            resident->world = resident->scene.build_closed();
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+
+            auto spheres = resident->scene.spheres.size();
+            {
+                std::lock_guard<std::mutex> lock(scenes_mutex);
+                scenes[name] = resident;
+            }
+            std::clog << "Loaded " << name << ": " << spheres << " spheres in " << took.count() << " ms\n";
+            return client.write_line("ok " + std::to_string(spheres) + ' ' + std::to_string(took.count()));
+        }
+
+        bool handle_render(std::istringstream& request, socket_connection& client) {
+            std::string name;
+            request >> name;
+
+            render_job job;
+            {
+                std::lock_guard<std::mutex> lock(scenes_mutex);
+                auto found = scenes.find(name);
+                if (found == scenes.end())
+                    return client.write_line("error no scene named '" + name + "'");
+                job.scene = found->second;
+            }
+            job.cam    = camera(job.scene->settings);
+            job.format = "p6";
+
+            std::string field;
+            while (request >> field) {
+                if (!read_override(request, field, job))
+                    return client.write_line("error bad value for '" + field + "'");
+            }
+            if (!make_image_encoder(job.format))
+                return client.write_line("error unknown format '" + job.format + "'");
+
+            auto result = job.result.get_future();
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                if (shutdown_asked)
+                    return client.write_line("error server is shutting down");
+                queue.push_back(&job);
+            }
+            queue_ready.notify_one();
+
+            auto done = result.get();
+            if (!done.ok)
+                return client.write_line("error " + done.error);
+            return client.write_line("ok " + std::to_string(done.image.size()) + ' ' + std::to_string(done.width)
+                                     + ' ' + std::to_string(done.height) + ' ' + std::to_string(done.milliseconds))
+                && client.write(done.image.data(), done.image.size());
+        }
+
+        // applies one camera override of a render request; false for an unknown field, a
+        // missing value or one no render can use (no samples, a negative depth, a field of
+        // view outside (0, 180) degrees)
+        static bool read_override(std::istringstream& request, const std::string& field, render_job& job) {
+            auto& cam = job.cam;
+            double x, y, z;
+            if (field == "lookfrom" || field == "lookat" || field == "vup") {
+                if (!(request >> x >> y >> z))
+                    return false;
+                (field == "lookfrom" ? cam.lookfrom : field == "lookat" ? cam.lookat : cam.vup) = vec3(x, y, z);
+                return true;
+            }
+            if (field == "vfov")            return bool(request >> cam.vfov) && cam.vfov > 0 && cam.vfov < 180;
+            if (field == "samples")         return bool(request >> cam.samples_per_pixel) && cam.samples_per_pixel > 0;
+            if (field == "width")           return bool(request >> cam.image_width) && cam.image_width > 0;
+            if (field == "max_depth")       return bool(request >> cam.max_depth) && cam.max_depth >= 0;
+            if (field == "seed")            return bool(request >> cam.seed);
+            if (field == "defocus_angle")   return bool(request >> cam.defocus_angle);
+            if (field == "focus_dist")      return bool(request >> cam.focus_dist);
+            if (field == "format")          return bool(request >> job.format);
+            return false;
+        }
+
+        bool handle_unload(std::istringstream& request, socket_connection& client) {
+            std::string name;
+            request >> name;
+            std::lock_guard<std::mutex> lock(scenes_mutex);
+            if (scenes.erase(name) == 0)
+                return client.write_line("error no scene named '" + name + "'");
+            return client.write_line("ok");
+        }
+
+        bool handle_scenes(socket_connection& client) {
+            std::string reply = "ok";
+            std::lock_guard<std::mutex> lock(scenes_mutex);
+            for (const auto& entry : scenes)
+                reply += ' ' + entry.first;
+            return client.write_line(reply);
+        }
+
+        // replies first, since stopping the accept loop also ends every client connection
+        bool handle_shutdown(socket_connection& client) {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                shutdown_asked = true;
+            }
+            bool replied = client.write_line("ok");
+            ::shutdown(listen_fd, SHUT_RDWR);   // wakes the accept loop
+            return replied;
+        }
+};
+
+int main(int argc, char* argv[]) {
+    std::string socket_path  = "/tmp/raytracer.sock";
+    int         thread_count = 0;
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--socket") == 0 && arg + 1 < argc)
+            socket_path = argv[++arg];
+        else if (std::strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc)
+            thread_count = std::atoi(argv[++arg]);
+    }
+
+    int listen_fd = listen_unix_socket(socket_path);
+    if (listen_fd < 0) {
+        std::cerr << "Cannot listen on " << socket_path << '\n';
+        return 1;
+    }
+
+    render_server server(thread_count);
+    std::clog << "Listening on " << socket_path << '\n';
+    server.run(listen_fd);
+
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+}
+
+#else
+
+int main() {
+    std::cerr << "The render server needs Unix domain sockets\n";
+    return 1;
+}
+
+#endif  // RT_HAVE_UNIX_SOCKETS
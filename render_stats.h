@@ -0,0 +1,145 @@
+#ifndef RENDER_STATS_H  // start of render_stats header file
+#define RENDER_STATS_H  // render_stats class definition
+
+// Import libraries
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Render statistics
+// 1. Counters are only compiled in when RT_STATS is defined (g++ -DRT_STATS ...);
+//    otherwise the RT_STATS_COUNT hooks expand to nothing and cost nothing
+// 2. Every worker thread counts into its own render_stats, selected with
+//    set_active_stats; each one starts on its own 64 byte cache line, so neighbours in a
+//    std::vector<render_stats> never share a line and the hot paths never contend
+// 3. The camera merges the per-worker counters at the end and writes them as JSON
+
+// primitive types with their own intersection counters
+enum primitive_kind {
+    primitive_sphere,           // sphere
+    primitive_packed_sphere,    // sphere tested by the packed_spheres kernels
+    primitive_instance,         // instance, whose object's own tests are counted as well
+    primitive_triangle,         // triangle of a triangle_mesh
+    primitive_kind_count
+};
+
+// material types with their own scatter counters
+enum material_kind {
+    material_lambertian,
+    material_metal,
+    material_dialectric,
+    material_kind_count
+};
+
+// wall time spent on one tile of one pass
+struct tile_timing {
+    int     pass;
+    int     x, y;           // upper left pixel
+    int     width, height;
+    double  seconds;
+};
+
+class alignas(64) render_stats {
+    public:
+        uint64_t    primary_rays    = 0;    // camera rays
+        uint64_t    secondary_rays  = 0;    // scattered rays
+        uint64_t    bvh_nodes       = 0;    // bounding volume hierarchy nodes visited
+
+        uint64_t    hit_calls[primitive_kind_count] = {};   // ray/primitive tests
+        uint64_t    hits[primitive_kind_count]      = {};   // tests that found an intersection
+
+        uint64_t    scatter_calls[material_kind_count] = {};    // scatter invocations
+        uint64_t    scattered[material_kind_count]     = {};    // invocations that produced a ray
+
+        std::vector<uint64_t>       bounce_histogram;   // paths by number of scattering events
+        std::vector<tile_timing>    tiles;              // per-tile wall times
+
+        // counts one finished path with the given number of bounces
+        void add_path(int bounces) {
+            if (int(bounce_histogram.size()) <= bounces)
+                bounce_histogram.resize(bounces + 1, 0);
+            bounce_histogram[bounces]++;
+        }
+
+        // adds the counters of another thread
+        void merge(const render_stats& other) {
+            primary_rays   += other.primary_rays;
+            secondary_rays += other.secondary_rays;
+            bvh_nodes      += other.bvh_nodes;
+            for (int k = 0; k < primitive_kind_count; k++) {
+                hit_calls[k] += other.hit_calls[k];
+                hits[k]      += other.hits[k];
+            }
+            for (int k = 0; k < material_kind_count; k++) {
+                scatter_calls[k] += other.scatter_calls[k];
+                scattered[k]     += other.scattered[k];
+            }
+            if (bounce_histogram.size() < other.bounce_histogram.size())
+                bounce_histogram.resize(other.bounce_histogram.size(), 0);
+            for (size_t b = 0; b < other.bounce_histogram.size(); b++)
+                bounce_histogram[b] += other.bounce_histogram[b];
+            tiles.insert(tiles.end(), other.tiles.begin(), other.tiles.end());
+        }
+
+        // writes all counters as one JSON object
+        void write_json(std::ostream& out, double render_seconds) const {
+            static const char* const primitive_names[] = {"sphere", "packed_sphere", "instance", "triangle"};
+            static const char* const material_names[]  = {"lambertian", "metal", "dialectric"};
+
+            out << "{\n";
+            out << "  \"render_seconds\": " << render_seconds << ",\n";
+            out << "  \"primary_rays\": " << primary_rays << ",\n";
+            out << "  \"secondary_rays\": " << secondary_rays << ",\n";
+            out << "  \"bvh_nodes_visited\": " << bvh_nodes << ",\n";
+
+            out << "  \"primitives\": {";
+            for (int k = 0; k < primitive_kind_count; k++)
+                out << (k ? ", " : "") << "\"" << primitive_names[k] << "\": {\"hit_calls\": "
+                    << hit_calls[k] << ", \"hits\": " << hits[k] << "}";
+            out << "},\n";
+
+            out << "  \"materials\": {";
+            for (int k = 0; k < material_kind_count; k++)
+                out << (k ? ", " : "") << "\"" << material_names[k] << "\": {\"scatter_calls\": "
+                    << scatter_calls[k] << ", \"scattered\": " << scattered[k] << "}";
+            out << "},\n";
+
+            out << "  \"bounce_histogram\": [";
+            for (size_t b = 0; b < bounce_histogram.size(); b++)
+                out << (b ? ", " : "") << bounce_histogram[b];
+            out << "],\n";
+
+            out << "  \"tiles\": [";
+            for (size_t t = 0; t < tiles.size(); t++) {
+                const auto& tile = tiles[t];
+                out << (t ? ",\n    " : "\n    ") << "{\"pass\": " << tile.pass << ", \"x\": " << tile.x
+                    << ", \"y\": " << tile.y << ", \"width\": " << tile.width << ", \"height\": "
+                    << tile.height << ", \"seconds\": " << tile.seconds << "}";
+            }
+            out << (tiles.empty() ? "]\n" : "\n  ]\n");
+            out << "}\n";
+        }
+};
+
+// counters the calling thread currently adds to (nullptr: not counting)
+inline render_stats*& active_stats() {
+    thread_local render_stats* stats = nullptr;
+    return stats;
+}
+
+inline void set_active_stats(render_stats* stats) {
+    active_stats() = stats;
+}
+
+#ifdef RT_STATS
+// applies a counter update, e.g. RT_STATS_COUNT(primary_rays++), to the active counters
+#define RT_STATS_COUNT(update)                                      \
+    do {                                                            \
+        if (render_stats* rt_stats_ = active_stats())               \
+            rt_stats_->update;                                      \
+    } while (0)
+#else
+#define RT_STATS_COUNT(update) do {} while (0)
+#endif
+
+#endif  // end of render_stats header file
@@ -0,0 +1,101 @@
+#ifndef RNG_H   // start of rng header file
+#define RNG_H   // rng class definition
+
+// Import libraries
+#include <cstdint>
+
+// source of correlated sample dimensions (stratified, low discrepancy, ...), see sampler.h
+// NOTE: a pixel sample draws its dimensions as 2D pairs: the pixel offset first, then the
+//       lens position, then one pair for each bounce
+class pixel_sampler {
+    public:
+        virtual ~pixel_sampler() = default;
+
+        // point in [0,1)^2 of the dimension-th pair of dimensions of one pixel sample
+        virtual void sample_2d(uint64_t pixel, uint64_t sample, uint32_t dimension, double& u, double& v) const = 0;
+};
+
+// small, fast random number generator (PCG32, O'Neill 2014)
+// 1. 64 bits of state, 32 bits of output per step, no hidden global state
+// 2. each thread, pixel or sample owns its own generator, so it is safe to use
+//    from many threads without locking
+// 3. for_sample derives the generator of one pixel sample from (seed, pixel, sample),
+//    so a sample draws the same numbers no matter which thread, pass or process runs it
+// 4. a generator with a pixel_sampler hands out that sampler's dimensions from next_2d,
+//    which the camera and the random vector helpers use; random_double stays independent
+class rng {
+    public:
+        rng() : rng(0) {}
+
+        rng(uint64_t seed, uint64_t stream = 0) {
+            inc   = (stream << 1u) | 1u;    // stream selector must be odd
+            state = 0;
+            next_uint();
+            state += seed;
+            next_uint();
+        }
+
+        // returns the generator for one sample of one pixel
+        static rng for_sample(uint64_t seed, uint64_t pixel, uint64_t sample) {
+            return rng(mix(mix(seed) ^ pixel) ^ (sample * 0x9e3779b97f4a7c15ull));
+        }
+
+        // returns 32 uniformly distributed random bits
+        uint32_t next_uint() {
+            uint64_t old = state;
+            state = old * 6364136223846793005ull + inc;
+            uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+            uint32_t rot        = uint32_t(old >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+        }
+
+        // returns a random real in [0,1)
+        double random_double() {
+            return next_uint() * (1.0 / 4294967296.0);
+        }
+
+        // returns a random real in [min, max)
+        double random_double(double min, double max) {
+            return min + (max-min) * random_double();
+        }
+
+        // draws the dimensions of sample of pixel from sampler from now on
+        void use_sampler(const pixel_sampler* sampler, uint64_t pixel, uint64_t sample) {
+            this->sampler = sampler;
+            this->pixel   = pixel;
+            this->sample  = sample;
+            dimension     = 0;
+        }
+
+        bool has_sampler() const {return sampler != nullptr;}
+
+        // returns the next pair of sample dimensions in [0,1)^2, from the sampler if there
+        // is one and two independent random reals otherwise
+        void next_2d(double& u, double& v) {
+            if (sampler != nullptr) {
+                sampler->sample_2d(pixel, sample, dimension++, u, v);
+                return;
+            }
+            u = random_double();
+            v = random_double();
+        }
+
+        // splitmix64 finalizer, spreads nearby inputs over the whole 64 bit range
+        static uint64_t mix(uint64_t x) {
+            x += 0x9e3779b97f4a7c15ull;
+            x  = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x  = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+
+    private:
+        uint64_t state;
+        uint64_t inc;
+
+        const pixel_sampler*    sampler   = nullptr;
+        uint64_t                pixel     = 0;
+        uint64_t                sample    = 0;
+        uint32_t                dimension = 0;      // next pair of dimensions of the sample
+};
+
+#endif  // end of rng header file
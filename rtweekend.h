@@ -8,6 +8,8 @@
 #include <limits>
 #include <memory>
 
+#include "rng.h"
+
 // C++ Std Usings
 using std::fabs;        // absolute value
 using std::make_shared;
@@ -25,9 +27,17 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+// generator behind the global random_double() helpers
+// NOTE: shared and unsynchronized, only meant for single-threaded scene setup;
+//       rendering code passes its own rng explicitly
+inline rng& global_rng() {
+    static rng generator;
+    return generator;
+}
+
 inline double random_double() {
     // Returns a random real in [0,1)
-    return rand() / (RAND_MAX + 1.0);
+    return global_rng().random_double();
 }
 
 inline double random_double(double min, double max) {
@@ -0,0 +1,260 @@
+#ifndef SAMPLER_H   // start of sampler header file
+#define SAMPLER_H   // pixel sampler definitions
+
+// Import libraries
+#include "rtweekend.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Samplers hand every pixel sample correlated values for its dimensions (pixel offset,
+// lens position, one 2D pair per bounce) in place of independent random numbers, so the
+// samples of a pixel cover each 2D projection evenly and the error falls faster than
+// 1/sqrt(N) where the integrand is smooth
+// 1. each value is a pure function of (seed, pixel, sample, dimension), like the rng of
+//    a sample, so images stay identical for every thread count, pass split and process
+//    (the stratified sampler also needs the sample count of the whole render)
+// 2. the dimensions of one sample are decorrelated by hashing the dimension into the
+//    scrambles, so each 2D pair is well distributed on its own ("padding")
+// NOTE: one dimensional decisions (dielectric reflection, Russian roulette) still draw
+//       from the independent generator
+
+// jittered strata, shuffled per pixel and dimension: correlated multi-jittered sampling
+// (Kensler 2013), which stratifies the 2D square and both 1D projections at once
+// NOTE: the strata are laid out for the samples per pixel of the whole render, not of one
+//       sample range of it (see camera_settings::sampler_samples); further samples start
+//       a new, independently shuffled pattern of the same size
+class stratified_sampler : public pixel_sampler {
+    public:
+        stratified_sampler(int samples_per_pixel, uint64_t seed) : seed(seed) {
+            columns = std::max(1, int(std::sqrt(double(std::max(samples_per_pixel, 1)))));
+            rows    = (std::max(samples_per_pixel, 1) + columns - 1) / columns;
+        }
+
+        void sample_2d(uint64_t pixel, uint64_t sample, uint32_t dimension, double& u, double& v) const override {
+            uint32_t count   = uint32_t(columns * rows);
+            uint32_t pattern = uint32_t(rng::mix(rng::mix(seed ^ pixel) ^ (uint64_t(dimension) << 32 | (sample / count))));
+
+            uint32_t s  = permute(uint32_t(sample % count), count, pattern * 0x51633e2du);
+            uint32_t sx = permute(s % columns, columns, pattern * 0xa511e9b3u);
+            uint32_t sy = permute(s / columns, rows, pattern * 0x63d83595u);
+            double   jx = random_unit(s, pattern * 0xa399d265u);
+            double   jy = random_unit(s, pattern * 0x711ad6a5u);
+            u = (s % columns + (sy + jx) / rows) / columns;
+            v = (s / columns + (sx + jy) / columns) / rows;
+        }
+
+    private:
+        uint64_t    seed;
+        int         columns, rows;
+
+        // the i-th element of a random permutation of [0, count) chosen by pattern
+        static uint32_t permute(uint32_t i, uint32_t count, uint32_t pattern) {
+            uint32_t w = count - 1;
+            w |= w >> 1;  w |= w >> 2;  w |= w >> 4;  w |= w >> 8;  w |= w >> 16;
+            do {
+                i ^= pattern;           i *= 0xe170893du;
+                i ^= pattern >> 16;     i ^= (i & w) >> 4;
+                i ^= pattern >> 8;      i *= 0x0929eb3fu;
+                i ^= pattern >> 23;     i ^= (i & w) >> 1;
+                i *= 1 | pattern >> 27; i *= 0x6935fa69u;
+                i ^= (i & w) >> 11;     i *= 0x74dcb303u;
+                i ^= (i & w) >> 2;      i *= 0x9e501cc3u;
+                i ^= (i & w) >> 2;      i *= 0xc860a3dfu;
+                i &= w;                 i ^= i >> 5;
+            } while (i >= count);
+            return (i + pattern) % count;
+        }
+
+        // random real in [0,1) for i and pattern
+        static double random_unit(uint32_t i, uint32_t pattern) {
+            i ^= pattern;   i ^= i >> 17;   i ^= i >> 10;   i *= 0xb36534e5u;
+            i ^= i >> 12;   i ^= i >> 21;   i *= 0x93fc4795u;   i ^= 0xdf6e307fu;
+            i ^= i >> 17;   i *= 1 | pattern >> 18;
+            return i * (1.0 / 4294967296.0);
+        }
+};
+
+// first two dimensions of the Sobol sequence, Owen scrambled and shuffled per pixel and
+// dimension with hash based nested uniform scrambling (Burley 2020)
+// 1. every power of two prefix of a pixel's samples is stratified in each 2D pair
+// 2. any number of samples works, and the sequence is progressive: the first N samples of
+//    a longer render are as well distributed as a render of N samples
+class sobol_sampler : public pixel_sampler {
+    public:
+        explicit sobol_sampler(uint64_t seed) : seed(seed) {}
+
+        void sample_2d(uint64_t pixel, uint64_t sample, uint32_t dimension, double& u, double& v) const override {
+            uint64_t scramble = rng::mix(rng::mix(seed ^ pixel) ^ dimension);
+            point(uint32_t(sample), scramble, u, v);
+        }
+
+        // the sample-th point of the sequence shuffled and scrambled by scramble
+        static void point(uint32_t sample, uint64_t scramble, double& u, double& v) {
+            uint32_t index = nested_uniform_scramble(sample, uint32_t(scramble));
+            uint32_t x     = nested_uniform_scramble(reverse_bits(index), uint32_t(scramble >> 32));
+            uint32_t y     = nested_uniform_scramble(sobol_second(index), uint32_t(rng::mix(scramble)));
+            u = x * (1.0 / 4294967296.0);
+            v = y * (1.0 / 4294967296.0);
+        }
+
+    private:
+        uint64_t seed;
+
+        static uint32_t reverse_bits(uint32_t x) {
+            x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+            x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+            x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+            x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+            return (x >> 16) | (x << 16);
+        }
+
+        // second Sobol dimension, generated by the direction numbers v_k = v_k-1 ^ (v_k-1 >> 1)
+        static uint32_t sobol_second(uint32_t index) {
+            uint32_t result = 0;
+            for (uint32_t direction = 1u << 31; index != 0; index >>= 1, direction ^= direction >> 1)
+                if (index & 1)
+                    result ^= direction;
+            return result;
+        }
+
+        // Laine-Karras style hash that only lets the lower bits change the higher ones
+        static uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+            x += seed;
+            x ^= x * 0x6c50b47cu;
+            x ^= x * 0xb82f1e52u;
+            x ^= x * 0xc7afe638u;
+            x ^= x * 0x8d22f6e6u;
+            return x;
+        }
+
+        // Owen scramble: flips every bit depending on the bits above it only
+        static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+            return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+        }
+};
+
+// one Owen scrambled Sobol sequence per dimension, shared by all pixels and toroidally
+// shifted per pixel by a blue noise mask (Georgiev and Fajardo 2016), so the error left
+// in neighboring pixels is anti-correlated and looks like fine grain instead of blotches
+// NOTE: the mask is a 64 x 64 void-and-cluster pattern (Ulichney 1993), built once per
+//       process; every dimension reads it at its own offset
+class blue_noise_sampler : public pixel_sampler {
+    public:
+        blue_noise_sampler(int image_width, uint64_t seed) : image_width(std::max(image_width, 1)), seed(seed) {}
+
+        void sample_2d(uint64_t pixel, uint64_t sample, uint32_t dimension, double& u, double& v) const override {
+            uint64_t scramble = rng::mix(seed ^ dimension);
+            sobol_sampler::point(uint32_t(sample), scramble, u, v);
+
+            const auto& ranks = mask();
+            auto x = uint32_t(pixel % uint64_t(image_width));
+            auto y = uint32_t(pixel / uint64_t(image_width));
+            auto offset = uint32_t(scramble >> 40);
+            u += (ranks[((y + (offset >> 6))  % mask_size) * mask_size + (x + offset) % mask_size] + 0.5) / mask_pixels;
+            v += (ranks[((y + (offset >> 18)) % mask_size) * mask_size + (x + (offset >> 12)) % mask_size] + 0.5) / mask_pixels;
+            u -= u >= 1 ? 1 : 0;
+            v -= v >= 1 ? 1 : 0;
+        }
+
+    private:
+        static constexpr int mask_size   = 64;
+        static constexpr int mask_pixels = mask_size * mask_size;
+
+        int         image_width;
+        uint64_t    seed;
+
+        static const std::vector<uint16_t>& mask() {
+            static const std::vector<uint16_t> ranks = void_and_cluster();
+            return ranks;
+        }
+
+        // rank of every mask pixel in the order void-and-cluster fills the mask
+        // 1. a random initial pattern of 10% of the pixels is relaxed by moving its tightest
+        //    cluster into its largest void until both are the same pixel
+        // 2. removing the tightest clusters one by one ranks the initial pixels downwards,
+        //    filling the largest voids one by one ranks the others upwards
+        // NOTE: cluster and void are the maximum and minimum of a toroidal Gaussian filter
+        //       over the set pixels; the filter of the unset pixels is its complement, so
+        //       filling voids also covers the second half of the ranks
+        static std::vector<uint16_t> void_and_cluster() {
+            const double sigma = 1.5;
+            std::vector<double> kernel(mask_pixels);
+            for (int dy = 0; dy < mask_size; dy++) {
+                for (int dx = 0; dx < mask_size; dx++) {
+                    int x = std::min(dx, mask_size - dx), y = std::min(dy, mask_size - dy);
+                    kernel[dy * mask_size + dx] = std::exp(-(x*x + y*y) / (2 * sigma * sigma));
+                }
+            }
+
+            std::vector<char>   set(mask_pixels, 0);
+            std::vector<double> energy(mask_pixels, 0);
+            auto toggle = [&](int p) {
+                double sign = set[p] ? -1 : 1;
+                set[p] = !set[p];
+                int px = p % mask_size, py = p / mask_size;
+                for (int q = 0; q < mask_pixels; q++) {
+                    int dx = (q % mask_size - px) & (mask_size - 1);
+                    int dy = (q / mask_size - py) & (mask_size - 1);
+                    energy[q] += sign * kernel[dy * mask_size + dx];
+                }
+            };
+            auto extreme = [&](bool of_set, bool largest) {
+                int best = -1;
+                for (int p = 0; p < mask_pixels; p++)
+                    if (bool(set[p]) == of_set && (best < 0 || (largest ? energy[p] > energy[best] : energy[p] < energy[best])))
+                        best = p;
+                return best;
+            };
+
+            rng gen(0x5eed);
+            int initial = mask_pixels / 10;
+            for (int placed = 0; placed < initial; ) {
+                int p = int(gen.next_uint() % mask_pixels);
+                if (!set[p]) {
+                    toggle(p);
+                    placed++;
+                }
+            }
+            while (true) {
+                int cluster = extreme(true, true);
+                toggle(cluster);
+                int hole = extreme(false, false);
+                toggle(hole);
+                if (hole == cluster)
+                    break;
+            }
+
+            std::vector<uint16_t> ranks(mask_pixels);
+            auto initial_set    = set;
+            auto initial_energy = energy;
+            for (int rank = initial - 1; rank >= 0; rank--) {
+                int cluster = extreme(true, true);
+                toggle(cluster);
+                ranks[cluster] = uint16_t(rank);
+            }
+            set    = initial_set;
+            energy = initial_energy;
+            for (int rank = initial; rank < mask_pixels; rank++) {
+                int hole = extreme(false, false);
+                toggle(hole);
+                ranks[hole] = uint16_t(rank);
+            }
+            return ranks;
+        }
+};
+
+// sampler named by the camera's sampler setting, nullptr for "independent" (plain random
+// numbers) and for unknown names
+inline shared_ptr<const pixel_sampler> make_pixel_sampler(const std::string& name, int samples_per_pixel,
+                                                          int image_width, uint64_t seed) {
+    if (name == "stratified")   return make_shared<stratified_sampler>(samples_per_pixel, seed);
+    if (name == "sobol")        return make_shared<sobol_sampler>(seed);
+    if (name == "blue_noise")   return make_shared<blue_noise_sampler>(image_width, seed);
+    return nullptr;
+}
+
+#endif  // end of sampler header file
@@ -0,0 +1,311 @@
+#ifndef SCENE_H // start of scene header file
+#define SCENE_H // scene_description class definition
+
+// Import libraries
+#include "rtweekend.h"
+#include "arena.h"
+#include "bvh.h"
+#include "closed_world.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "material.h"
+#include "packed_spheres.h"
+#include "sphere.h"
+#include "triangle_mesh.h"
+
+#include <vector>
+
+// sphere of a scene_description
+struct sphere_desc {
+    point3  center;
+    double  radius;
+    int     material;   // index into scene_description::materials
+};
+
+// triangle mesh of a scene_description
+struct mesh_desc {
+    shared_ptr<const mesh_buffers>  buffers;    // shared by every world built from the scene
+    int                             material;   // index into scene_description::materials
+};
+
+// placement of a prototype of a scene_description
+struct instance_desc {
+    int                 prototype;  // index into scene_description::prototypes
+    affine_transform    transform;  // prototype to scene space
+};
+
+// plain description of a scene made of spheres
+// the same description is built into each kind of world the renderer can take:
+// 1. build_objects: one sphere object per sphere under a bvh_node (virtual hit and scatter)
+// 2. build_packed:  the spheres in a packed_spheres (SIMD hit, virtual scatter)
+// 3. build_closed:  a closed_world (SIMD hit, no virtual calls at all)
+// every builder allocates exactly what the scene needs, in a few contiguous blocks that
+// are freed together with the world, and can report that footprint in bytes
+// instances place prototypes, sub-scenes with their own materials, by affine transforms;
+// build_objects and build_packed build each prototype once and add one small instance
+// object per placement to the top level hierarchy
+// triangle meshes are added the same way, as one triangle_mesh object each over their
+// shared vertex and index buffers
+// NOTE: the description is kept in double; each builder takes the scalar type of the
+//       world it builds, e.g. build_closed<float>() for the single precision path
+// NOTE: a closed_world holds spheres only, build_closed ignores the instances and meshes
+class scene_description {
+    public:
+        std::vector<material_variant>   materials;
+        std::vector<sphere_desc>        spheres;
+        std::vector<scene_description>  prototypes;
+        std::vector<instance_desc>      instances;
+        std::vector<mesh_desc>          meshes;
+
+        // adds a material and returns its index
+        int add_material(const material_variant& mat) {
+            materials.push_back(mat);
+            return int(materials.size()) - 1;
+        }
+
+        void add_sphere(const point3& center, double radius, int mat) {
+            spheres.push_back(sphere_desc{center, radius, mat});
+        }
+
+        // adds a prototype and returns its index
+        int add_prototype(scene_description prototype) {
+            prototypes.push_back(std::move(prototype));
+            return int(prototypes.size()) - 1;
+        }
+
+        void add_instance(int prototype, const affine_transform& transform) {
+            instances.push_back(instance_desc{prototype, transform});
+        }
+
+        void add_mesh(shared_ptr<const mesh_buffers> buffers, int mat) {
+            meshes.push_back(mesh_desc{std::move(buffers), mat});
+        }
+
+        // triangles the scene shows, counting those of every instance
+        size_t triangle_count() const {
+            size_t count = 0;
+            for (const auto& m : meshes)
+                count += m.buffers->triangle_count();
+            for (const auto& inst : instances)
+                count += prototypes[inst.prototype].triangle_count();
+            return count;
+        }
+
+        // spheres the scene shows, counting those of every instance
+        size_t sphere_count() const {
+            size_t count = spheres.size();
+            for (const auto& inst : instances)
+                count += prototypes[inst.prototype].sphere_count();
+            return count;
+        }
+
+        // NOTE: the spheres and materials are placed in one arena in leaf order of a
+        //       hierarchy over the spheres, so neighbouring leaves read neighbouring memory
+        template <typename T = double>
+        shared_ptr<basic_hittable<T>> build_objects(size_t* bytes = nullptr) const {
+            auto storage = make_shared<arena>(arena_size<T>(spheres.size() * sizeof(basic_sphere<T>)));
+            auto shared  = shared_materials<T>(storage);
+
+            std::vector<aabb> boxes;
+            boxes.reserve(spheres.size());
+            for (const auto& s : spheres) {
+                auto rvec = vec3(s.radius, s.radius, s.radius);
+                boxes.push_back(aabb(s.center - rvec, s.center + rvec));
+            }
+            bvh_tree order;
+            order.build(boxes);
+
+            basic_hittable_list<T> list;
+            list.objects.reserve(spheres.size() + instances.size());
+            for (int prim : order.prim_indices) {
+                const auto& s = spheres[prim];
+                list.add(arena_shared<basic_sphere<T>>(storage, basic_vec3<T>(s.center), T(s.radius),
+                                                       shared[s.material]));
+            }
+            auto prototype_bytes = add_instances<T>(list, storage, [](const scene_description& prototype, size_t* built) {
+                return prototype.build_objects<T>(built);
+            });
+            auto mesh_bytes = add_meshes<T>(list, storage, shared);
+
+            auto world = make_shared<basic_bvh_node<T>>(list);
+            if (bytes)
+                *bytes = storage->bytes_reserved() + world->memory_bytes() + prototype_bytes + mesh_bytes;
+            return world;
+        }
+
+        template <typename T = double>
+        shared_ptr<basic_hittable<T>> build_packed(size_t* bytes = nullptr) const {
+            auto storage = make_shared<arena>(arena_size<T>(0));
+            auto shared  = shared_materials<T>(storage);
+            auto packed  = make_shared<basic_packed_spheres<T>>();
+            packed->reserve(int(spheres.size()));
+            for (const auto& s : spheres)
+                packed->add(basic_vec3<T>(s.center), T(s.radius), shared[s.material]);
+            packed->build();
+            if (instances.empty() && meshes.empty()) {
+                if (bytes)
+                    *bytes = storage->bytes_reserved() + packed->memory_bytes();
+                return packed;
+            }
+
+            // the packed spheres, the instances and the meshes under one hierarchy
+            basic_hittable_list<T> list;
+            if (!spheres.empty())
+                list.add(packed);
+            auto prototype_bytes = add_instances<T>(list, storage, [](const scene_description& prototype, size_t* built) {
+                return prototype.build_packed<T>(built);
+            });
+            auto mesh_bytes = add_meshes<T>(list, storage, shared);
+            auto world = make_shared<basic_bvh_node<T>>(list);
+            if (bytes)
+                *bytes = storage->bytes_reserved() + packed->memory_bytes() + world->memory_bytes() + prototype_bytes
+                       + mesh_bytes;
+            return world;
+        }
+
+        template <typename T = double>
+        basic_closed_world<T> build_closed(size_t* bytes = nullptr) const {
+            basic_closed_world<T> world;
+            world.reserve(int(materials.size()), int(spheres.size()));
+            for (const auto& mat : materials)
+                world.add_material(convert_material<T>(mat));
+            for (const auto& s : spheres)
+                world.add_sphere(basic_vec3<T>(s.center), T(s.radius), s.material);
+            world.build();
+            if (bytes)
+                *bytes = world.memory_bytes();
+            return world;
+        }
+
+    private:
+        // adds one instance object per instance to list, placed in storage, building every
+        // prototype they use once with build(prototype, &bytes); returns the bytes of the
+        // built prototypes
+        template <typename T, typename build_function>
+        size_t add_instances(basic_hittable_list<T>& list, const shared_ptr<arena>& storage, build_function&& build) const {
+            size_t prototype_bytes = 0;
+            std::vector<shared_ptr<basic_hittable<T>>> built(prototypes.size());
+            for (const auto& inst : instances) {
+                auto& prototype = built[inst.prototype];
+                if (!prototype) {
+                    size_t bytes = 0;
+                    prototype = build(prototypes[inst.prototype], &bytes);
+                    prototype_bytes += bytes;
+                }
+                list.add(arena_shared<basic_instance<T>>(storage, prototype, basic_affine_transform<T>(inst.transform)));
+            }
+            return prototype_bytes;
+        }
+
+        // adds one triangle_mesh per mesh to list, placed in storage; returns the bytes of
+        // their hierarchies and of the buffers they own
+        template <typename T>
+        size_t add_meshes(basic_hittable_list<T>& list, const shared_ptr<arena>& storage,
+                          const std::vector<shared_ptr<basic_material<T>>>& shared) const
+        {
+            size_t mesh_bytes = 0;
+            for (const auto& m : meshes) {
+                auto mesh = arena_shared<basic_triangle_mesh<T>>(storage, m.buffers, shared[m.material]);
+                mesh_bytes += mesh->memory_bytes() + m.buffers->memory_bytes();
+                list.add(mesh);
+            }
+            return mesh_bytes;
+        }
+
+        // bytes of an arena that holds sphere_bytes of spheres and every material, instance
+        // and mesh in one block, with room for the alignment of each kind of object
+        template <typename T>
+        size_t arena_size(size_t sphere_bytes) const {
+            return sphere_bytes + materials.size() * sizeof(basic_material_variant<T>)
+                 + instances.size() * sizeof(basic_instance<T>) + meshes.size() * sizeof(basic_triangle_mesh<T>)
+                 + 4 * 64;
+        }
+
+        // one material per description material placed in storage, shared by all its spheres
+        template <typename T>
+        std::vector<shared_ptr<basic_material<T>>> shared_materials(const shared_ptr<arena>& storage) const {
+            std::vector<shared_ptr<basic_material<T>>> shared;
+            shared.reserve(materials.size());
+            for (const auto& mat : materials)
+                shared.push_back(make_material(convert_material<T>(mat), storage));
+            return shared;
+        }
+};
+
+// the final scene of "Ray Tracing in One Weekend": a ground sphere, a grid of small
+// random spheres and three large ones
+// NOTE: draws from the global generator, so it is the same scene on every run
+inline scene_description random_spheres_scene() {
+    scene_description scene;
+
+    // create and add ground material to world scene
+    auto material_ground    = scene.add_material(lambertian(color(0.5, 0.5, 0.5)));
+    scene.add_sphere(point3(0, -1000, 0), 1000, material_ground);
+
+    // generate random spheres
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            // random value to choose a material
+            auto choose_mat = random_double();
+            // random position in the viewport
+            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    scene.add_sphere(center, 0.2, scene.add_material(lambertian(albedo)));
+                }
+                else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    scene.add_sphere(center, 0.2, scene.add_material(metal(albedo, fuzz)));
+                }
+                else {
+                    // glass
+                    scene.add_sphere(center, 0.2, scene.add_material(dialectric(1.5)));
+                }
+            }
+        }
+    }
+
+    // create and add 3 large spheres to the world scene
+    auto material1 = scene.add_material(dialectric(1.5));
+    scene.add_sphere(point3(0,1,0), 1.0, material1);
+
+    auto material2 = scene.add_material(lambertian(color(0.4, 0.2, 0.1)));
+    scene.add_sphere(point3(-4, 1, 0), 1.0, material2);
+
+    auto material3 = scene.add_material(metal(color(0.7, 0.6, 0.5), 0.0));
+    scene.add_sphere(point3(4, 1, 0), 1.0, material3);
+
+    return scene;
+}
+
+// the small random spheres of random_spheres_scene as one prototype cluster, placed copies
+// times on a square grid over a wide ground, each turned about the vertical and scaled a
+// little; the cluster's spheres are stored once however many copies there are
+// NOTE: draws from the global generator, like random_spheres_scene
+inline scene_description instanced_clusters_scene(int copies) {
+    scene_description cluster = random_spheres_scene();
+    cluster.spheres.erase(cluster.spheres.begin());     // its ground sphere
+
+    scene_description scene;
+    auto material_ground = scene.add_material(lambertian(color(0.5, 0.5, 0.5)));
+    scene.add_sphere(point3(0, -10000, 0), 10000, material_ground);
+
+    auto prototype = scene.add_prototype(std::move(cluster));
+    int  side      = int(std::ceil(std::sqrt(double(copies))));
+    double spacing = 24;
+    for (int k = 0; k < copies; k++) {
+        auto offset = vec3((k % side - (side - 1) / 2.0) * spacing, 0, (k / side - (side - 1) / 2.0) * spacing);
+        auto scale  = random_double(0.8, 1.2);
+        scene.add_instance(prototype, affine_transform::translation(offset)
+                                    * affine_transform::rotation(vec3(0, 1, 0), random_double(0, 360))
+                                    * affine_transform::scaling(vec3(scale, scale, scale)));
+    }
+    return scene;
+}
+
+#endif  // end of scene header file
@@ -0,0 +1,405 @@
+#ifndef SCENE_FILE_H    // start of scene_file header file
+#define SCENE_FILE_H    // scene_file class definition
+
+// Import libraries
+#include "rtweekend.h"
+#include "byte_io.h"
+#include "camera.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "scene.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scene files
+// a scene file holds a scene_description (materials and spheres) plus the camera settings
+// that frame it, in one of two formats:
+// 1. text, one statement per line, '#' starts a comment:
+//        camera <field> <value...>     fields: aspect_ratio, image_width, samples_per_pixel,
+//                                      max_depth, vfov, lookfrom, lookat, vup (x y z),
+//                                      defocus_angle, focus_dist
+//        material lambertian <r> <g> <b>
+//        material metal <r> <g> <b> <fuzz>
+//        material dialectric <refraction index>
+//        sphere <x> <y> <z> <radius> <material>
+//    materials are numbered from 0 in the order they appear
+// 2. binary, little-endian fixed size records read straight from a memory mapping:
+//        "RTSC", version (u32), material count (u32), sphere count (u64)
+//        camera: aspect_ratio (f64), image_width, samples_per_pixel, max_depth (3 x u32),
+//                vfov (f64), lookfrom, lookat, vup (9 x f64), defocus_angle, focus_dist (2 x f64)
+//        per material: type (u32: 0 lambertian, 1 metal, 2 dialectric), parameters (4 x f64)
+//        per sphere: center (3 x f64), radius (f64), material (u32)
+// NOTE: load tells the formats apart by the "RTSC" magic; save writes binary for paths
+//       ending in ".rtsb" and text for anything else
+class scene_file {
+    public:
+        // replaces scene and the camera fields above with the contents of the file at path;
+        // on failure returns false with a message in error
+        static bool load(const std::string& path, scene_description& scene, camera_settings& settings,
+                         std::string& error)
+        {
+            mapped_file file(path);
+            if (!file.is_open()) {
+                error = "cannot read " + path;
+                return false;
+            }
+
+            scene = scene_description();
+            bool binary = file.size() >= 4 && std::memcmp(file.data(), "RTSC", 4) == 0;
+            bool loaded = binary ? read_binary(file.data(), file.size(), scene, settings, error)
+                                 : read_text(file.data(), file.size(), scene, settings, error);
+            if (loaded && !check_materials(scene, error))
+                loaded = false;
+            if (!loaded)
+                error = path + ": " + error;
+            return loaded;
+        }
+
+        // writes scene and the camera fields to path; false if the file cannot be written or
+        // the scene holds a material that has no file representation, instances or meshes
+        static bool save(const std::string& path, const scene_description& scene, const camera_settings& settings,
+                         std::string& error)
+        {
+            if (!scene.instances.empty() || !scene.meshes.empty()) {
+                error = "scene files cannot store instances or meshes";
+                return false;
+            }
+            bool binary = path.size() >= 5 && path.compare(path.size() - 5, 5, ".rtsb") == 0;
+            std::vector<unsigned char> bytes;
+            if (!(binary ? write_binary(bytes, scene, settings, error) : write_text(bytes, scene, settings, error)))
+                return false;
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+            if (!out) {
+                error = "cannot write " + path;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        static constexpr uint32_t file_version          = 1;
+        static constexpr size_t   header_size           = 20;
+        static constexpr size_t   camera_record_size    = 116;
+        static constexpr size_t   material_record_size  = 36;
+        static constexpr size_t   sphere_record_size    = 36;
+
+        /* Text format */
+
+        // tokens of one line of a text scene file
+        struct line_reader {
+            const char* p;
+            const char* end;
+            bool        ok = true;     // false once a token was missing or malformed
+
+            void skip_space() {
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+                    p++;
+                if (p < end && *p == '#')
+                    p = end;
+            }
+
+            std::string_view word() {
+                skip_space();
+                const char* start = p;
+                while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '#')
+                    p++;
+                return std::string_view(start, size_t(p - start));
+            }
+
+            template <typename V>
+            V number() {
+                skip_space();
+                V value = 0;
+                auto result = std::from_chars(p, end, value);
+                if (result.ec != std::errc())
+                    ok = false;
+                else
+                    p = result.ptr;
+                return value;
+            }
+
+            vec3 vector() {
+                auto x = number<double>();
+                auto y = number<double>();
+                auto z = number<double>();
+                return vec3(x, y, z);
+            }
+
+            bool at_end() {
+                skip_space();
+                return p == end;
+            }
+        };
+
+        static bool read_text(const unsigned char* data, size_t size, scene_description& scene,
+                              camera_settings& settings, std::string& error)
+        {
+            const char* p   = reinterpret_cast<const char*>(data);
+            const char* end = p + size;
+
+            for (int line = 1; p < end; line++) {
+                auto eol = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+                if (eol == nullptr)
+                    eol = end;
+                line_reader in{p, eol};
+                p = eol < end ? eol + 1 : end;
+
+                auto statement = in.word();
+                if (statement.empty())
+                    continue;   // blank line or comment
+
+                if (statement == "camera") {
+                    auto field = in.word();
+                    if (!read_camera_field(in, field, settings)) {
+                        error = "line " + std::to_string(line) + ": unknown camera field '" + std::string(field) + "'";
+                        return false;
+                    }
+                }
+                else if (statement == "material") {
+                    auto type = in.word();
+                    if (type == "lambertian") {
+                        auto albedo = in.vector();
+                        scene.add_material(lambertian(albedo));
+                    }
+                    else if (type == "metal") {
+                        auto albedo = in.vector();
+                        auto fuzz   = in.number<double>();
+                        scene.add_material(metal(albedo, fuzz));
+                    }
+                    else if (type == "dialectric") {
+                        scene.add_material(dialectric(in.number<double>()));
+                    }
+                    else {
+                        error = "line " + std::to_string(line) + ": unknown material '" + std::string(type) + "'";
+                        return false;
+                    }
+                }
+                else if (statement == "sphere") {
+                    auto center = in.vector();
+                    auto radius = in.number<double>();
+                    auto mat    = in.number<int>();
+                    scene.add_sphere(center, radius, mat);
+                }
+                else {
+                    error = "line " + std::to_string(line) + ": unknown statement '" + std::string(statement) + "'";
+                    return false;
+                }
+
+                if (!in.ok || !in.at_end()) {
+                    error = "line " + std::to_string(line) + ": malformed " + std::string(statement);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static bool read_camera_field(line_reader& in, std::string_view field, camera_settings& settings) {
+            if      (field == "aspect_ratio")      settings.aspect_ratio      = in.number<double>();
+            else if (field == "image_width")       settings.image_width       = in.number<int>();
+            else if (field == "samples_per_pixel") settings.samples_per_pixel = in.number<int>();
+            else if (field == "max_depth")         settings.max_depth         = in.number<int>();
+            else if (field == "vfov")              settings.vfov              = in.number<double>();
+            else if (field == "lookfrom")          settings.lookfrom          = in.vector();
+            else if (field == "lookat")            settings.lookat            = in.vector();
+            else if (field == "vup")               settings.vup               = in.vector();
+            else if (field == "defocus_angle")     settings.defocus_angle     = in.number<double>();
+            else if (field == "focus_dist")        settings.focus_dist        = in.number<double>();
+            else return false;
+            return true;
+        }
+
+        static bool write_text(std::vector<unsigned char>& bytes, const scene_description& scene,
+                               const camera_settings& settings, std::string& error)
+        {
+            std::string text;
+            text.reserve(64 * (scene.materials.size() + scene.spheres.size()) + 512);
+
+            text += "# camera\n";
+            text += "camera aspect_ratio " + format(settings.aspect_ratio) + '\n';
+            text += "camera image_width " + std::to_string(settings.image_width) + '\n';
+            text += "camera samples_per_pixel " + std::to_string(settings.samples_per_pixel) + '\n';
+            text += "camera max_depth " + std::to_string(settings.max_depth) + '\n';
+            text += "camera vfov " + format(settings.vfov) + '\n';
+            text += "camera lookfrom " + format(settings.lookfrom) + '\n';
+            text += "camera lookat " + format(settings.lookat) + '\n';
+            text += "camera vup " + format(settings.vup) + '\n';
+            text += "camera defocus_angle " + format(settings.defocus_angle) + '\n';
+            text += "camera focus_dist " + format(settings.focus_dist) + '\n';
+
+            text += "# materials, numbered from 0\n";
+            for (const auto& mat : scene.materials) {
+                if (auto m = std::get_if<lambertian>(&mat))
+                    text += "material lambertian " + format(m->get_albedo()) + '\n';
+                else if (auto m = std::get_if<metal>(&mat))
+                    text += "material metal " + format(m->get_albedo()) + ' ' + format(m->get_fuzz()) + '\n';
+                else if (auto m = std::get_if<dialectric>(&mat))
+                    text += "material dialectric " + format(m->get_refraction_index()) + '\n';
+                else {
+                    error = "scene files only hold lambertian, metal and dialectric materials";
+                    return false;
+                }
+            }
+
+            text += "# spheres: center, radius, material\n";
+            for (const auto& s : scene.spheres)
+                text += "sphere " + format(s.center) + ' ' + format(s.radius) + ' ' + std::to_string(s.material) + '\n';
+
+            bytes.assign(text.begin(), text.end());
+            return true;
+        }
+
+        // shortest text that reads back as the same double
+        static std::string format(double value) {
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            return std::string(buffer, result.ptr);
+        }
+
+        static std::string format(const vec3& v) {
+            return format(v.x()) + ' ' + format(v.y()) + ' ' + format(v.z());
+        }
+
+        /* Binary format */
+
+        static bool read_binary(const unsigned char* data, size_t size, scene_description& scene,
+                                camera_settings& settings, std::string& error)
+        {
+            if (size < header_size + camera_record_size) {
+                error = "truncated scene file";
+                return false;
+            }
+            if (get_u32(data + 4) != file_version) {
+                error = "scene file version " + std::to_string(get_u32(data + 4)) + " is not supported";
+                return false;
+            }
+
+            uint32_t material_count = get_u32(data + 8);
+            uint64_t sphere_count   = get_u64(data + 12);
+            size_t   fixed_size     = header_size + camera_record_size + size_t(material_count) * material_record_size;
+            if (size < fixed_size || (size - fixed_size) % sphere_record_size != 0
+             || (size - fixed_size) / sphere_record_size != sphere_count) {
+                error = "file size does not match its material and sphere counts";
+                return false;
+            }
+
+            const unsigned char* src = data + header_size;
+            settings.aspect_ratio       = get_f64(src);
+            settings.image_width        = int(get_u32(src + 8));
+            settings.samples_per_pixel  = int(get_u32(src + 12));
+            settings.max_depth          = int(get_u32(src + 16));
+            settings.vfov               = get_f64(src + 20);
+            settings.lookfrom           = get_vec3(src + 28);
+            settings.lookat             = get_vec3(src + 52);
+            settings.vup                = get_vec3(src + 76);
+            settings.defocus_angle      = get_f64(src + 100);
+            settings.focus_dist         = get_f64(src + 108);
+            src += camera_record_size;
+
+            scene.materials.reserve(material_count);
+            for (uint32_t m = 0; m < material_count; m++, src += material_record_size) {
+                switch (get_u32(src)) {
+                    case 0:  scene.add_material(lambertian(get_vec3(src + 4)));                      break;
+                    case 1:  scene.add_material(metal(get_vec3(src + 4), get_f64(src + 28)));        break;
+                    case 2:  scene.add_material(dialectric(get_f64(src + 4)));                       break;
+                    default:
+                        error = "unknown type of material " + std::to_string(m);
+                        return false;
+                }
+            }
+
+            // one allocation for all spheres, then plain decoding of the mapped records
+            scene.spheres.resize(size_t(sphere_count));
+            for (auto& s : scene.spheres) {
+                s.center   = get_vec3(src);
+                s.radius   = get_f64(src + 24);
+                s.material = int(get_u32(src + 32));
+                src += sphere_record_size;
+            }
+            return true;
+        }
+
+        static bool write_binary(std::vector<unsigned char>& bytes, const scene_description& scene,
+                                 const camera_settings& settings, std::string& error)
+        {
+            bytes.reserve(header_size + camera_record_size + scene.materials.size() * material_record_size
+                        + scene.spheres.size() * sphere_record_size);
+
+            bytes.insert(bytes.end(), {'R', 'T', 'S', 'C'});
+            put_u32(bytes, file_version);
+            put_u32(bytes, uint32_t(scene.materials.size()));
+            put_u64(bytes, uint64_t(scene.spheres.size()));
+
+            put_f64(bytes, settings.aspect_ratio);
+            put_u32(bytes, uint32_t(settings.image_width));
+            put_u32(bytes, uint32_t(settings.samples_per_pixel));
+            put_u32(bytes, uint32_t(settings.max_depth));
+            put_f64(bytes, settings.vfov);
+            put_vec3(bytes, settings.lookfrom);
+            put_vec3(bytes, settings.lookat);
+            put_vec3(bytes, settings.vup);
+            put_f64(bytes, settings.defocus_angle);
+            put_f64(bytes, settings.focus_dist);
+
+            for (const auto& mat : scene.materials) {
+                if (auto m = std::get_if<lambertian>(&mat)) {
+                    put_u32(bytes, 0);
+                    put_vec3(bytes, m->get_albedo());
+                    put_f64(bytes, 0);
+                }
+                else if (auto m = std::get_if<metal>(&mat)) {
+                    put_u32(bytes, 1);
+                    put_vec3(bytes, m->get_albedo());
+                    put_f64(bytes, m->get_fuzz());
+                }
+                else if (auto m = std::get_if<dialectric>(&mat)) {
+                    put_u32(bytes, 2);
+                    put_f64(bytes, m->get_refraction_index());
+                    put_vec3(bytes, vec3(0, 0, 0));
+                }
+                else {
+                    error = "scene files only hold lambertian, metal and dialectric materials";
+                    return false;
+                }
+            }
+
+            for (const auto& s : scene.spheres) {
+                put_vec3(bytes, s.center);
+                put_f64(bytes, s.radius);
+                put_u32(bytes, uint32_t(s.material));
+            }
+            return true;
+        }
+
+        // every sphere must name an existing material, since the world builders index by it
+        static bool check_materials(const scene_description& scene, std::string& error) {
+            for (size_t k = 0; k < scene.spheres.size(); k++) {
+                if (scene.spheres[k].material < 0 || size_t(scene.spheres[k].material) >= scene.materials.size()) {
+                    error = "sphere " + std::to_string(k) + " uses undefined material "
+                          + std::to_string(scene.spheres[k].material);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static void put_vec3(std::vector<unsigned char>& bytes, const vec3& v) {
+            put_f64(bytes, v.x());
+            put_f64(bytes, v.y());
+            put_f64(bytes, v.z());
+        }
+
+        static vec3 get_vec3(const unsigned char* src) {
+            return vec3(get_f64(src), get_f64(src + 8), get_f64(src + 16));
+        }
+};
+
+#endif  // end of scene_file header file
@@ -3,17 +3,25 @@
 
 // Import libraries
 #include "hittable.h"
+#include "render_stats.h"
 #include "rtweekend.h"
 
-class sphere : public hittable {
+template <typename T>
+class basic_sphere : public basic_hittable<T> {
     public:
         // constructor initializing sphere with a material
-        sphere(const point3& center, double radius, shared_ptr<material> mat) 
-            : center(center), radius(fmax(0, radius)), mat(mat) {}
+        basic_sphere(const basic_vec3<T>& center, T radius, shared_ptr<basic_material<T>> mat) 
+            : center(center), radius(std::fmax(T(0), radius)), mat(mat)
+        {
+            auto rvec = basic_vec3<T>(this->radius, this->radius, this->radius);
+            bbox = basic_aabb<T>(center - rvec, center + rvec);
+        }
 
         // determines if a ray intersects with a sphere
-        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-            vec3 oc = center - r.origin();
+        bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+            RT_STATS_COUNT(hit_calls[primitive_sphere]++);
+
+            basic_vec3<T> oc = center - r.origin();
             auto a = r.direction().length_squared();
             auto h = dot(r.direction(), oc);
             auto c = oc.length_squared() - radius*radius;
@@ -38,17 +46,23 @@ class sphere : public hittable {
             rec.t = root;
             rec.p = r.at(rec.t);
             // surface side determination
-            vec3 outward_normal = (rec.p - center) / radius;
+            basic_vec3<T> outward_normal = (rec.p - center) / radius;
             rec.set_face_normal(r, outward_normal);
-            rec.mat = mat;
+            rec.mat = mat.get();
 
+            RT_STATS_COUNT(hits[primitive_sphere]++);
             return true;
         }
 
+        basic_aabb<T> bounding_box() const override {return bbox;}
+
     private:
-        point3                  center;
-        double                  radius;
-        shared_ptr<material>    mat;
+        basic_vec3<T>                   center;
+        T                               radius;
+        shared_ptr<basic_material<T>>   mat;    // keeps the material alive, records get the raw pointer
+        basic_aabb<T>                   bbox;
 };
 
-#endif  // end of sphere header file
\ No newline at end of file
+using sphere = basic_sphere<double>;
+
+#endif  // end of sphere header file
@@ -0,0 +1,175 @@
+#ifndef THREAD_POOL_H   // start of thread_pool header file
+#define THREAD_POOL_H   // thread_pool class definition
+
+// Import libraries
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads that execute indexed tasks
+// 1. each parallel_for call splits its task indices into one queue per worker
+// 2. a worker pops tasks from the back of its own queue
+// 3. a worker whose queue runs dry steals tasks from the front of the other queues,
+//    so expensive tasks clustered in one region do not leave the other workers idle
+// NOTE: the thread calling parallel_for takes part as worker 0, so a pool of size 1
+//       runs every task inline without starting any threads
+class thread_pool {
+    public:
+        // task body: receives the task index and the index of the worker running it
+        using task_function = std::function<void(int task, int worker)>;
+
+        // thread_count <= 0 uses every hardware thread
+        explicit thread_pool(int thread_count = 0) {
+            if (thread_count <= 0)
+                thread_count = int(std::thread::hardware_concurrency());
+            worker_count = std::max(1, thread_count);
+
+            queues.reserve(worker_count);
+            for (int w = 0; w < worker_count; w++)
+                queues.push_back(std::make_unique<work_queue>());
+
+            for (int w = 1; w < worker_count; w++)
+                threads.emplace_back([this, w] { worker_loop(w); });
+        }
+
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(job_mutex);
+                stopping = true;
+            }
+            job_ready.notify_all();
+            for (auto& t : threads)
+                t.join();
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        // number of workers, including the calling thread
+        int size() const {return worker_count;}
+
+        // runs body(task, worker) for every task in [0, task_count) and blocks until all
+        // of them have finished
+        // NOTE: concurrent callers are serialized, one job runs on the pool at a time
+        void parallel_for(int task_count, const task_function& body) {
+            if (task_count <= 0)
+                return;
+
+            std::lock_guard<std::mutex> submit_lock(submit_mutex);
+
+            // hand each worker a contiguous block of task indices
+            for (int w = 0; w < worker_count; w++) {
+                int first = int((long long)task_count * w / worker_count);
+                int last  = int((long long)task_count * (w + 1) / worker_count);
+                std::lock_guard<std::mutex> lock(queues[w]->mutex);
+                for (int task = first; task < last; task++)
+                    queues[w]->tasks.push_back(task);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(job_mutex);
+                job_body        = &body;
+                tasks_remaining = task_count;
+                job_generation++;
+            }
+            job_ready.notify_all();
+
+            run_tasks(0, body);
+
+            // wait for the tasks other workers are still running, and for every worker to
+            // leave the job so none of them can pick up tasks of the next one with this body
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job_done.wait(lock, [this] {return tasks_remaining == 0 && active_workers == 0;});
+            job_body = nullptr;
+        }
+
+    private:
+        // task queue owned by one worker, shared with thieves
+        struct work_queue {
+            std::mutex      mutex;
+            std::deque<int> tasks;
+        };
+
+        int                                         worker_count;
+        std::vector<std::unique_ptr<work_queue>>    queues;
+        std::vector<std::thread>                    threads;
+
+        std::mutex              submit_mutex;       // serializes parallel_for callers
+        std::mutex              job_mutex;          // guards the job state below
+        std::condition_variable job_ready;          // signals workers that a job was posted
+        std::condition_variable job_done;           // signals the caller that all tasks finished
+        const task_function*    job_body        = nullptr;
+        int                     tasks_remaining = 0;
+        int                     active_workers  = 0;    // helper threads inside the current job
+        unsigned long long      job_generation  = 0;
+        bool                    stopping        = false;
+
+        // waits for posted jobs and helps run them until the pool is destroyed
+        void worker_loop(int worker) {
+            unsigned long long seen_generation = 0;
+            while (true) {
+                const task_function* body;
+                {
+                    std::unique_lock<std::mutex> lock(job_mutex);
+                    job_ready.wait(lock, [&] {return stopping || job_generation != seen_generation;});
+                    if (stopping)
+                        return;
+                    seen_generation = job_generation;
+                    body            = job_body;
+                    if (body == nullptr)    // woke up after the job already finished
+                        continue;
+                    active_workers++;
+                }
+
+                run_tasks(worker, *body);
+
+                std::lock_guard<std::mutex> lock(job_mutex);
+                if (--active_workers == 0 && tasks_remaining == 0)
+                    job_done.notify_all();
+            }
+        }
+
+        // runs tasks from the worker's own queue, then steals until every queue is empty
+        void run_tasks(int worker, const task_function& body) {
+            int task;
+            while (pop_task(worker, task) || steal_task(worker, task)) {
+                body(task, worker);
+
+                std::lock_guard<std::mutex> lock(job_mutex);
+                if (--tasks_remaining == 0)
+                    job_done.notify_all();
+            }
+        }
+
+        // takes the most recently queued task of the worker's own queue
+        bool pop_task(int worker, int& task) {
+            auto& queue = *queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                return false;
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+
+        // takes the oldest task of another worker's queue, starting with the next worker
+        bool steal_task(int thief, int& task) {
+            for (int offset = 1; offset < worker_count; offset++) {
+                auto& queue = *queues[(thief + offset) % worker_count];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.tasks.empty()) {
+                    task = queue.tasks.front();
+                    queue.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+#endif  // end of thread_pool header file
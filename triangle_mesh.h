@@ -0,0 +1,234 @@
+#ifndef TRIANGLE_MESH_H // start of triangle_mesh header file
+#define TRIANGLE_MESH_H // mesh_buffers and triangle_mesh class definitions
+
+// Import libraries
+#include "rtweekend.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "mapped_file.h"
+#include "render_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// vertex and index arrays of a triangle mesh, shared by every triangle_mesh (and every
+// instance of one) built from them
+// 1. positions: x, y, z of every vertex in single precision, 12 bytes per vertex
+// 2. indices: 3 vertex indices per triangle, 12 bytes per triangle
+// NOTE: the arrays are either owned (e.g. parsed from an OBJ file) or viewed in place in a
+//       memory-mapped binary mesh file, which the buffers then keep mapped
+class mesh_buffers {
+    public:
+        // takes ownership of the arrays
+        void assign(std::vector<float> positions, std::vector<uint32_t> indices) {
+            owned_positions = std::move(positions);
+            owned_indices   = std::move(indices);
+            file.reset();
+            position_data   = owned_positions.data();
+            index_data      = owned_indices.data();
+            vertices        = owned_positions.size() / 3;
+            triangles       = owned_indices.size() / 3;
+        }
+
+        // uses arrays inside mapping, which stays mapped as long as the buffers live
+        void view(shared_ptr<const mapped_file> mapping, const float* positions, size_t vertex_count,
+                  const uint32_t* indices, size_t triangle_count)
+        {
+            owned_positions.clear();
+            owned_indices.clear();
+            file          = std::move(mapping);
+            position_data = positions;
+            index_data    = indices;
+            vertices      = vertex_count;
+            triangles     = triangle_count;
+        }
+
+        size_t vertex_count() const {return vertices;}
+        size_t triangle_count() const {return triangles;}
+
+        const float*    positions() const {return position_data;}
+        const uint32_t* indices() const {return index_data;}
+
+        // returns the index of the first triangle naming a vertex that does not exist, or
+        // triangle_count() if every index is valid
+        size_t first_bad_triangle() const {
+            for (size_t t = 0; t < triangles; t++)
+                for (int k = 0; k < 3; k++)
+                    if (index_data[3*t + k] >= vertices)
+                        return t;
+            return triangles;
+        }
+
+        // heap bytes of owned arrays; mapped arrays are counted as file pages instead
+        size_t memory_bytes() const {
+            return owned_positions.capacity() * sizeof(float) + owned_indices.capacity() * sizeof(uint32_t);
+        }
+
+        size_t mapped_bytes() const {return file ? file->size() : 0;}
+
+    private:
+        std::vector<float>              owned_positions;
+        std::vector<uint32_t>           owned_indices;
+        shared_ptr<const mapped_file>   file;
+        const float*                    position_data = nullptr;
+        const uint32_t*                 index_data    = nullptr;
+        size_t                          vertices      = 0;
+        size_t                          triangles     = 0;
+};
+
+// indexed triangle mesh with one material, as a single hittable
+// 1. the triangles live only in the shared mesh_buffers; the mesh adds a bounding volume
+//    hierarchy over them (a basic_bvh_tree, see bvh.h) and no per-triangle objects
+// 2. rays are tested with the watertight algorithm of Woop, Benthin and Wald (2013): the
+//    ray is sheared so it runs along +z, after which the edge tests are 2D and exact in
+//    sign, so rays through shared edges and vertices never slip between two triangles
+// 3. the shear is set up once per ray; the per-triangle test is straight line
+//    arithmetic with a single combined branch on the edge signs
+// NOTE: triangles are two-sided; the normal is the geometric one, facing the ray
+template <typename T>
+class basic_triangle_mesh : public basic_hittable<T> {
+    public:
+        // builds the hierarchy over every triangle of buffers, which must hold valid indices
+        // (see mesh_buffers::first_bad_triangle)
+        basic_triangle_mesh(shared_ptr<const mesh_buffers> buffers, shared_ptr<basic_material<T>> mat)
+            : buffers(std::move(buffers)), mat(std::move(mat))
+        {
+            // the boxes are widened by a few ulps, so a rounded slab test cannot cull a ray
+            // that the exact triangle test would accept on an edge
+            std::vector<basic_aabb<T>> boxes(this->buffers->triangle_count());
+            for (size_t t = 0; t < boxes.size(); t++) {
+                basic_vec3<T> a, b, c;
+                corners(int(t), a, b, c);
+                basic_aabb<T> box(basic_aabb<T>(a, b), basic_aabb<T>(c, c));
+                T extent = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    const auto& ax = box.axis_interval(axis);
+                    extent = std::max({extent, std::fabs(ax.min), std::fabs(ax.max)});
+                }
+                T pad = 4 * std::numeric_limits<T>::epsilon() * extent;
+                boxes[t] = basic_aabb<T>(box.x.expand(pad), box.y.expand(pad), box.z.expand(pad));
+            }
+            tree.build(boxes);
+        }
+
+        bool hit(const basic_ray<T>& r, basic_interval<T> ray_t, basic_hit_record<T>& rec) const override {
+            shear s(r);
+            int best = -1;
+            tree.traverse(r, ray_t, [&](int slot, basic_interval<T>& t) {
+                int triangle = tree.prim_indices[slot];
+                RT_STATS_COUNT(hit_calls[primitive_triangle]++);
+                if (!intersect(s, triangle, t))
+                    return false;
+                best = triangle;
+                return true;
+            });
+            if (best < 0)
+                return false;
+
+            RT_STATS_COUNT(hits[primitive_triangle]++);
+            basic_vec3<T> a, b, c;
+            corners(best, a, b, c);
+            rec.t   = s.t_hit;
+            rec.p   = r.at(rec.t);
+            rec.set_face_normal(r, unit_vector(cross(b - a, c - a)));
+            rec.mat = mat.get();
+            return true;
+        }
+
+        basic_aabb<T> bounding_box() const override {return tree.bounding_box();}
+
+        size_t triangle_count() const {return buffers->triangle_count();}
+
+        // bytes held by the hierarchy, not by the shared buffers
+        size_t memory_bytes() const {return tree.memory_bytes();}
+
+    private:
+        shared_ptr<const mesh_buffers>  buffers;
+        shared_ptr<basic_material<T>>   mat;    // keeps the material alive, records get the raw pointer
+        basic_bvh_tree<T>               tree;
+
+        // ray in the sheared space of the watertight test
+        struct shear {
+            basic_vec3<T>   origin;
+            int             kx, ky, kz;     // axes permuted so the ray runs along kz
+            T               sx, sy, sz;     // shear constants
+            T               t_hit = 0;      // distance of the last accepted hit
+
+            explicit shear(const basic_ray<T>& r) : origin(r.origin()) {
+                const auto& d = r.direction();
+                auto ax = std::fabs(d.x()), ay = std::fabs(d.y()), az = std::fabs(d.z());
+                kz = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+                kx = (kz + 1) % 3;
+                ky = (kx + 1) % 3;
+                if (d[kz] < 0)
+                    std::swap(kx, ky);      // keeps the winding, so the edge signs stay valid
+                sx = d[kx] / d[kz];
+                sy = d[ky] / d[kz];
+                sz = 1 / d[kz];
+            }
+        };
+
+        void corners(int triangle, basic_vec3<T>& a, basic_vec3<T>& b, basic_vec3<T>& c) const {
+            const uint32_t* index = buffers->indices() + 3 * size_t(triangle);
+            const float*    p     = buffers->positions();
+            a = basic_vec3<T>(T(p[3*size_t(index[0])]), T(p[3*size_t(index[0]) + 1]), T(p[3*size_t(index[0]) + 2]));
+            b = basic_vec3<T>(T(p[3*size_t(index[1])]), T(p[3*size_t(index[1]) + 1]), T(p[3*size_t(index[1]) + 2]));
+            c = basic_vec3<T>(T(p[3*size_t(index[2])]), T(p[3*size_t(index[2]) + 1]), T(p[3*size_t(index[2]) + 2]));
+        }
+
+        // watertight ray/triangle test; on a hit inside ray_t lowers ray_t.max to it
+        bool intersect(shear& s, int triangle, basic_interval<T>& ray_t) const {
+            basic_vec3<T> a, b, c;
+            corners(triangle, a, b, c);
+            a = a - s.origin;
+            b = b - s.origin;
+            c = c - s.origin;
+
+            // 1. shear and scale the vertices so the ray becomes the +z axis
+            T ax = a[s.kx] - s.sx * a[s.kz], ay = a[s.ky] - s.sy * a[s.kz];
+            T bx = b[s.kx] - s.sx * b[s.kz], by = b[s.ky] - s.sy * b[s.kz];
+            T cx = c[s.kx] - s.sx * c[s.kz], cy = c[s.ky] - s.sy * c[s.kz];
+
+            // 2. scaled barycentric coordinates from 2D edge functions
+            T u = cx * by - cy * bx;
+            T v = ax * cy - ay * cx;
+            T w = bx * ay - by * ax;
+
+            // an edge through the ray itself: redo the edge functions in double, so the
+            // sign decides the shared edge the same way for both of its triangles
+            if constexpr (!std::is_same<T, double>::value) {
+                if (u == 0 || v == 0 || w == 0) {
+                    u = T(double(cx) * double(by) - double(cy) * double(bx));
+                    v = T(double(ax) * double(cy) - double(ay) * double(cx));
+                    w = T(double(bx) * double(ay) - double(by) * double(ax));
+                }
+            }
+
+            // 3. the ray is inside when the three signs agree (either winding)
+            if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+                return false;
+            T det = u + v + w;
+            if (det == 0)
+                return false;
+
+            // 4. distance, as the barycentric blend of the scaled vertex depths
+            T az = s.sz * a[s.kz], bz = s.sz * b[s.kz], cz = s.sz * c[s.kz];
+            T t  = (u * az + v * bz + w * cz) / det;
+            if (!ray_t.surrounds(t))
+                return false;
+
+            ray_t.max = t;
+            s.t_hit   = t;
+            return true;
+        }
+};
+
+using triangle_mesh = basic_triangle_mesh<double>;
+
+#endif  // end of triangle_mesh header file
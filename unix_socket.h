@@ -0,0 +1,154 @@
+#ifndef UNIX_SOCKET_H   // start of unix_socket header file
+#define UNIX_SOCKET_H   // socket_connection class definition
+
+// Import libraries
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RT_HAVE_UNIX_SOCKETS 1
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef RT_HAVE_UNIX_SOCKETS
+
+// one end of a stream connection over a Unix domain socket, as used between the render
+// server and its clients
+// 1. requests and reply headers are single text lines ending in '\n'
+// 2. a reply header may announce a number of raw bytes (an encoded image) that follow it
+// NOTE: reads are buffered, so lines are not read one byte per system call
+class socket_connection {
+    public:
+        explicit socket_connection(int fd) : fd(fd) {}
+        ~socket_connection() {
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        socket_connection(const socket_connection&) = delete;
+        socket_connection& operator=(const socket_connection&) = delete;
+
+        // connects to the server listening on path; nullptr if nobody listens there
+        static std::unique_ptr<socket_connection> connect(const std::string& path) {
+            sockaddr_un address;
+            if (!make_address(path, address))
+                return nullptr;
+            int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0)
+                return nullptr;
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                ::close(fd);
+                return nullptr;
+            }
+            return std::make_unique<socket_connection>(fd);
+        }
+
+        // reads the next line without its '\n'; false once the peer has closed the connection
+        bool read_line(std::string& line) {
+            line.clear();
+            while (true) {
+                auto newline = static_cast<const char*>(std::memchr(buffer.data() + start, '\n', buffer.size() - start));
+                if (newline != nullptr) {
+                    auto end = size_t(newline - buffer.data());
+                    line.assign(buffer.data() + start, end - start);
+                    start = end + 1;
+                    return true;
+                }
+                if (!fill())
+                    return false;
+            }
+        }
+
+        // reads exactly count raw bytes
+        bool read_bytes(size_t count, std::vector<unsigned char>& bytes) {
+            bytes.resize(count);
+            size_t have = 0;
+            while (have < count) {
+                if (start == buffer.size() && !fill())
+                    return false;
+                auto take = std::min(count - have, buffer.size() - start);
+                std::memcpy(bytes.data() + have, buffer.data() + start, take);
+                have  += take;
+                start += take;
+            }
+            return true;
+        }
+
+        bool write_line(const std::string& line) {
+            return write(line.data(), line.size()) && write("\n", 1);
+        }
+
+        bool write(const void* data, size_t size) {
+            auto bytes = static_cast<const char*>(data);
+            while (size > 0) {
+                auto sent = ::send(fd, bytes, size, send_flags);
+                if (sent <= 0)
+                    return false;
+                bytes += sent;
+                size  -= size_t(sent);
+            }
+            return true;
+        }
+
+        // socket address for path; false if the path is too long for one
+        static bool make_address(const std::string& path, sockaddr_un& address) {
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(address.sun_path))
+                return false;
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return true;
+        }
+
+    private:
+        int                 fd;
+        std::vector<char>   buffer;     // received bytes, consumed from start
+        size_t              start = 0;
+
+#ifdef MSG_NOSIGNAL
+        static constexpr int send_flags = MSG_NOSIGNAL;     // a closed peer fails the send instead of raising SIGPIPE
+#else
+        static constexpr int send_flags = 0;
+#endif
+
+        // drops the consumed bytes and receives more; false on end of stream or error
+        bool fill() {
+            buffer.erase(buffer.begin(), buffer.begin() + std::ptrdiff_t(start));
+            start = 0;
+
+            char chunk[65536];
+            auto received = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0)
+                return false;
+            buffer.insert(buffer.end(), chunk, chunk + received);
+            return true;
+        }
+};
+
+// socket listening for connections on path, replacing a stale socket file left behind
+// there; -1 on failure
+inline int listen_unix_socket(const std::string& path, int backlog = 64) {
+    sockaddr_un address;
+    if (!socket_connection::make_address(path, address))
+        return -1;
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, backlog) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#endif  // RT_HAVE_UNIX_SOCKETS
+
+#endif  // end of unix_socket header file
@@ -7,30 +7,39 @@
 // C++ Std Usings
 using std::sqrt;
 
-class vec3 {
+// 3D vector over the scalar type T (float or double)
+// vec3 and point3 are the double instantiation used everywhere by default
+template <typename T>
+class basic_vec3 {
     public:
-        double e[3];    // 3D vector attribute
+        using value_type = T;
+
+        T e[3];    // 3D vector attribute
 
         // Constructors
-        vec3() : e{0,0,0} {}
-        vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+        basic_vec3() : e{0,0,0} {}
+        basic_vec3(T e0, T e1, T e2) : e{e0, e1, e2} {}
+
+        // conversion between float and double vectors
+        template <typename U>
+        explicit basic_vec3(const basic_vec3<U>& v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {}
 
         // Accessor methods
-        double x() const {return e[0];}
-        double y() const {return e[1];}
-        double z() const {return e[2];}
+        T x() const {return e[0];}
+        T y() const {return e[1];}
+        T z() const {return e[2];}
 
         // negation
-        vec3 operator-() const {return vec3(-e[0], -e[1], -e[2]);} 
+        basic_vec3 operator-() const {return basic_vec3(-e[0], -e[1], -e[2]);} 
 
         // vector access
-        double operator[](int i) const {return e[i];} 
+        T operator[](int i) const {return e[i];} 
 
         // vector access by reference
-        double& operator[](int i) {return e[i];}    
+        T& operator[](int i) {return e[i];}    
 
         // addition assignment
-        vec3& operator+=(const vec3& v) {   
+        basic_vec3& operator+=(const basic_vec3& v) {   
             e[0] += v.e[0];
             e[1] += v.e[1];
             e[2] += v.e[2];
@@ -38,7 +47,7 @@ class vec3 {
         }
 
         // mulitplication assignment
-        vec3& operator*=(double t) {    
+        basic_vec3& operator*=(T t) {    
             e[0] *= t;
             e[1] *= t;
             e[2] *= t;
@@ -46,100 +55,141 @@ class vec3 {
         }
 
         // division assignment
-        vec3& operator/=(double t) {
+        basic_vec3& operator/=(T t) {
             return *this *= 1/t;
         }
 
         // returns the length of a vector
-        double length() const {
+        T length() const {
             return sqrt(length_squared());
         }
 
         // returns the squared length of a vector
-        double length_squared() const {
+        T length_squared() const {
             return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
         }
 
         // returns true if the vector is very close to 0 in all dimensions
         bool near_zero() const {
-            auto s = 1e-8;
+            auto s = T(1e-8);
             return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
         }
 
         // default constructor for generating random vector
-        static vec3 random() {
-            return vec3(random_double(), random_double(), random_double());
+        static basic_vec3 random() {
+            return basic_vec3(T(random_double()), T(random_double()), T(random_double()));
         }
 
         // generates random vector with a defined min and max component values
-        static vec3 random(double min, double max) {
-            return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+        static basic_vec3 random(double min, double max) {
+            return basic_vec3(T(random_double(min, max)), T(random_double(min, max)), T(random_double(min, max)));
+        }
+
+        // generates random vector with a defined min and max component values from gen
+        static basic_vec3 random(rng& gen, double min, double max) {
+            // components drawn in a fixed order, unlike the unsequenced constructor arguments
+            auto x = T(gen.random_double(min, max));
+            auto y = T(gen.random_double(min, max));
+            auto z = T(gen.random_double(min, max));
+            return basic_vec3(x, y, z);
         }
 };
 
+using vec3 = basic_vec3<double>;
+
 // point3 is just an alias for vec3, but useful for geometric clarity in the code
 using point3 = vec3;
 
 // Vector Utility Functions
+// NOTE: scalar operands are taken as the vector's value_type, so T is deduced from the
+//       vector alone and int or double literals convert to it
 
 //output vector
-inline std::ostream& operator<<(std::ostream& out, const vec3& v) {
+template <typename T>
+inline std::ostream& operator<<(std::ostream& out, const basic_vec3<T>& v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
 // vector addition
-inline vec3 operator+(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+template <typename T>
+inline basic_vec3<T> operator+(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
 }
 
 // vector subtraction
-inline vec3 operator-(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+template <typename T>
+inline basic_vec3<T> operator-(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
 }
 
 // vector multiplication
-inline vec3 operator*(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
 // scalar-vector multiplication
-inline vec3 operator*(double t, const vec3& v) {
-    return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
+template <typename T>
+inline basic_vec3<T> operator*(typename basic_vec3<T>::value_type t, const basic_vec3<T>& v) {
+    return basic_vec3<T>(t*v.e[0], t*v.e[1], t*v.e[2]);
 }
 
 // vector-scalar multiplication
-inline vec3 operator*(const vec3& v, double t) {
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T>& v, typename basic_vec3<T>::value_type t) {
     return t * v;
 }
 
 // vector-scalar division
-inline vec3 operator/(const vec3& v, double t) {
+template <typename T>
+inline basic_vec3<T> operator/(const basic_vec3<T>& v, typename basic_vec3<T>::value_type t) {
     return (1/t) * v;
 }
 
 // dot product
-inline double dot(const vec3& u, const vec3& v) {
+template <typename T>
+inline T dot(const basic_vec3<T>& u, const basic_vec3<T>& v) {
     return u.e[0] * v.e[0]
         + u.e[1] * v.e[1]
         + u.e[2] * v.e[2];
 }
 
 // cross product
-inline vec3 cross(const vec3& u, const vec3& v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+template <typename T>
+inline basic_vec3<T> cross(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                         u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                         u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
 // // creates a normal unit vector perpendicular to the surface of a unit sphere at that point
-inline vec3 unit_vector(const vec3& v) {
+template <typename T>
+inline basic_vec3<T> unit_vector(const basic_vec3<T>& v) {
     return v / v.length();
 }
 
+// NOTE: the random vector helpers return vec3 unless a scalar type is given,
+//       e.g. random_unit_vector<float>(gen)
+
 // generates a random point inside unit disk
-inline vec3 random_in_unit_disk() {
+// NOTE: with a pixel_sampler the point is mapped from the next pair of sample dimensions
+//       by the concentric map (Shirley and Chiu 1997), which keeps their stratification
+template <typename T = double>
+inline basic_vec3<T> random_in_unit_disk(rng& gen) {
+    if (gen.has_sampler()) {
+        double u, v;
+        gen.next_2d(u, v);
+        auto a = 2*u - 1, b = 2*v - 1;
+        if (a == 0 && b == 0)
+            return basic_vec3<T>(0, 0, 0);
+        auto radius = std::fabs(a) > std::fabs(b) ? a : b;
+        auto phi    = std::fabs(a) > std::fabs(b) ? (pi / 4) * (b / a) : (pi / 2) - (pi / 4) * (a / b);
+        return basic_vec3<T>(T(radius * std::cos(phi)), T(radius * std::sin(phi)), 0);
+    }
     while (true) {
-        auto p = vec3(random_double(-1,1), random_double(-1,1), 0);
+        auto x = T(gen.random_double(-1,1));
+        auto y = T(gen.random_double(-1,1));
+        auto p = basic_vec3<T>(x, y, 0);
         if (p.length_squared() < 1)
             return p;
     }
@@ -149,30 +199,44 @@ inline vec3 random_in_unit_disk() {
 // 1. Generate a random vector inside of the unit sphere (center to surface)
 // 2. Normalize this vector (clamp its value to the surface)
 // 3. Invert the normalized vector if it falls onto the wrong hemisphere
-inline vec3 random_in_unit_sphere() {
+template <typename T = double>
+inline basic_vec3<T> random_in_unit_sphere(rng& gen) {
     while (true) {
-        auto p = vec3::random(-1 , 1);
+        auto p = basic_vec3<T>::random(gen, -1 , 1);
         if (p.length_squared() < 1)
             return p;
     }
 }
 
 // normalizes a random vector to a unit vector on the surface of a unit sphere
-inline vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
+// NOTE: with a pixel_sampler the vector is mapped from the next pair of sample dimensions
+//       by an area preserving map, one pair for every bounce
+template <typename T = double>
+inline basic_vec3<T> random_unit_vector(rng& gen) {
+    if (gen.has_sampler()) {
+        double u, v;
+        gen.next_2d(u, v);
+        auto z      = 1 - 2*u;
+        auto radius = std::sqrt(std::max(0.0, 1 - z*z));
+        auto phi    = 2 * pi * v;
+        return basic_vec3<T>(T(radius * std::cos(phi)), T(radius * std::sin(phi)), T(z));
+    }
+    return unit_vector(random_in_unit_sphere<T>(gen));
 }
 
 // inverts a normalized vector if it falls onto the wrong hemisphere
-inline vec3 random_on_hemisphere(const vec3& normal) {
-    vec3 on_unit_sphere = random_unit_vector();
-    if (dot(on_unit_sphere, normal) > 0.0)  // in the same hemipshere as normal
+template <typename T>
+inline basic_vec3<T> random_on_hemisphere(const basic_vec3<T>& normal, rng& gen) {
+    basic_vec3<T> on_unit_sphere = random_unit_vector<T>(gen);
+    if (dot(on_unit_sphere, normal) > 0)  // in the same hemipshere as normal
         return on_unit_sphere;
     else
         return -on_unit_sphere;
 }
 
 // ray reflection (ray bounces off surface material)
-inline vec3 reflect(const vec3& v, const vec3& n) {
+template <typename T>
+inline basic_vec3<T> reflect(const basic_vec3<T>& v, const basic_vec3<T>& n) {
     // 1. ray = v + 2b
     // 2. b is the projection of v onto unit vector n = v*n
     // 3. if n is not a unit vector, divide dot product by length of n
@@ -182,18 +246,21 @@ inline vec3 reflect(const vec3& v, const vec3& n) {
 
 // ray refraction (ray is partially absorbed into surface material at an angle)
 // Uses Snell's Law - etai*sin(theta) = etat*sin(theta-prime)
-inline vec3 refract(const vec3& uv, const vec3& n ,double etai_over_etat) {
+template <typename T>
+inline basic_vec3<T> refract(const basic_vec3<T>& uv, const basic_vec3<T>& n,
+                             typename basic_vec3<T>::value_type etai_over_etat)
+{
     // given two unit vectors, dot product between ray uv and surface normal n 
-    auto cos_theta      = fmin(dot(-uv, n), 1.0);
+    auto cos_theta      = std::fmin(dot(-uv, n), T(1));
 
     // part of ray that is perpendicular to the surface normal
-    vec3 r_out_perp     = etai_over_etat * (uv + cos_theta*n);
+    basic_vec3<T> r_out_perp     = etai_over_etat * (uv + cos_theta*n);
     
     // part of ray that is parallel to the surface normal
-    vec3 r_out_parallel = -sqrt(fabs(1.0 - r_out_perp.length_squared())) * n;
+    basic_vec3<T> r_out_parallel = -sqrt(fabs(1 - r_out_perp.length_squared())) * n;
 
     // return refracted ray
     return r_out_perp + r_out_parallel;
 }
 
-#endif  // end of vec3 header file
\ No newline at end of file
+#endif  // end of vec3 header file
@@ -0,0 +1,80 @@
+#ifndef WAVEFRONT_H // start of wavefront header file
+#define WAVEFRONT_H // path_queue class definition
+
+// Import libraries
+#include "rtweekend.h"
+#include "hittable.h"
+#include "render_stats.h"
+
+#include <vector>
+
+// paths in flight for the wavefront integrator, in structure-of-arrays form
+// 1. every path holds its current ray, its throughput, its random generator and the
+//    number of bounces so far; its color is written to colors[path] once it ends
+// 2. each bounce intersects every live path, then sorts the hits into one bin per
+//    material type, so every type scatters in its own loop (see camera::trace_wavefront)
+template <typename T>
+class basic_path_queue {
+    public:
+        std::vector<T>      ox, oy, oz;     // current ray origins
+        std::vector<T>      dx, dy, dz;     // current ray directions
+        std::vector<T>      tr, tg, tb;     // path throughputs
+        std::vector<rng>    gens;           // random stream of every path
+        std::vector<int>    bounces;        // scattering events so far
+
+        std::vector<basic_hit_record<T>>    recs;       // surface hit by the current bounce
+        std::vector<basic_vec3<T>>          colors;     // color of every finished path
+
+        std::vector<int>    live;                           // paths still being traced
+        std::vector<int>    bins[material_kind_count + 1];  // live hits by material_kind, the last bin for other materials
+
+        int size() const {return int(gens.size());}
+
+        // removes every path, keeping the allocations for the next wave
+        void clear() {
+            for (auto array : {&ox, &oy, &oz, &dx, &dy, &dz, &tr, &tg, &tb})
+                array->clear();
+            gens.clear();
+            bounces.clear();
+            recs.clear();
+            colors.clear();
+            live.clear();
+        }
+
+        // appends a path starting with ray r and random stream gen, returns its index
+        int push(const basic_ray<T>& r, const rng& gen) {
+            ox.push_back(0); oy.push_back(0); oz.push_back(0);
+            dx.push_back(0); dy.push_back(0); dz.push_back(0);
+            tr.push_back(1); tg.push_back(1); tb.push_back(1);
+            gens.push_back(gen);
+            bounces.push_back(0);
+            recs.emplace_back();
+            colors.emplace_back(0, 0, 0);
+
+            int path = size() - 1;
+            set_ray(path, r);
+            return path;
+        }
+
+        basic_ray<T> ray(int path) const {
+            return basic_ray<T>(basic_vec3<T>(ox[path], oy[path], oz[path]),
+                                basic_vec3<T>(dx[path], dy[path], dz[path]));
+        }
+
+        void set_ray(int path, const basic_ray<T>& r) {
+            ox[path] = r.origin().x();    oy[path] = r.origin().y();    oz[path] = r.origin().z();
+            dx[path] = r.direction().x(); dy[path] = r.direction().y(); dz[path] = r.direction().z();
+        }
+
+        basic_vec3<T> throughput(int path) const {return basic_vec3<T>(tr[path], tg[path], tb[path]);}
+
+        void set_throughput(int path, const basic_vec3<T>& t) {
+            tr[path] = t.x();
+            tg[path] = t.y();
+            tb[path] = t.z();
+        }
+};
+
+using path_queue = basic_path_queue<double>;
+
+#endif  // end of wavefront header file